@@ -0,0 +1,89 @@
+#include "plugin.hpp"
+
+/** CV expander for KI1H-ENVELOPE. Placed directly to the ENVELOPE's right, it
+adds a CV input for every stage time and both sustain levels.
+
+The ENVELOPE panel has no room left for ten more jacks, so they live here. This
+module does no DSP of its own: each sample it copies its input voltages into
+the ENVELOPE's expander message, and the ENVELOPE smooths and applies them.
+Away from an ENVELOPE it does nothing. */
+struct KI1H_ENVCV : Module {
+  // The left column mirrors the ENVELOPE's top pair (AD1, ASD1), the right
+  // column its bottom pair (AD2, ASD2), each top to bottom in panel order.
+  enum InputIds {
+    ATK1_INPUT,
+    REL1_INPUT,
+    ATK2_INPUT,
+    SUS1_INPUT,
+    REL2_INPUT,
+    ATK3_INPUT,
+    REL3_INPUT,
+    ATK4_INPUT,
+    SUS2_INPUT,
+    REL4_INPUT,
+    NUM_INPUTS
+  };
+
+  KI1H_ENVCV();
+  void process(const ProcessArgs &args) override;
+};
+
+struct KI1H_ENVCVWidget : ModuleWidget {
+  KI1H_ENVCVWidget(KI1H_ENVCV *module);
+};
+
+KI1H_ENVCV::KI1H_ENVCV() {
+  // ============================================================================
+  // MODULE CONFIGURATION
+  // ============================================================================
+  config(0, NUM_INPUTS, 0);
+  configInput(ATK1_INPUT, "AD1 Attack CV");
+  configInput(REL1_INPUT, "AD1 Release CV");
+  configInput(ATK2_INPUT, "ASD1 Attack CV");
+  configInput(SUS1_INPUT, "ASD1 Sustain CV");
+  configInput(REL2_INPUT, "ASD1 Release CV");
+  configInput(ATK3_INPUT, "AD2 Attack CV");
+  configInput(REL3_INPUT, "AD2 Release CV");
+  configInput(ATK4_INPUT, "ASD2 Attack CV");
+  configInput(SUS2_INPUT, "ASD2 Sustain CV");
+  configInput(REL4_INPUT, "ASD2 Release CV");
+}
+
+void KI1H_ENVCV::process(const ProcessArgs &args) {
+  Module *envelope = leftExpander.module;
+  if (!envelope || envelope->model != modelKI1H_ENVELOPE)
+    return;
+
+  // Envelope indices follow EnvelopeCVMessage: [0]=AD1 [1]=ASD1 [2]=AD2 [3]=ASD2.
+  static const int attackInput[4] = {ATK1_INPUT, ATK2_INPUT, ATK3_INPUT, ATK4_INPUT};
+  static const int releaseInput[4] = {REL1_INPUT, REL2_INPUT, REL3_INPUT, REL4_INPUT};
+  static const int sustainInput[2] = {SUS1_INPUT, SUS2_INPUT};
+
+  EnvelopeCVMessage *msg = (EnvelopeCVMessage *)envelope->rightExpander.producerMessage;
+  for (int i = 0; i < 4; i++) {
+    msg->attack[i] = inputs[attackInput[i]].getVoltage();
+    msg->release[i] = inputs[releaseInput[i]].getVoltage();
+  }
+  for (int i = 0; i < 2; i++)
+    msg->sustain[i] = inputs[sustainInput[i]].getVoltage();
+  envelope->rightExpander.requestMessageFlip();
+}
+
+KI1H_ENVCVWidget::KI1H_ENVCVWidget(KI1H_ENVCV *module) {
+  setModule(module);
+  setPanel(createPanel(asset::plugin(pluginInstance, "res/KI1H-ENVCV.svg")));
+
+  // ============================================================================
+  // PANEL SCREWS
+  // ============================================================================
+  addPanelScrews(this);
+
+  for (int row = 0; row < 5; row++) {
+    addInput(createInputCentered<BananutOrange>(mm2px(Vec(COLUMNS[0], ROWS[row])),
+                                                module, KI1H_ENVCV::ATK1_INPUT + row));
+    addInput(createInputCentered<BananutOrange>(mm2px(Vec(COLUMNS[1], ROWS[row])),
+                                                module, KI1H_ENVCV::ATK3_INPUT + row));
+  }
+}
+
+Model *modelKI1H_ENVCV = createModel<KI1H_ENVCV, KI1H_ENVCVWidget>("KI1H-ENVCV");
@@ -1,141 +1,10 @@
+#include "envelope.hpp"
 #include "plugin.hpp"
 
 // We want to make two AD and two ASR envelopes. When the AD out is not connected,
 // The envelope section should behave as an AHDSR env, otherwise it should act as
 // an AD env and an AR/ASR env with swichable behaviour
 
-// ============================================================================
-// CLASS DEFINITION
-// ============================================================================
-struct Envelope {
-
-  enum Stage { STAGE_OFF, STAGE_ATTACK, STAGE_SUSTAIN, STAGE_RELEASE };
-  float env = 0.f;
-  float eoa = 0.f;
-  float eor = 1.f;
-
-  // End-of-attack is a 1 ms trigger pulse, not a latched level: processTransition
-  // fires it at the instant attack completes, and evolveEnvelope derives `eoa`
-  // from it every frame. A pulse cannot stick high through a held sustain the way
-  // a latched level could, which is what pinned the ASD's EOA jack at 10 V.
-  dsp::PulseGenerator eoaPulse;
-
-  Stage stage = STAGE_OFF;
-  float envState = 0.f;
-  float attackTime = 0.1f, releaseTime = 0.1f;
-
-  void retrigger() {
-    eoa = 0.f;
-    eor = 1.f;
-    eoaPulse.reset();
-    stage = STAGE_ATTACK;
-    env = envState = 0.f;
-  }
-
-  /** Restores exactly the state a freshly constructed envelope has. */
-  void reset() {
-    env = 0.f;
-    eoa = 0.f;
-    eor = 1.f;
-    eoaPulse.reset();
-    stage = STAGE_OFF;
-    envState = 0.f;
-  }
-
-  /** Advances envState for the current stage. Shared by both subclasses; the
-  only stage that behaves differently between them is the transition logic,
-  which is processTransition's job. */
-  void evolveEnvelope(const float &sampleTime) {
-    switch (stage) {
-    case STAGE_ATTACK: {
-      envState += sampleTime / attackTime;
-      env = std::min(envState, 1.f);
-      break;
-    }
-    case STAGE_RELEASE: {
-      envState -= sampleTime / releaseTime;
-      env = std::max(0.f, envState);
-      break;
-    }
-    case STAGE_SUSTAIN: {
-      // Held at its current level; only ASDEnvelope ever reaches this.
-      break;
-    }
-    case STAGE_OFF: {
-      env = 0.0f;
-      break;
-    }
-    }
-    // Advance the end-of-attack trigger and expose its level. eoaPulse.trigger()
-    // is called from processTransition (which runs just before this each frame).
-    eoa = eoaPulse.process(sampleTime) ? 1.f : 0.f;
-  }
-};
-
-/** Attack then straight into release. Never reaches STAGE_SUSTAIN. */
-struct ADEnvelope : Envelope {
-
-  // AD ignores the gate after it starts: attack runs to completion, then release.
-  void processTransition() {
-    if (stage == STAGE_ATTACK) {
-      if (envState >= 1.0f) {
-        eoaPulse.trigger(1e-3f);
-        eor = 0.f;
-        env = envState = 1.0f;
-        stage = STAGE_RELEASE;
-      }
-    } else if (stage == STAGE_RELEASE) {
-      if (envState <= 0.f) {
-        eor = 1.f;
-        stage = STAGE_OFF;
-        env = envState = 0.f;
-      }
-    }
-  }
-
-  void process(const float &sampleTime) {
-    processTransition();
-    evolveEnvelope(sampleTime);
-  }
-};
-
-/** Attack to a sustain level, hold there while gated (when asr is set), then
-release. The sustain stage is the only behavioural difference from AD. */
-struct ASDEnvelope : Envelope {
-
-  float sustain = 1.f;
-
-  void processTransition(const bool asr, const bool held) {
-    if (stage == STAGE_ATTACK) {
-      eor = 0.f;
-      if (envState >= sustain) {
-        eoaPulse.trigger(1e-3f);
-        env = envState = sustain;
-        if (asr) {
-          stage = STAGE_SUSTAIN;
-        } else {
-          stage = STAGE_RELEASE;
-        }
-      }
-    } else if (stage == STAGE_SUSTAIN) {
-      if (!held) {
-        stage = STAGE_RELEASE;
-      }
-    } else if (stage == STAGE_RELEASE) {
-      if (envState <= 0.f) {
-        eor = 1.f;
-        stage = STAGE_OFF;
-        env = envState = 0.f;
-      }
-    }
-  }
-
-  void process(const float &sampleTime, const bool sus, const bool held) {
-    processTransition(sus, held);
-    evolveEnvelope(sampleTime);
-  }
-};
-
 // ============================================================================
 // MODULE DEFINITION
 // ============================================================================
@@ -195,6 +64,8 @@ struct KI1H_ENVELOPE : Module {
   // it left off; see loadSettleFrames for why that alone is not enough.
   json_t *dataToJson() override;
   void dataFromJson(json_t *root) override;
+  // Layout version of the "state" array; bump it when the fields change.
+  static constexpr int STATE_VERSION = 1;
 
   void onReset(const ResetEvent &e) override {
     Module::onReset(e);
@@ -208,8 +79,26 @@ struct KI1H_ENVELOPE : Module {
   static constexpr float minStageTime = 0.003f; // in seconds
   static constexpr float maxStageTime = 10.f;   // in seconds
 
-  static float convertCVToTimeInSeconds(float cv) {
-    return minStageTime * std::pow(maxStageTime / minStageTime, cv);
+  /** Knob position (plus CV) to stage time, exponentially from minStageTime to
+  maxStageTime. One exp2 per lookup, so CV can move a stage every sample. */
+  static const ki1h::StageTimeMap stageTimes;
+
+  // CV from a KI1H-ENVCV on the right arrives a sample late through these; see
+  // EnvelopeCVMessage. Rack swaps the two after every engine step.
+  EnvelopeCVMessage cvMessages[2];
+
+  // Expander CVs are smoothed before they reach the envelopes, so an abrupt or
+  // audio-rate CV bends stage times and sustain without zipper noise or clicks.
+  // Laid out like EnvelopeCVMessage's fields: attack 0-3, release 4-7,
+  // sustain 8-9.
+  static constexpr float CV_SMOOTHING_HZ = 1000.f;
+  ki1h::OnePole cvSmooth[10];
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
+  }
+  void setSampleTime(float sampleTime) {
+    for (int k = 0; k < 10; k++)
+      cvSmooth[k].setCutoff(CV_SMOOTHING_HZ, sampleTime);
   }
 
 private:
@@ -218,6 +107,8 @@ private:
   static constexpr float CV_SCALE = 10.f;
 };
 
+const ki1h::StageTimeMap KI1H_ENVELOPE::stageTimes(minStageTime, maxStageTime);
+
 // ============================================================================
 // WIDGET DEFINITION
 // ============================================================================
@@ -230,6 +121,7 @@ struct KI1H_ENVELOPEWidget : ModuleWidget {
 // ============================================================================
 KI1H_ENVELOPE::KI1H_ENVELOPE() {
   config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
+  setSampleTime(APP->engine->getSampleTime());
   configParam(ATK1_PARAM, 0.f, 1.f, 0.1f, "AD1 Attack");
   configParam(ATK2_PARAM, 0.f, 1.f, 0.1f, "ASD1 Attack");
   configParam(ATK3_PARAM, 0.f, 1.f, 0.1f, "AD2 Attack");
@@ -260,6 +152,9 @@ KI1H_ENVELOPE::KI1H_ENVELOPE() {
   configOutput(OUT3_OUTPUT, "AD2 Output");
   configOutput(OUT4_OUTPUT, "ASD2 Output");
 
+  rightExpander.producerMessage = &cvMessages[0];
+  rightExpander.consumerMessage = &cvMessages[1];
+
   // A freshly placed module also starts with every output at 0 V, so the same
   // startup edge would auto-start a self-patched ring in parallel. Settle it.
   loadSettleFrames = kLoadSettleFrames;
@@ -284,14 +179,32 @@ void KI1H_ENVELOPE::process(const ProcessArgs &args) {
   if (loadSettleFrames > 0)
     loadSettleFrames--;
 
+  // ==========================================================================
+  // EXPANDER CV
+  // ==========================================================================
+  // With no KI1H-ENVCV on the right, every CV is 0 V and the smoothers glide
+  // back to the bare knob settings.
+  const EnvelopeCVMessage *cvIn = nullptr;
+  if (rightExpander.module && rightExpander.module->model == modelKI1H_ENVCV)
+    cvIn = (const EnvelopeCVMessage *)rightExpander.consumerMessage;
+
+  // 10 V sweeps the whole knob range.
+  float cv[10];
+  for (int k = 0; k < 4; k++) {
+    cv[k] = cvSmooth[k].process(cvIn ? cvIn->attack[k] / CV_SCALE : 0.f);
+    cv[4 + k] = cvSmooth[4 + k].process(cvIn ? cvIn->release[k] / CV_SCALE : 0.f);
+  }
+  for (int k = 0; k < 2; k++)
+    cv[8 + k] = cvSmooth[8 + k].process(cvIn ? cvIn->sustain[k] / CV_SCALE : 0.f);
+
   for (int i = 0; i < 2; i++) {
     const int adIdx = 2 * i;      // AD1, then AD2
     const int asdIdx = 2 * i + 1; // ASD1, then ASD2
 
     // Each AD/ASD pair is self-contained: within a pair the AD's end-of-attack
     // normals into the ASD's trigger, but nothing crosses between the pairs. So
-    // a pair whose six outputs are all empty can be skipped whole, which also
-    // skips its four convertCVToTimeInSeconds calls (a std::pow each).
+    // a pair whose six outputs are all empty can be skipped whole, stage-time
+    // lookups included.
     const bool pairLive =
         outputs[OUT1_OUTPUT + adIdx].isConnected() || outputs[OUT1_OUTPUT + asdIdx].isConnected() ||
         outputs[EOA1_OUTPUT + adIdx].isConnected() || outputs[EOA1_OUTPUT + asdIdx].isConnected() ||
@@ -302,8 +215,10 @@ void KI1H_ENVELOPE::process(const ProcessArgs &args) {
     // ========================================================================
     // AD STAGE
     // ========================================================================
-    ad[i].attackTime = convertCVToTimeInSeconds(params[ATK1_PARAM + adIdx].getValue());
-    ad[i].releaseTime = convertCVToTimeInSeconds(params[adRelParam[i]].getValue());
+    ad[i].attackStep = stageTimes.increment(
+        clamp(params[ATK1_PARAM + adIdx].getValue() + cv[adIdx], 0.f, 1.f), args.sampleTime);
+    ad[i].releaseStep = stageTimes.increment(
+        clamp(params[adRelParam[i]].getValue() + cv[4 + adIdx], 0.f, 1.f), args.sampleTime);
 
     const bool adTriggered =
         gateTrigger[adIdx].process(inputs[TRIGGER1_INPUT + adIdx].getVoltage());
@@ -319,9 +234,11 @@ void KI1H_ENVELOPE::process(const ProcessArgs &args) {
     // ========================================================================
     // ASD STAGE
     // ========================================================================
-    asd[i].attackTime = convertCVToTimeInSeconds(params[ATK1_PARAM + asdIdx].getValue());
-    asd[i].sustain = params[asdSusParam[i]].getValue();
-    asd[i].releaseTime = convertCVToTimeInSeconds(params[asdRelParam[i]].getValue());
+    asd[i].attackStep = stageTimes.increment(
+        clamp(params[ATK1_PARAM + asdIdx].getValue() + cv[asdIdx], 0.f, 1.f), args.sampleTime);
+    asd[i].sustain = clamp(params[asdSusParam[i]].getValue() + cv[8 + i], 0.f, 1.f);
+    asd[i].releaseStep = stageTimes.increment(
+        clamp(params[asdRelParam[i]].getValue() + cv[4 + asdIdx], 0.f, 1.f), args.sampleTime);
 
     // With nothing patched into the ASD's own trigger, the pair acts as one
     // AHDSR: the ASD is fired by the AD's end-of-attack.
@@ -356,46 +273,44 @@ void KI1H_ENVELOPE::process(const ProcessArgs &args) {
 // ============================================================================
 // STATE PERSISTENCE
 // ============================================================================
-// The four envelopes in index order: [0]=AD1 [1]=ASD1 [2]=AD2 [3]=ASD2. sustain
-// (ASD only) is omitted — it is re-derived from its param every sample. The
-// SchmittTrigger gate states are omitted too: they re-latch from the jacks
-// during the loadSettleFrames window, so they need no persisting.
+// The four envelopes in index order: [0]=AD1 [1]=ASD1 [2]=AD2 [3]=ASD2. The
+// SchmittTrigger gate states are omitted: they re-latch from the jacks during
+// the loadSettleFrames window, so they need no persisting.
 json_t *KI1H_ENVELOPE::dataToJson() {
   Envelope *env[4] = {&ad[0], &asd[0], &ad[1], &asd[1]};
   json_t *root = json_object();
-  json_t *envs = json_array();
-  for (int i = 0; i < 4; i++) {
-    json_t *e = json_object();
-    json_object_set_new(e, "stage", json_integer(env[i]->stage));
-    json_object_set_new(e, "env", json_real(env[i]->env));
-    json_object_set_new(e, "envState", json_real(env[i]->envState));
-    json_object_set_new(e, "eoa", json_real(env[i]->eoa));
-    json_object_set_new(e, "eor", json_real(env[i]->eor));
-    json_array_append_new(envs, e);
-  }
-  json_object_set_new(root, "envelopes", envs);
+  ki1h::StateWriter state(STATE_VERSION);
+  for (int i = 0; i < 4; i++)
+    env[i]->saveState(state);
+  json_object_set_new(root, "state", state.toJson());
   return root;
 }
 
 void KI1H_ENVELOPE::dataFromJson(json_t *root) {
-  json_t *envs = json_object_get(root, "envelopes");
-  if (!envs)
-    return;
   Envelope *env[4] = {&ad[0], &asd[0], &ad[1], &asd[1]};
-  for (int i = 0; i < 4; i++) {
-    json_t *e = json_array_get(envs, i);
-    if (!e)
-      continue;
-    if (json_t *j = json_object_get(e, "stage"))
-      env[i]->stage = (Envelope::Stage)json_integer_value(j);
-    if (json_t *j = json_object_get(e, "env"))
-      env[i]->env = json_number_value(j);
-    if (json_t *j = json_object_get(e, "envState"))
-      env[i]->envState = json_number_value(j);
-    if (json_t *j = json_object_get(e, "eoa"))
-      env[i]->eoa = json_number_value(j);
-    if (json_t *j = json_object_get(e, "eor"))
-      env[i]->eor = json_number_value(j);
+  if (json_t *saved = json_object_get(root, "state")) {
+    ki1h::StateReader state(saved, STATE_VERSION);
+    for (int i = 0; i < 4; i++)
+      env[i]->loadState(state);
+  } else if (json_t *envs = json_object_get(root, "envelopes")) {
+    // Patches from 2.2 and earlier saved one object per envelope.
+    for (int i = 0; i < 4; i++) {
+      json_t *e = json_array_get(envs, i);
+      if (!e)
+        continue;
+      if (json_t *j = json_object_get(e, "stage"))
+        env[i]->stage = (Envelope::Stage)json_integer_value(j);
+      if (json_t *j = json_object_get(e, "env"))
+        env[i]->env = json_number_value(j);
+      if (json_t *j = json_object_get(e, "envState"))
+        env[i]->envState = json_number_value(j);
+      if (json_t *j = json_object_get(e, "eoa"))
+        env[i]->eoa = json_number_value(j);
+      if (json_t *j = json_object_get(e, "eor"))
+        env[i]->eor = json_number_value(j);
+    }
+  } else {
+    return;
   }
   // Restored a running state: swallow the load-time startup edge so the ring
   // resumes at its saved phase instead of re-syncing.
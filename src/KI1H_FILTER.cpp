@@ -1,146 +1,7 @@
+#include "filter.hpp"
 #include "plugin.hpp"
 #include <cmath>
 
-// Float pi, so the coefficient expressions below stay in single precision
-// instead of promoting through the double overloads of exp/cos/sin.
-static constexpr float PI_F = 3.14159265358979323846f;
-
-// Analog-style headroom + output stage. Internally each filter is allowed to
-// swing up to +/-HEADROOM, the way a modern op-amp fed from a hot rail can —
-// so resonance rings up loud instead of being flattened to unity. The output
-// stage is then a soft clip that is transparent for ordinary signal levels
-// (everything up to CLIP_KNEE passes untouched, no distortion of clean audio)
-// and only rounds the hot peaks off, trending toward CLIP_CEIL without ever
-// exceeding it. HEADROOM sizes the internal ceilings (LP feedback rail, BP
-// resonant-gain cap); CLIP_CEIL is what the jacks approach.
-static constexpr float HEADROOM = 12.f;
-static constexpr float CLIP_KNEE = 7.f;
-static constexpr float CLIP_CEIL = 10.f;
-static inline float softClip(float x) {
-  float a = std::fabs(x);
-  if (a <= CLIP_KNEE)
-    return x; // ordinary levels pass through untouched
-  float range = CLIP_CEIL - CLIP_KNEE;
-  return std::copysign(CLIP_KNEE + range * std::tanh((a - CLIP_KNEE) / range), x);
-}
-
-// ============================================================================
-// CLASS DEFINITION
-// ============================================================================
-struct Filter {
-  float getOutput() const {
-    return output;
-  }
-  float output = 0.f;
-};
-
-struct LPFilter : Filter {
-  void process(float input, float cutoff, float resonance, float sampletime);
-  /** Restores exactly the state a freshly constructed LPFilter has. */
-  void reset() {
-    output = 0.f;
-    cutoff_coeff = 0.f;
-    cachedCutoff = -1.f;
-    cachedSampletime = -1.f;
-    for (int i = 0; i < 12; i++)
-      stages[i] = 0.f;
-  }
-  static constexpr float minFreq = 20.f;
-  static constexpr float maxFreq = 22000.f;
-  float stages[12] = {};
-  float cutoff_coeff = 0.f;
-
-  // Cache keyed on the inputs the coefficient derives from. Negative
-  // sentinels so the first process() call always computes.
-  float cachedCutoff = -1.f;
-  float cachedSampletime = -1.f;
-};
-
-struct BPFilter : Filter {
-  void process(float input, float frequency, float width, float resonance, float sampletime);
-  static constexpr float minFreq = 30.f;
-  static constexpr float maxFreq = 15000.f;
-  void setCoefficients(float w, float q) {
-    float cos_w = std::cos(w);
-    float sin_w = std::sin(w);
-    float alpha = sin_w / (2.0f * q);
-
-    float a0 = 1.0f + alpha;
-    b0 = (1.0f - cos_w) / (2.0f * a0);
-    b1 = (1.0f - cos_w) / a0;
-    b2 = b0;
-    a1 = (-2.0f * cos_w) / a0;
-    a2 = (1.0f - alpha) / a0;
-
-    // This is an RBJ low-pass whose resonant peak gain rises with Q (~Q for
-    // high Q). Left raw, a Q of ~13 boosts a signal at the corner by >20 dB,
-    // so a +/-5 V input came out at tens of volts. Rather than flatten it to
-    // unity (which made resonance sound dead and quiet), cap the peak gain at
-    // BP_MAX_PEAK: resonance still rings, but only up to the +/-HEADROOM the
-    // output stage is built around. Below the cap the peak passes through at
-    // its natural gain; above it the numerator is scaled down to sit at the
-    // cap. BP_MAX_PEAK is HEADROOM / 5 V, i.e. a nominal +/-5 V input at the
-    // resonant frequency just fills the headroom.
-    static constexpr float BP_MAX_PEAK = HEADROOM / 5.f;
-    if (q > 0.70710678f) {
-      float peak = q / std::sqrt(1.0f - 1.0f / (4.0f * q * q));
-      if (peak > BP_MAX_PEAK) {
-        float scale = BP_MAX_PEAK / peak;
-        b0 *= scale;
-        b1 *= scale;
-        b2 *= scale;
-      }
-    }
-  }
-  /** Restores exactly the state a freshly constructed BPFilter has. */
-  void reset() {
-    output = 0.f;
-    hp_prev_in = hp_prev_out = 1.f;
-    x1 = x2 = y1 = y2 = 0.f;
-    b0 = b1 = b2 = a1 = a2 = 0.f;
-    hp_alpha = 0.f;
-    cachedFreq = -1.f;
-    cachedWidth = -1.f;
-    cachedRes = -1.f;
-    cachedSampletime = -1.f;
-  }
-
-  // 6dB HP state
-  float hp_prev_in = 1.f;
-  float hp_prev_out = 1.f;
-  float hp_alpha = 0.f;
-
-  // Cache keyed on everything the coefficients derive from.
-  float cachedFreq = -1.f;
-  float cachedWidth = -1.f;
-  float cachedRes = -1.f;
-  float cachedSampletime = -1.f;
-
-  // 12dB LP biquad states
-  float x1 = 0.f, x2 = 0.f, y1 = 0.f, y2 = 0.f;             // State variables
-  float b0 = 0.f, b1 = 0.f, b2 = 0.f, a1 = 0.f, a2 = 0.f;   // Coefficients
-};
-
-struct HPFilter : Filter {
-  void process(float input, float cutoff, float sampletime);
-  /** Restores exactly the state a freshly constructed HPFilter has. */
-  void reset() {
-    output = 0.f;
-    prev_input = prev_output = 1.f;
-    alpha = 0.f;
-    cachedCutoff = -1.f;
-    cachedSampletime = -1.f;
-  }
-  static constexpr float minFreq = 30.f;
-  static constexpr float maxFreq = 10000.f;
-  float prev_input = 1.f;
-  float prev_output = 1.f;
-
-  float alpha = 0.f;
-  float cachedCutoff = -1.f;
-  float cachedSampletime = -1.f;
-};
-
 // ============================================================================
 // MODULE DEFINITION
 // ============================================================================
@@ -189,12 +50,55 @@ struct KI1H_FILTER : Module {
     bpfilter1.reset();
     bpfilter2.reset();
     hpfilter.reset();
+    filterBank.reset();
+  }
+
+  // Rack persists only params. Saving the filter memories lets a reloaded
+  // patch, a self-oscillating LP above all, carry on instead of restarting
+  // from silence.
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *root) override;
+  // Layout version of the "state" array; bump it when the fields change.
+  static constexpr int STATE_VERSION = 2;
+  ki1h::WarmStart warmStart;
+  void onAdd(const AddEvent &e) override {
+    warmStart.arm(this, APP->engine->getSampleRate());
+  }
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
   }
+  BusInput busInput;
+  // Saturates each of the LP ladder's twelve stages, not only its feedback.
+  bool lpSaturation = false;
+  // Bands in filter bank mode, which replaces the two BPs; 0 is off.
+  int bankBands = 0;
 
 private:
   LPFilter lpfilter;
   BPFilter bpfilter1, bpfilter2;
   HPFilter hpfilter;
+  // Its band memory is saved after the other filters', as part of state
+  // layout version 2.
+  BPFilterBank filterBank;
+  // The knobs, slewed so that a turn neither zippers nor recomputes
+  // coefficients every sample; the link switches are read as they are.
+  ki1h::SmoothedParam knobs[NUM_PARAMS];
+  float knob(int id) {
+    return knobs[id].process(params[id].getValue());
+  }
+  // Samples between coefficient updates while a knob slews.
+  static const int KNOB_BATCH = 16;
+  /** Everything that depends on the sample rate, so process() never checks
+  it. */
+  void setSampleTime(float sampleTime) {
+    lpfilter.setSampleTime(sampleTime);
+    bpfilter1.setSampleTime(sampleTime);
+    bpfilter2.setSampleTime(sampleTime);
+    hpfilter.setSampleTime(sampleTime);
+    filterBank.setSampleTime(sampleTime);
+    for (ki1h::SmoothedParam &k : knobs)
+      k.configure(sampleTime, ki1h::SmoothedParam::DEFAULT_TIME, KNOB_BATCH);
+  }
 };
 
 // ============================================================================
@@ -202,94 +106,9 @@ private:
 // ============================================================================
 struct KI1H_FILTERWidget : ModuleWidget {
   KI1H_FILTERWidget(KI1H_FILTER *module);
+  void appendContextMenu(Menu *menu) override;
 };
 
-// ============================================================================
-// PROCESS METHOD
-// ============================================================================
-void LPFilter::process(float input, float cutoff, float resonance, float sampletime) {
-  // cutoff comes from a knob plus optional CV, so it is control rate. Only
-  // pay for the exp() when it actually moves.
-  if (cutoff != cachedCutoff || sampletime != cachedSampletime) {
-    cachedCutoff = cutoff;
-    cachedSampletime = sampletime;
-    cutoff_coeff = 1.0f - std::exp(-2.0f * PI_F * cutoff * sampletime);
-  }
-
-  // Single feedback calculation. The feedback is saturated, not linear: at the
-  // top of the resonance range the loop gain exceeds unity and a purely linear
-  // ladder diverges without bound (output ran off to 1e30 V). A real ladder's
-  // transistors clip the feedback, which is what limits self-oscillation to a
-  // finite amplitude. tanh scaled to the +/-HEADROOM rail models that: it keeps
-  // the ladder inside the same headroom the output stage is built around while
-  // still letting the filter ring and self-oscillate.
-  float feedback = HEADROOM * std::tanh(stages[11] * resonance / HEADROOM);
-  float signal = input - feedback;
-
-  // Cascade of 12 one-pole lowpasses. Left as a loop and let -O3 unroll it.
-  for (int i = 0; i < 12; i++) {
-    float x = signal;
-    if (i > 0)
-      x = stages[i - 1];
-    stages[i] += cutoff_coeff * (x - stages[i]);
-  }
-  output = stages[11];
-}
-
-void HPFilter::process(float input, float cutoff, float sampletime) {
-
-  // High-pass coefficient, recomputed only when cutoff or sample rate moves.
-  if (cutoff != cachedCutoff || sampletime != cachedSampletime) {
-    cachedCutoff = cutoff;
-    cachedSampletime = sampletime;
-    alpha = std::exp(-2.0f * PI_F * cutoff * sampletime);
-  }
-
-  // RC high-pass
-  float hp_out = alpha * (prev_output + input - prev_input);
-
-  prev_input = input;
-  prev_output = hp_out;
-
-  output = hp_out;
-}
-
-void BPFilter::process(float input, float frequency, float width, float resonance,
-                       float sampletime) {
-  // frequency, width and resonance are all knob-plus-CV, i.e. control rate.
-  // Recompute the coefficient set only when one of them actually moves; the
-  // sample loop below runs every sample regardless.
-  if (frequency != cachedFreq || width != cachedWidth || resonance != cachedRes ||
-      sampletime != cachedSampletime) {
-    cachedFreq = frequency;
-    cachedWidth = width;
-    cachedRes = resonance;
-    cachedSampletime = sampletime;
-
-    float bw = frequency * width;
-    float q = (frequency / bw) * (1.f + resonance * 10.f);
-    float hpFreq = frequency - bw / 2;
-    float lpFreq = (bw / 2) + frequency;
-
-    hpFreq = std::max(hpFreq, 30.f);
-    lpFreq = std::min(15000.f, lpFreq);
-    hp_alpha = std::exp(-2.0f * PI_F * hpFreq * sampletime);
-    float w = 2.0f * PI_F * lpFreq * sampletime;
-    setCoefficients(w, q);
-  }
-
-  float hp_out = hp_alpha * (hp_prev_out + input - hp_prev_in);
-  hp_prev_in = input;
-  hp_prev_out = hp_out;
-
-  output = b0 * hp_out + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
-
-  x2 = x1;
-  x1 = hp_out;
-  y2 = y1;
-  y1 = output;
-}
-
 // ============================================================================
 // CV MODULATION HELPERS
 // ============================================================================
@@ -317,6 +136,8 @@ static float applyWidthMod(Input &in, float width) {
 // ============================================================================
 KI1H_FILTER::KI1H_FILTER() {
   config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
+  busInput.attach(this);
+  setSampleTime(APP->engine->getSampleTime());
   // ============================================================================
   // LP FILTER
   // ============================================================================
@@ -378,20 +199,22 @@ KI1H_FILTER::KI1H_FILTER() {
 // ============================================================================
 
 void KI1H_FILTER::process(const ProcessArgs &args) {
+  if (warmStart.step(this, args))
+    return;
   float lpInput = inputs[LP_INPUT].getVoltage();
-  float lpRes = params[LPRES_PARAM].getValue();
-  float lpFreq = params[LPFREQ_PARAM].getValue();
-  float bp1Freq = params[BPFREQ1_PARAM].getValue();
+  float lpRes = knob(LPRES_PARAM);
+  float lpFreq = knob(LPFREQ_PARAM);
+  float bp1Freq = knob(BPFREQ1_PARAM);
   float bp1Input = inputs[BP1_INPUT].getVoltage();
-  float bp1Width = params[BPWIDTH1_PARAM].getValue();
-  float bp1Res = params[BPRES1_PARAM].getValue();
+  float bp1Width = knob(BPWIDTH1_PARAM);
+  float bp1Res = knob(BPRES1_PARAM);
   float bp2Input = inputs[BP2_INPUT].getVoltage();
-  float bp2Freq = params[BPFREQ2_PARAM].getValue();
-  float bp2Width = params[BPWIDTH2_PARAM].getValue();
-  float bp2Res = params[BPRES2_PARAM].getValue();
+  float bp2Freq = knob(BPFREQ2_PARAM);
+  float bp2Width = knob(BPWIDTH2_PARAM);
+  float bp2Res = knob(BPRES2_PARAM);
   float hpInput = inputs[HP_INPUT].getVoltage();
-  float hpFreq = params[HPFREQ_PARAM].getValue();
-  float bigF = params[BIGKNOB_PARAM].getValue() * bpfilter1.maxFreq;
+  float hpFreq = knob(HPFREQ_PARAM);
+  float bigF = knob(BIGKNOB_PARAM) * bpfilter1.maxFreq;
   int link1 = (int)params[FILT1LINK_PARAM].getValue();
   int link2 = (int)params[FILT2LINK_PARAM].getValue();
 
@@ -401,6 +224,15 @@ void KI1H_FILTER::process(const ProcessArgs &args) {
   hpFreq = applyFreqMod(inputs[HPMOD_INPUT], hpFreq, hpfilter.minFreq, hpfilter.maxFreq);
   bigF = applyFreqMod(inputs[BIGKNOB_INPUT], bigF, 0.f, bpfilter1.maxFreq);
 
+  // A bus sender on the left feeds the two inputs the internal normals start
+  // from, when nothing is patched into them.
+  if (const BusMessage *bus = busInput.receive(this)) {
+    if (!inputs[BP1_INPUT].isConnected())
+      bp1Input = bus->lanes[0];
+    if (!inputs[HP_INPUT].isConnected())
+      hpInput = bus->lanes[1];
+  }
+
   bp1Width = applyWidthMod(inputs[BPWIDTH1_INPUT], bp1Width);
   bp2Width = applyWidthMod(inputs[BPWIDTH2_INPUT], bp2Width);
   // Opposite polarity on purpose — see the configSwitch calls in the ctor.
@@ -412,37 +244,117 @@ void KI1H_FILTER::process(const ProcessArgs &args) {
     hpFreq = clamp(hpFreq + bigF, hpfilter.minFreq, hpfilter.maxFreq);
     bp2Freq = clamp(bp2Freq + bigF, bpfilter2.minFreq, bpfilter2.maxFreq);
   }
+  // The bank spans the two BPs' frequencies after linking, so each end follows
+  // the BIGKNOB exactly when the filter it replaces would.
+  const bool banked = bankBands > 0;
 
   // Skip a filter whose result nobody can observe. BP1 and HP have to stay
   // live when their own jack is empty but the filter they normal into is
-  // patched, otherwise the internal chain goes silent.
+  // patched, otherwise the internal chain goes silent. A listening bus
+  // receiver on the right observes all four.
+  BusMessage *busOut = busOutput(this);
   const bool bp1Patched = outputs[BP1_OUTPUT].isConnected();
   const bool lpPatched = outputs[LP_OUTPUT].isConnected();
   const bool hpPatched = outputs[HP_OUTPUT].isConnected();
   const bool bp2Patched = outputs[BP2_OUTPUT].isConnected();
 
-  if (bp1Patched || lpPatched)
-    bpfilter1.process(bp1Input, bp1Freq, bp1Width, bp1Res, args.sampleTime);
-  if (lpPatched) {
-    if (!bp1Patched && !inputs[LP_INPUT].isConnected())
+  // The normals break on a patched output jack, as on the hardware; the bus
+  // is not a jack, so it leaves them alone. The bank's outputs are polyphonic,
+  // so in bank mode BP1 does not normal into the LP.
+  if (banked && (bp1Patched || bp2Patched || busOut)) {
+    filterBank.setBands(bankBands);
+    filterBank.process(bp1Input, bp1Freq, bp2Freq, bp1Width, bp1Res);
+  }
+  if (!banked && (bp1Patched || lpPatched || busOut))
+    bpfilter1.process(bp1Input, bp1Freq, bp1Width, bp1Res);
+  if (lpPatched || busOut) {
+    if (!banked && !bp1Patched && !inputs[LP_INPUT].isConnected())
       lpInput = bpfilter1.getOutput();
-    lpfilter.process(lpInput, lpFreq, lpRes, args.sampleTime);
+    lpfilter.saturate = lpSaturation;
+    lpfilter.process(lpInput, lpFreq, lpRes);
   }
 
-  if (hpPatched || bp2Patched)
-    hpfilter.process(hpInput, hpFreq, args.sampleTime);
-  if (bp2Patched) {
+  if (hpPatched || bp2Patched || busOut)
+    hpfilter.process(hpInput, hpFreq);
+  if (!banked && (bp2Patched || busOut)) {
     if (!hpPatched && !inputs[BP2_INPUT].isConnected())
       bp2Input = hpfilter.getOutput();
-    bpfilter2.process(bp2Input, bp2Freq, bp2Width, bp2Res, args.sampleTime);
+    bpfilter2.process(bp2Input, bp2Freq, bp2Width, bp2Res);
   }
 
   // Output stage: soft clip only (see softClip). Ordinary levels pass through
   // untouched; hot resonant peaks round off toward +/-CLIP_CEIL.
-  outputs[LP_OUTPUT].setVoltage(softClip(lpfilter.getOutput()));
-  outputs[HP_OUTPUT].setVoltage(softClip(hpfilter.getOutput()));
-  outputs[BP1_OUTPUT].setVoltage(softClip(bpfilter1.getOutput()));
-  outputs[BP2_OUTPUT].setVoltage(softClip(bpfilter2.getOutput()));
+  const float lpOut = softClip(lpfilter.getOutput());
+  const float hpOut = softClip(hpfilter.getOutput());
+  outputs[LP_OUTPUT].setVoltage(lpOut);
+  outputs[HP_OUTPUT].setVoltage(hpOut);
+  float bp1Out, bp2Out;
+  if (banked) {
+    // The lower half of the bands on BP1 OUT, the upper half on BP2 OUT, one
+    // channel each, lowest first. The bus carries each jack's first channel,
+    // which is what a mono cable from it would.
+    const int half = filterBank.getBands() / 2;
+    outputs[BP1_OUTPUT].setChannels(half);
+    outputs[BP2_OUTPUT].setChannels(half);
+    for (int c = 0; c < half; c++) {
+      outputs[BP1_OUTPUT].setVoltage(softClip(filterBank.getOutput(c)), c);
+      outputs[BP2_OUTPUT].setVoltage(softClip(filterBank.getOutput(half + c)), c);
+    }
+    bp1Out = outputs[BP1_OUTPUT].getVoltage(0);
+    bp2Out = outputs[BP2_OUTPUT].getVoltage(0);
+  } else {
+    bp1Out = softClip(bpfilter1.getOutput());
+    bp2Out = softClip(bpfilter2.getOutput());
+    outputs[BP1_OUTPUT].setChannels(1);
+    outputs[BP2_OUTPUT].setChannels(1);
+    outputs[BP1_OUTPUT].setVoltage(bp1Out);
+    outputs[BP2_OUTPUT].setVoltage(bp2Out);
+  }
+
+  if (busOut) {
+    busOut->lanes[0] = lpOut;
+    busOut->lanes[1] = bp1Out;
+    busOut->lanes[2] = bp2Out;
+    busOut->lanes[3] = hpOut;
+    busOut->fresh = true;
+  }
+}
+
+// ============================================================================
+// STATE PERSISTENCE
+// ============================================================================
+json_t *KI1H_FILTER::dataToJson() {
+  json_t *root = json_object();
+  warmStart.toJson(root);
+  busInput.toJson(root);
+  json_object_set_new(root, "lpSaturation", json_boolean(lpSaturation));
+  json_object_set_new(root, "bankBands", json_integer(bankBands));
+  ki1h::StateWriter state(STATE_VERSION);
+  lpfilter.saveState(state);
+  bpfilter1.saveState(state);
+  bpfilter2.saveState(state);
+  hpfilter.saveState(state);
+  filterBank.saveState(state);
+  json_object_set_new(root, "state", state.toJson());
+  return root;
+}
+
+void KI1H_FILTER::dataFromJson(json_t *root) {
+  warmStart.fromJson(root);
+  busInput.fromJson(root);
+  if (json_t *j = json_object_get(root, "lpSaturation"))
+    lpSaturation = json_boolean_value(j);
+  if (json_t *j = json_object_get(root, "bankBands")) {
+    const int n = json_integer_value(j);
+    bankBands = n == 8 || n == 16 || n == 32 ? n : 0;
+  }
+  ki1h::StateReader state(json_object_get(root, "state"), STATE_VERSION);
+  lpfilter.loadState(state);
+  bpfilter1.loadState(state);
+  bpfilter2.loadState(state);
+  hpfilter.loadState(state);
+  filterBank.loadState(state);
+  warmStart.stateRestored = state.ok();
 }
 
 KI1H_FILTERWidget::KI1H_FILTERWidget(KI1H_FILTER *module) {
@@ -526,4 +438,23 @@ KI1H_FILTERWidget::KI1H_FILTERWidget(KI1H_FILTER *module) {
                                              module, KI1H_FILTER::FILT2LINK_PARAM));
 }
 
+void KI1H_FILTERWidget::appendContextMenu(Menu *menu) {
+  KI1H_FILTER *module = getModule<KI1H_FILTER>();
+  menu->addChild(new MenuSeparator);
+  menu->addChild(
+      createBoolPtrMenuItem("LP: saturate every ladder stage", "", &module->lpSaturation));
+  // Menu index i selects 4 << i bands.
+  menu->addChild(createIndexSubmenuItem(
+      "Filter bank mode", {"Off", "8 bands", "16 bands", "32 bands"},
+      [=]() {
+        size_t index = 0;
+        while (index < 3 && (4 << index) < module->bankBands)
+          index++;
+        return index;
+      },
+      [=](size_t index) { module->bankBands = index ? 4 << index : 0; }));
+  menu->addChild(module->busInput.createMenuItem());
+  menu->addChild(module->warmStart.createMenuItem());
+}
+
 Model *modelKI1H_FILTER = createModel<KI1H_FILTER, KI1H_FILTERWidget>("KI1H-FILTER");
@@ -1,85 +1,6 @@
-#include "dsp.hpp"
+#include "lfo.hpp"
 #include "plugin.hpp"
 
-// Waveform switch positions. Order must match the configSwitch label lists in
-// the constructor: WAVE1_PARAM / WAVE2_PARAM {"Sine", "Sawtooth", "Pulse"} and
-// SWAVE_PARAM {"Sawtooth", "Ramp", "Triangle"}.
-enum LFOWaves { LFO_SINE, LFO_SAW, LFO_SQUARE };
-enum SHWaves { SH_SAW, SH_RAMP, SH_TRIANGLE };
-
-// External-clock multiplier/divider. Whenever CLOCK_INPUT is patched, the Sample
-// Rate knob is repurposed as a mult/div selector: its travel is quantized to
-// seven power-of-two ratios with the centre detent at unity.
-//   exp:   -3  -2  -1   0  +1  +2  +3
-//   ratio  /8  /4  /2  x1  x2  x4  x8
-static constexpr float SRATE_MIN = -10.f;
-static constexpr float SRATE_MAX = -3.4f;
-static constexpr int CLOCK_RATIO_STEPS = 7;
-
-// Maps a normalized [0,1] knob position to a ratio exponent in [-3, +3].
-static int clockRatioExp(float norm) {
-  int bucket = clamp((int)std::round(norm * (CLOCK_RATIO_STEPS - 1)), 0, CLOCK_RATIO_STEPS - 1);
-  return bucket - (CLOCK_RATIO_STEPS - 1) / 2;
-}
-
-// ============================================================================
-// LFO CLASS DEFINITION
-// ============================================================================
-// Note: SampleAndHold below hides rather than overrides process(), getOutput()
-// and getBlink(). That is fine because both are only ever used through their
-// concrete types; nothing calls them through an LFO*. Marking one of the three
-// virtual bought nothing and implied a polymorphism that does not exist.
-struct LFO {
-  void process(float pitch, int waveType, float sampletime);
-  float getOutput() const {
-    return output;
-  }
-  float getBlink() const {
-    return phase.phase;
-  }
-
-  float output = 0.f;
-  ki1h::Phasor phase;
-};
-
-// ============================================================================
-// SAMPLE AND HOLD CLASS DEFINITION (Inherits from LFO)
-// ============================================================================
-struct SampleAndHold : LFO {
-public:
-  void process(float oscPhase, float clockIn, float sampleRate, int ratioExp, float sampleIn,
-               bool sampInConn, int waveType, float lagTime, float sampleTime, bool needOutput);
-  float getOutput() const {
-    return laggedOutput;
-  }
-  float getClock() const {
-    return clockOutput;
-  }
-
-  ki1h::Phasor clockPhase;
-  float sampledValue = 0.f;
-  float laggedOutput = 0.f;
-  float clockOutput = 0.f;
-  dsp::SchmittTrigger sampleTrigger;
-  // Squares an external clock: turns any input waveform into the gate state that
-  // drives the 0-10 V clock output.
-  dsp::SchmittTrigger extClockGate;
-
-  // External-clock multiplier/divider state (used only while a clock is patched).
-  ki1h::Phasor ratioPhase;   // phase-locked generator for the x N / / N output
-  float estClockFreq = 0.f;  // Hz, estimated from the last measured input period
-  float timeSinceEdge = 0.f; // seconds since the last input rising edge
-  int divCounter = 0;        // input edges counted toward the next / N output edge
-  int cachedRatioExp = 99;   // last ratio, so a knob change re-locks the generator
-
-  // Cached lag coefficient. lagTime is a knob and sampleTime only moves on a
-  // sample-rate change, so the exp() behind it almost never needs redoing.
-  // The sentinels are negative so the first process() call always misses.
-  float lagAlpha = 0.f;
-  float cachedLagTime = -1.f;
-  float cachedSampleTime = -1.f;
-};
-
 // ============================================================================
 // LFO MODULE DEFINITION
 // ============================================================================
@@ -102,190 +23,106 @@ struct KI1H_LFO : Module {
 
   KI1H_LFO();
   void process(const ProcessArgs &args) override;
+  // Rack persists only params. These also save the oscillator phases, the
+  // held S&H value and the clock tracker, so a reloaded patch resumes in step
+  // instead of re-locking to its clock from scratch.
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *root) override;
+  // Layout version of the "state" array; bump it when the fields change.
+  static constexpr int STATE_VERSION = 1;
+  ki1h::WarmStart warmStart;
+  void onAdd(const AddEvent &e) override {
+    warmStart.arm(this, APP->engine->getSampleRate());
+  }
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    SNH.sampleRateChanged();
+  }
+
+  // How hard the mult/div clock follows the external clock: the PLL bandwidth,
+  // as a fraction of the input clock rate, for each context-menu choice.
+  enum ClockTracking { TRACKING_FAST, TRACKING_MEDIUM, TRACKING_SLOW, NUM_TRACKING };
+  static constexpr float TRACKING_BANDWIDTH[NUM_TRACKING] = {0.2f, 0.05f, 0.01f};
+  int clockTracking = TRACKING_MEDIUM;
+  // Use EXTENDED_RATIOS instead of the power-of-two table.
+  bool extendedRatios = false;
+  // Delay of every second pulse of the mult/div clock, from 0 (straight) to 1
+  // (the second pulse lands three quarters of the way through the pair — 75%
+  // swing in drum-machine terms).
+  float swing = 0.f;
+  // MinBLEP-corrected CLOCK_OUTPUT edges, for using the clock at audio rates.
+  bool bandLimitedClock = false;
 
 private:
+  int cachedClockTracking = -1;
   LFO lfo1, lfo2;
   SampleAndHold SNH;
   static constexpr float CV_SCALE = 5.f;
 };
 
+// Indexed at runtime, so C++11 needs it defined as well as declared.
+constexpr float KI1H_LFO::TRACKING_BANDWIDTH[KI1H_LFO::NUM_TRACKING];
+
 // When a clock is patched, the Sample Rate knob is a mult/div selector, so its
 // tooltip should read out the ratio rather than a meaningless free-run frequency.
 struct ClockRateQuantity : ParamQuantity {
   std::string getString() override {
-    if (module && module->inputs[KI1H_LFO::CLOCK_INPUT].isConnected()) {
-      int exp = clockRatioExp(getScaledValue());
-      std::string ratio;
-      if (exp == 0)
-        ratio = "x1";
-      else if (exp > 0)
-        ratio = string::f("x%d", 1 << exp);
-      else
-        ratio = string::f("/%d", 1 << (-exp));
-      return "Clock ratio: " + ratio;
-    }
+    KI1H_LFO *lfo = dynamic_cast<KI1H_LFO *>(module);
+    if (lfo && lfo->inputs[KI1H_LFO::CLOCK_INPUT].isConnected())
+      return std::string("Clock ratio: ") +
+             clockRatio(getScaledValue(), lfo->extendedRatios).label;
     return ParamQuantity::getString();
   }
 };
 
-// ============================================================================
-// LFO WIDGET DEFINITION
-// ============================================================================
-struct KI1H_LFOWidget : ModuleWidget {
-  KI1H_LFOWidget(KI1H_LFO *module);
-};
-void LFO::process(float pitch, int waveType, float sampleTime) {
-
-  float freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+/** Context-menu slider for KI1H_LFO::swing, shown in drum-machine terms: 50%
+is straight, 75% puts the second pulse of each pair three quarters of the way
+through it. */
+struct SwingQuantity : Quantity {
+  KI1H_LFO *module;
+  SwingQuantity(KI1H_LFO *module) : module(module) {}
 
-  // ============================================================================
-  // PHASE ACCUMULATION
-  // ============================================================================
-  // Normal phase accumulation
-  phase.advance(freq, sampleTime);
-
-  // ============================================================================
-  // WAVEFORM GENERATION
-  // ============================================================================
-  // Generate waveform based on type
-  switch (waveType) {
-  case LFO_SINE:
-    output = ki1h::sine(phase.phase);
-    break;
-  case LFO_SAW:
-    output = ki1h::saw(phase.phase);
-    break;
-  case LFO_SQUARE:
-    output = ki1h::square(phase.phase);
-    break;
-  default:
-    output = 0.f;
+  void setValue(float value) override {
+    module->swing = clamp(value, 0.f, 1.f);
   }
-}
-
-// ============================================================================
-// SAMPLE AND HOLD PROCESS METHOD
-// ============================================================================
-void SampleAndHold::process(float oscPhase, float clockIn, float sampleRate, int ratioExp,
-                            float sampleIn, bool sampInConn, int sWaveType, float lagTime,
-                            float sampleTime, bool needOutput) {
-
-  float clockFreq = dsp::FREQ_C4 * dsp::exp2_taylor5(sampleRate);
-  // ============================================================================
-  // PHASE ACCUMULATION
-  // ============================================================================
-  // The clock half always runs: it drives CLOCK_OUTPUT and CLOCK_LIGHT.
-  clockPhase.advance(clockFreq, sampleTime);
-
-  // The clock output is always a clean 0-10 V square. Internally it free-runs off
-  // clockPhase; with a clock patched it squares that input — a bipolar sine, or a
-  // hot/uneven external square — into the same 0-10 V gate via hysteresis
-  // thresholds, so the output level never depends on the input's amplitude.
-  if (sampleRate == -1) {
-    // External clock patched: the Sample Rate knob is a mult/div selector.
-    bool rising = extClockGate.process(clockIn, 0.1f, 1.f);
-    timeSinceEdge += sampleTime;
-
-    // Re-lock the generator cleanly whenever the selected ratio changes, so a
-    // knob turn snaps to the new ratio instead of drifting in from the old phase.
-    if (ratioExp != cachedRatioExp) {
-      cachedRatioExp = ratioExp;
-      ratioPhase.reset();
-      divCounter = 0;
-    }
-
-    if (rising) {
-      // Estimate the input clock rate from the period that just completed.
-      if (timeSinceEdge > 0.f)
-        estClockFreq = 1.f / timeSinceEdge;
-      timeSinceEdge = 0.f;
-    }
-
-    if (ratioExp == 0) {
-      // x1: an exact, jitter-free clone of the squared input.
-      clockOutput = extClockGate.isHigh() ? 10.f : 0.f;
-    } else if (estClockFreq <= 0.f) {
-      // No period measured yet: hold low until the input clock is running.
-      clockOutput = 0.f;
-    } else if (ratioExp > 0) {
-      // x N: generator at N times the input rate, hard-synced to every input edge
-      // so its faster pulses stay phase-locked to the incoming clock.
-      ratioPhase.advance(estClockFreq * (float)(1 << ratioExp), sampleTime);
-      if (rising)
-        ratioPhase.phase = 0.f;
-      clockOutput = ki1h::square(ratioPhase.phase) > 0.f ? 10.f : 0.f;
-    } else {
-      // / N: one output period spans N input periods. Free-run at 1/N the input
-      // rate, re-syncing on every N-th input edge to hold the division locked.
-      int div = 1 << (-ratioExp);
-      ratioPhase.advance(estClockFreq / (float)div, sampleTime);
-      if (rising && ++divCounter >= div) {
-        divCounter = 0;
-        ratioPhase.phase = 0.f;
-      }
-      clockOutput = ki1h::square(ratioPhase.phase) > 0.f ? 10.f : 0.f;
-    }
-  } else {
-    cachedRatioExp = 99; // force a clean re-lock when a clock is next patched
-    clockOutput = ki1h::square(clockPhase.phase) > 0.f ? 10.f : 0.f;
+  float getValue() override {
+    return module->swing;
   }
-
-  // Everything below feeds SWAVE_OUTPUT only, so it can be skipped when that jack
-  // is empty — saving the waveform generator, a Schmitt trigger and an exp.
-  if (!needOutput)
-    return;
-
-  // The S&H oscillator runs at lfo2's pitch, so it takes lfo2's phase directly
-  // rather than accumulating a bit-identical copy of it (and paying a second
-  // exp2 per sample to do so). The clock phase above is genuinely independent.
-  phase.phase = oscPhase;
-
-  // ============================================================================
-  // S&H SPECIFIC WAVEFORM GENERATION
-  // ============================================================================
-  // Generate S&H waveforms (different from regular LFO waveforms)
-  switch (sWaveType) {
-  case SH_SAW:
-    output = ki1h::saw(phase.phase);
-    break;
-  case SH_RAMP:
-    output = ki1h::ramp(phase.phase);
-    break;
-  case SH_TRIANGLE:
-    output = ki1h::triangle(phase.phase);
-    break;
-  default:
-    output = 0.f;
+  float getDefaultValue() override {
+    return 0.f;
   }
-
-  // ============================================================================
-  // SAMPLE ON TRIGGER RISING EDGE
-  // ============================================================================
-  // The S&H tracks the raw incoming clock unmodified: with an external clock
-  // patched it samples on the input's own edges, independent of the mult/div
-  // ratio applied to CLOCK_OUTPUT. Free-running, it follows the internal clock.
-  float sampleClock = (sampleRate == -1) ? (extClockGate.isHigh() ? 10.f : 0.f) : clockOutput;
-  // Use Schmitt trigger for robust edge detection with hysteresis
-  if (sampleTrigger.process(sampleClock)) {
-    // Sample the current oscillator output value on rising edge
-    sampledValue = sampInConn ? sampleIn : output;
+  float getDisplayValue() override {
+    return 50.f + 25.f * getValue();
   }
+  void setDisplayValue(float displayValue) override {
+    setValue((displayValue - 50.f) / 25.f);
+  }
+  int getDisplayPrecision() override {
+    return 3;
+  }
+  std::string getLabel() override {
+    return "Clock swing";
+  }
+  std::string getUnit() override {
+    return "%";
+  }
+};
 
-  // ============================================================================
-  // APPLY EXPONENTIAL LAG TO SAMPLED VALUE
-  // ============================================================================
-  // Recompute only when the knob or the sample rate actually moves.
-  if (lagTime != cachedLagTime || sampleTime != cachedSampleTime) {
-    cachedLagTime = lagTime;
-    cachedSampleTime = sampleTime;
-    // Time constant for 99% settling in lagTime
-    float timeConstant = lagTime / 4.605f;
-    lagAlpha = 1.0f - std::exp(-sampleTime / timeConstant);
+struct SwingSlider : ui::Slider {
+  SwingSlider(KI1H_LFO *module) {
+    quantity = new SwingQuantity(module);
   }
+  ~SwingSlider() {
+    delete quantity;
+  }
+};
 
-  // Apply lag filtering to the sampled value
-  laggedOutput = lagAlpha * sampledValue + (1.0f - lagAlpha) * laggedOutput;
-}
+// ============================================================================
+// LFO WIDGET DEFINITION
+// ============================================================================
+struct KI1H_LFOWidget : ModuleWidget {
+  KI1H_LFOWidget(KI1H_LFO *module);
+  void appendContextMenu(Menu *menu) override;
+};
 
 KI1H_LFO::KI1H_LFO() {
   // ============================================================================
@@ -329,6 +166,8 @@ KI1H_LFO::KI1H_LFO() {
 }
 
 void KI1H_LFO::process(const ProcessArgs &args) {
+  if (warmStart.step(this, args))
+    return;
   // ============================================================================
   // LFO 1 - PITCH
   // ============================================================================
@@ -387,17 +226,22 @@ void KI1H_LFO::process(const ProcessArgs &args) {
     sampleIn = inputs[SAMP_INPUT].getVoltage() * 0.2f;
   float clockIn = inputs[CLOCK_INPUT].getVoltage();
   bool clockConn = inputs[CLOCK_INPUT].isConnected();
-  int ratioExp = 0;
+  const ClockRatio *ratio = &POW2_RATIOS[3]; // x1; unused while free-running
   if (clockConn) {
     sRate = -1.f;
     // Repurpose the Sample Rate knob as the mult/div selector (centre = x1).
     float norm = (params[SRATE_PARAM].getValue() - SRATE_MIN) / (SRATE_MAX - SRATE_MIN);
-    ratioExp = clockRatioExp(norm);
+    ratio = &clockRatio(norm, extendedRatios);
+  }
+
+  if (clockTracking != cachedClockTracking) {
+    cachedClockTracking = clockTracking;
+    SNH.pll.setBandwidth(TRACKING_BANDWIDTH[clockTracking]);
   }
 
   // lfo2.process() above has already advanced lfo2.phase for this sample.
-  SNH.process(lfo2.phase.phase, clockIn, sRate, ratioExp, sampleIn, ext, sWaveType, lagTime,
-              args.sampleTime, outputs[SWAVE_OUTPUT].isConnected());
+  SNH.process(lfo2.phase.phase, clockIn, sRate, *ratio, swing, bandLimitedClock, sampleIn, ext,
+              sWaveType, lagTime, args.sampleTime, outputs[SWAVE_OUTPUT].isConnected());
   outputs[SWAVE_OUTPUT].setVoltage(CV_SCALE * SNH.getOutput());
   // getClock() already returns the finished 0-10 V square, so no CV_SCALE here.
   outputs[CLOCK_OUTPUT].setVoltage(SNH.getClock());
@@ -409,6 +253,45 @@ void KI1H_LFO::process(const ProcessArgs &args) {
   lights[CLOCK_LIGHT].setBrightness(SNH.getClock() > 5.f ? 1.f : 0.f);
 }
 
+// ============================================================================
+// STATE PERSISTENCE
+// ============================================================================
+json_t *KI1H_LFO::dataToJson() {
+  json_t *root = json_object();
+  json_object_set_new(root, "clockTracking", json_integer(clockTracking));
+  json_object_set_new(root, "extendedRatios", json_boolean(extendedRatios));
+  json_object_set_new(root, "swing", json_real(swing));
+  json_object_set_new(root, "bandLimitedClock", json_boolean(bandLimitedClock));
+  warmStart.toJson(root);
+
+  ki1h::StateWriter state(STATE_VERSION);
+  state.put(lfo1.phase.phase);
+  state.put(lfo2.phase.phase);
+  SNH.saveState(state);
+  json_object_set_new(root, "state", state.toJson());
+  return root;
+}
+
+void KI1H_LFO::dataFromJson(json_t *root) {
+  if (json_t *j = json_object_get(root, "clockTracking"))
+    clockTracking = clamp((int)json_integer_value(j), 0, NUM_TRACKING - 1);
+  if (json_t *j = json_object_get(root, "extendedRatios"))
+    extendedRatios = json_boolean_value(j);
+  if (json_t *j = json_object_get(root, "swing"))
+    swing = clamp((float)json_number_value(j), 0.f, 1.f);
+  if (json_t *j = json_object_get(root, "bandLimitedClock"))
+    bandLimitedClock = json_boolean_value(j);
+  warmStart.fromJson(root);
+
+  ki1h::StateReader state(json_object_get(root, "state"), STATE_VERSION);
+  state.get(lfo1.phase.phase);
+  state.get(lfo2.phase.phase);
+  SNH.loadState(state);
+  warmStart.stateRestored = state.ok();
+  lfo1.phase.phase -= std::floor(lfo1.phase.phase);
+  lfo2.phase.phase -= std::floor(lfo2.phase.phase);
+}
+
 KI1H_LFOWidget::KI1H_LFOWidget(KI1H_LFO *module) {
   setModule(module);
   setPanel(createPanel(asset::plugin(pluginInstance, "res/KI1H-LFO.svg")));
@@ -474,4 +357,22 @@ KI1H_LFOWidget::KI1H_LFOWidget(KI1H_LFO *module) {
                                              KI1H_LFO::CLOCK_OUTPUT));
 }
 
+void KI1H_LFOWidget::appendContextMenu(Menu *menu) {
+  KI1H_LFO *module = getModule<KI1H_LFO>();
+  menu->addChild(new MenuSeparator);
+  menu->addChild(createIndexPtrSubmenuItem(
+      "External clock tracking",
+      {"Fast: follows tempo changes", "Medium", "Slow: smooths out jitter"},
+      &module->clockTracking));
+  menu->addChild(
+      createBoolPtrMenuItem("Extended clock ratios", "", &module->extendedRatios));
+  SwingSlider *swing = new SwingSlider(module);
+  swing->box.size.x = 200.f;
+  menu->addChild(swing);
+  menu->addChild(
+      createBoolPtrMenuItem("Band-limited clock output", "", &module->bandLimitedClock));
+  menu->addChild(new MenuSeparator);
+  menu->addChild(module->warmStart.createMenuItem());
+}
+
 Model *modelKI1H_LFO = createModel<KI1H_LFO, KI1H_LFOWidget>("KI1H-LFO");
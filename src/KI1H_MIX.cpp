@@ -1,29 +1,9 @@
-#include "dsp.hpp"
+#include "mix.hpp"
 #include "plugin.hpp"
 #include <array>
 #include <numeric>
 #include <string>
 
-// ============================================================================
-// MIX CLASS DEFINITION
-// ============================================================================
-struct Mix {
-  void process(const std::array<float, 5> &all);
-  float getAllOut() const {
-    return allOut;
-  }
-  float getLeftOut() const {
-    return leftOut;
-  }
-  float getRightOut() const {
-    return rightOut;
-  }
-
-  float allOut = 0.f;
-  float leftOut = 0.f;
-  float rightOut = 0.f;
-};
-
 // ============================================================================
 // MIX MODULE DEFINITION
 // ============================================================================
@@ -68,9 +48,21 @@ struct KI1H_MIX : Module {
 
   KI1H_MIX();
   void process(const ProcessArgs &args) override;
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
+  }
 
 private:
   ki1h::Channel channels[5];
+  // The faders and the CV attenuverters, slewed so that a move does not
+  // zipper.
+  ki1h::SmoothedParam faders[5], attenuverters[5];
+  void setSampleTime(float sampleTime) {
+    for (int i = 0; i < 5; i++) {
+      faders[i].configure(sampleTime);
+      attenuverters[i].configure(sampleTime);
+    }
+  }
   Mix mix;
   static constexpr float CV_SCALE = 5.f;
 };
@@ -82,23 +74,6 @@ struct KI1H_MIXWidget : ModuleWidget {
   KI1H_MIXWidget(KI1H_MIX *module);
 };
 
-// ============================================================================
-// MIX PROCESS METHOD
-// ============================================================================
-void Mix::process(const std::array<float, 5> &all) {
-  std::array<float, 2> evens;
-  std::array<float, 3> odds;
-  for (std::size_t i = 0; i < all.size(); i++) {
-    if (i % 2 == 0)
-      odds[i / 2] = all[i];
-    else
-      evens[i / 2] = all[i];
-  }
-  allOut = ki1h::softLimit(std::accumulate(all.begin(), all.end(), 0.0f));
-  leftOut = ki1h::softLimit(std::accumulate(odds.begin(), odds.end(), 0.0f));
-  rightOut = ki1h::softLimit(std::accumulate(evens.begin(), evens.end(), 0.0f));
-}
-
 // ============================================================================
 // MODULE CONFIGURATION
 // ============================================================================
@@ -118,6 +93,7 @@ KI1H_MIX::KI1H_MIX() {
   configOutput(ALL_OUTPUT, "All");
   configOutput(L_OUTPUT, "Odds");
   configOutput(R_OUTPUT, "Evens");
+  setSampleTime(APP->engine->getSampleTime());
 }
 
 void KI1H_MIX::process(const ProcessArgs &args) {
@@ -131,11 +107,12 @@ void KI1H_MIX::process(const ProcessArgs &args) {
     // still modulate it, but this synthesized signal never reaches the mix.
     float input = inputConnected ? inputs[IN1_INPUT + i].getVoltage() : 5.f;
     // Fader position doubles as the channel level.
-    float attenuverter = params[MIX1_PARAM + i].getValue();
+    float attenuverter = faders[i].process(params[MIX1_PARAM + i].getValue());
+    const float cvAmount = attenuverters[i].process(params[ATT1_PARAM + i].getValue());
     float cv = 0.0f;
 
     if (inputs[CV1_INPUT + i].isConnected())
-      cv = (inputs[CV1_INPUT + i].getVoltage() * params[ATT1_PARAM + i].getValue()) / CV_SCALE;
+      cv = (inputs[CV1_INPUT + i].getVoltage() * cvAmount) / CV_SCALE;
 
     // Process channel with CV scaled attenuverter
     channels[i].process(input, attenuverter + cv);
@@ -157,6 +134,14 @@ void KI1H_MIX::process(const ProcessArgs &args) {
   outputs[L_OUTPUT].setVoltage(mix.getLeftOut());
   outputs[ALL_OUTPUT].setVoltage(mix.getAllOut());
   outputs[R_OUTPUT].setVoltage(mix.getRightOut());
+
+  if (BusMessage *busOut = busOutput(this)) {
+    busOut->lanes[0] = mix.getLeftOut();
+    busOut->lanes[1] = mix.getRightOut();
+    busOut->lanes[2] = mix.getAllOut();
+    busOut->lanes[3] = 0.f;
+    busOut->fresh = true;
+  }
 }
 
 KI1H_MIXWidget::KI1H_MIXWidget(KI1H_MIX *module) {
@@ -1,25 +1,9 @@
-#include "dsp.hpp"
+#include "vca.hpp"
 #include "plugin.hpp"
 #include <algorithm>
 #include <array>
 #include <string>
 
-// ============================================================================
-// VCA CLASS DEFINITION
-// ============================================================================
-struct VCA {
-  void process(const std::array<float, 5> &channels, const std::array<float, 5> &pans);
-  float getLeftOut() const {
-    return leftOut;
-  }
-  float getRightOut() const {
-    return rightOut;
-  }
-
-  float leftOut = 0.f;
-  float rightOut = 0.f;
-};
-
 // ============================================================================
 // VCA MODULE DEFINITION
 // ============================================================================
@@ -44,9 +28,21 @@ struct KI1H_VCA : Module {
 
   KI1H_VCA();
   void process(const ProcessArgs &args) override;
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *root) override;
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
+  }
+  BusInput busInput;
 
 private:
   ki1h::Channel channels[5];
+  // The level sliders, slewed so that a move does not zipper.
+  ki1h::SmoothedParam levels[5];
+  void setSampleTime(float sampleTime) {
+    for (ki1h::SmoothedParam &l : levels)
+      l.configure(sampleTime);
+  }
   VCA mix;
 };
 
@@ -55,37 +51,9 @@ private:
 // ============================================================================
 struct KI1H_VCAWidget : ModuleWidget {
   KI1H_VCAWidget(KI1H_VCA *module);
+  void appendContextMenu(Menu *menu) override;
 };
 
-// ============================================================================
-// VCA PROCESS METHOD
-// ============================================================================
-void VCA::process(const std::array<float, 5> &channels, const std::array<float, 5> &pans) {
-  float leftSum = 0.f;
-  float rightSum = 0.f;
-
-  // Distribute each channel to left/right based on panning
-  // Pan: -1 = full left, 0 = center, +1 = full right
-  for (int i = 0; i < 5; i++) {
-    float pan = pans[i];
-    // Clamp pan to [-1, 1] range
-    pan = std::max(-1.f, std::min(1.f, pan));
-
-    // Calculate left and right gains (linear panning)
-    // When pan = -1: left = 1, right = 0
-    // When pan = 0: left = 0.5, right = 0.5
-    // When pan = +1: left = 0, right = 1
-    float leftGain = (1.f - pan) * 0.5f;
-    float rightGain = (1.f + pan) * 0.5f;
-
-    leftSum += channels[i] * leftGain;
-    rightSum += channels[i] * rightGain;
-  }
-
-  leftOut = ki1h::softLimit(leftSum);
-  rightOut = ki1h::softLimit(rightSum);
-}
-
 // ============================================================================
 // MODULE CONFIGURATION
 // ============================================================================
@@ -106,19 +74,26 @@ KI1H_VCA::KI1H_VCA() {
   panCv2Switch->snapEnabled = true;
   configOutput(L_OUTPUT, "Left");
   configOutput(R_OUTPUT, "Right");
+  busInput.attach(this);
+  setSampleTime(APP->engine->getSampleTime());
 }
 
 void KI1H_VCA::process(const ProcessArgs &args) {
   std::array<float, 5> channelOutputs;
   std::array<float, 5> panValues;
 
+  // A bus sender on the left feeds IN1-IN4 where they have no cable.
+  const BusMessage *bus = busInput.receive(this);
+
   // Process all 5 channels
   for (int i = 0; i < 5; i++) {
     // Get input signal
     float input = inputs[IN1_INPUT + i].getVoltage();
+    if (bus && i < BusMessage::LANES && !inputs[IN1_INPUT + i].isConnected())
+      input = bus->lanes[i];
 
     // Get level parameter (0-1 range)
-    float level = params[MIX1_PARAM + i].getValue();
+    float level = levels[i].process(params[MIX1_PARAM + i].getValue());
 
     // Get pan parameter
     float pan = params[PAN1_PARAM + i].getValue();
@@ -171,6 +146,16 @@ void KI1H_VCA::process(const ProcessArgs &args) {
   outputs[R_OUTPUT].setVoltage(mix.getRightOut());
 }
 
+json_t *KI1H_VCA::dataToJson() {
+  json_t *root = json_object();
+  busInput.toJson(root);
+  return root;
+}
+
+void KI1H_VCA::dataFromJson(json_t *root) {
+  busInput.fromJson(root);
+}
+
 KI1H_VCAWidget::KI1H_VCAWidget(KI1H_VCA *module) {
   setModule(module);
   setPanel(createPanel(asset::plugin(pluginInstance, "res/KI1H-VCA.svg")));
@@ -206,4 +191,10 @@ KI1H_VCAWidget::KI1H_VCAWidget(KI1H_VCA *module) {
   }
 }
 
+void KI1H_VCAWidget::appendContextMenu(Menu *menu) {
+  KI1H_VCA *module = getModule<KI1H_VCA>();
+  menu->addChild(new MenuSeparator);
+  menu->addChild(module->busInput.createMenuItem());
+}
+
 Model *modelKI1H_VCA = createModel<KI1H_VCA, KI1H_VCAWidget>("KI1H-VCA");
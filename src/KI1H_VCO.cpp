@@ -1,134 +1,9 @@
 // ============================================================================
 // INCLUDES & GLOBAL VARIABLES
 // ============================================================================
-#include "dsp.hpp"
+#include "vco.hpp"
 #include "plugin.hpp"
 
-// Waveform switch positions. Order must match the configSwitch label lists in
-// the constructor: WAVE_PARAM {"Triangle", "Sawtooth", "Pulse"} and
-// WAVE2_PARAM {"Sin-Saw", "Pulse"}.
-enum Waves { WAVE_TRI, WAVE_SAW, WAVE_SQ };
-enum ShaperWaves { SHAPER_SINSAW, SHAPER_PULSE };
-
-// ============================================================================
-// OSCILLATOR BASE CLASS
-// ============================================================================
-/** Sub-sample position, in (-1, 0], at which a phase running at `delta` per
-sample crossed threshold `t` during the sample that ended at `phase`.
-
-`phase` is the post-wrap value in [0, 1) and `wrapped` says whether it passed
-1.0 on the way. Returns 1.f when no crossing happened, which callers test with
-`<= 0.f`. The result is exactly what MinBlepGenerator::insertDiscontinuity
-wants, and is clamped to stay inside its required open interval. */
-static float phaseCrossing(float phase, float delta, bool wrapped, float t) {
-  if (delta <= 0.f)
-    return 1.f;
-  // Work in un-wrapped coordinates so a crossing that straddles the wrap is
-  // just an ordinary interval test.
-  const float end = phase + (wrapped ? 1.f : 0.f);
-  const float start = end - delta;
-
-  float hit = -1.f;
-  if (start < t && t <= end)
-    hit = t;
-  else if (start < t + 1.f && t + 1.f <= end)
-    hit = t + 1.f;
-  if (hit < 0.f)
-    return 1.f;
-
-  float p = -(end - hit) / delta;
-  // insertDiscontinuity requires -1 < p <= 0 and silently ignores anything
-  // else, which would leave the discontinuity uncorrected.
-  if (p <= -1.f)
-    p = -0.999999f;
-  if (p > 0.f)
-    p = 0.f;
-  return p;
-}
-
-struct Oscillator {
-  float getOutput() const {
-    return output;
-  }
-  float getBlink() const {
-    return blinkPhase;
-  }
-  float getSin() const {
-    return sin;
-  }
-
-  ki1h::Phasor phase;
-  float output = 0.f;
-  // Not an alias for phase.phase: updatePhases sets this before the subclasses
-  // apply hard/soft sync, so it holds the pre-sync phase. The blink LEDs read it.
-  float blinkPhase = 0.f;
-  float sin = 0.f;
-
-  // Set by updatePhases, consumed by the band-limiting in the subclasses.
-  float deltaPhase = 0.f;
-  bool wrapped = false;
-
-  /** phaseCrossing() for this oscillator's current step. */
-  float crossing(float t) const {
-    return phaseCrossing(phase.phase, deltaPhase, wrapped, t);
-  }
-
-  void updatePhases(float freq, float sampleTime);
-  float calculateFreq(float pitch);
-  /** The pulse-width clamp ki1h::square applies, exposed so the crossing
-  detection uses the same threshold the waveform does. */
-  static float clampPulseWidth(float pw) {
-    return clamp(pw, 0.1f, 0.9f);
-  }
-};
-
-// ============================================================================
-// RAW PURE WAVEFORM OSCILLATOR
-// ============================================================================
-struct RawOscillator : Oscillator {
-  void process(float pitch, float pulseWidth, int waveType, float sampleTime, bool needSub);
-  float getSub() const {
-    return sub;
-  }
-
-  ki1h::Phasor subPhase;
-  float sub = 0.f;
-
-  // One generator per discontinuous output. 16 zero-crossings at 16x
-  // oversampling is what Rack's own VCO uses.
-  dsp::MinBlepGenerator<16, 16> mainBlep;
-  dsp::MinBlepGenerator<16, 16> subBlep;
-};
-
-// ============================================================================
-// WAVESHAPING OSCILLATOR
-// ============================================================================
-struct ShaperOscillator : Oscillator {
-  void process(float pitch, float linFM, float am, int syncType, float syncVal, float shape,
-               int waveType, float sampleTime, bool needOutput);
-
-  float generateShapedWave(float ph, float shape);
-  /** The naive waveform at an arbitrary phase. Used to measure the size of the
-  jump a hard-sync reset introduces. */
-  float waveAt(float ph, float shape, int waveType);
-
-  dsp::MinBlepGenerator<16, 16> blep;
-
-  // Per-instance: the engine runs modules across worker threads, so a shared
-  // trigger would both steal edges between VCOs and race on its own state.
-  dsp::SchmittTrigger syncTrigger;
-  float prevSyncVal = 0.f;
-
-  // The harmonic amplitudes depend only on `shape`, which is a knob plus CV —
-  // control rate, not audio rate. Cache them so the per-sample loop is
-  // multiply-add only.
-  static const int MAX_HARMONICS = 9;
-  float harmonicCoef[MAX_HARMONICS] = {};
-  int numHarmonics = 0;
-  float cachedShape = -1e9f;
-  void updateHarmonics(float shape);
-};
-
 // ============================================================================
 // VCO MODULE DEFINITION
 // ============================================================================
@@ -163,10 +38,59 @@ struct KI1H_VCO : Module {
 
   KI1H_VCO();
   void process(const ProcessArgs &args) override;
+  // Besides the menu options, these save the oscillator phases, so a reloaded
+  // patch keeps the phase relationships between VCOs it was saved with.
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *root) override;
+  // Layout version of the "state" array; bump it when the fields change.
+  static constexpr int STATE_VERSION = 1;
+  ki1h::WarmStart warmStart;
+  void onAdd(const AddEvent &e) override {
+    warmStart.arm(this, APP->engine->getSampleRate());
+  }
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
+  }
+
+  /** LIN FM lets osc2's phase run backward when the modulation drives its
+  frequency below zero. Off, the phase increment stops at zero instead, like
+  a linear-FM VCO that is not through-zero. */
+  bool throughZeroFM = true;
+  /** Both oscillators run at this multiple of the engine rate, 1, 2, 4 or 8,
+  and are decimated back down. MinBLEPs band-limit the edges they know about;
+  oversampling is for what they cannot see — deep audio-rate FM, hard sync
+  from an external source, and the shaper's raw-saw shortcut. */
+  int oversample = 1;
+  /** Number of osc1 voices on WAVE_OUTPUT. Above 1 the unison bank replaces
+  osc1's own output there; osc1 itself keeps running undetuned for the sub,
+  the blink light and the sync and FM it normals into osc2. */
+  int unisonVoices = 1;
+  /** Detune of the outermost unison voices, in cents either side. */
+  float unisonDetune = 20.f;
+  /** Unison on WAVE_OUTPUT as two channels, left and right, instead of a mono
+  sum. */
+  bool unisonStereo = true;
+  static constexpr float UNISON_DETUNE_MAX = 100.f;
 
 private:
   RawOscillator osc1;
   ShaperOscillator osc2;
+  UnisonOscillator unison;
+  BlepBank bleps;
+  // All four oversampled outputs in one float_4 cascade: lane 0 WAVE (left in
+  // unison stereo), 1 unison right, 2 SUB, 3 WAVE2.
+  ki1h::HalfBandCascade<simd::float_4> decimator;
+  // The factor the decimator's state belongs to. When the menu changes
+  // `oversample` its delay lines hold samples at the old rate, so they are
+  // cleared rather than run on.
+  int activeOversample = 1;
+  // The SHAPE knob, slewed. Osc 2 redoes its harmonic table whenever the shape
+  // moves, so while it slews that happens once per KNOB_BATCH samples.
+  ki1h::SmoothedParam shapeKnob;
+  static const int KNOB_BATCH = 16;
+  void setSampleTime(float sampleTime) {
+    shapeKnob.configure(sampleTime, ki1h::SmoothedParam::DEFAULT_TIME, KNOB_BATCH);
+  }
   static constexpr float CV_SCALE = 5.f;
   static constexpr float PWM_OFFSET = 5.5f;
 };
@@ -174,271 +98,59 @@ private:
 // ============================================================================
 // VCO WIDGET DEFINITION
 // ============================================================================
-struct KI1H_VCOWidget : ModuleWidget {
-  KI1H_VCOWidget(KI1H_VCO *module);
-};
+/** Context-menu slider for KI1H_VCO::unisonDetune. */
+struct UnisonDetuneQuantity : Quantity {
+  KI1H_VCO *module;
+  UnisonDetuneQuantity(KI1H_VCO *module) : module(module) {}
 
-// ============================================================================
-// OSCILLATOR CLASS - SHARED FUNCTION
-// ============================================================================
-float Oscillator::calculateFreq(float pitch) {
-  // Calculate frequency from pitch (1V/octave). exp2_taylor5 is accurate to
-  // well under a cent over the audio range and about an order of magnitude
-  // cheaper than a generic std::pow with a runtime exponent.
-  return dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
-}
-
-void Oscillator::updatePhases(float freq, float sampleTime) {
-  deltaPhase = freq * sampleTime;
-  wrapped = phase.advance(freq, sampleTime);
-
-  blinkPhase = phase.phase;
-}
-
-// ============================================================================
-// RAWOSCILLATOR CLASS
-// ============================================================================
-void RawOscillator::process(float pitch, float pulseWidth, int waveType, float sampleTime,
-                            bool needSub) {
-  float freq = calculateFreq(pitch);
-
-  updatePhases(freq, sampleTime);
-
-  sin = ki1h::sine(phase.phase);
-
-  // ==========================================================================
-  // SUB OSCILLATOR (50% square, one octave down)
-  // ==========================================================================
-  // The sub oscillator feeds SUB_OUTPUT and nothing else, so it can be skipped
-  // outright when that jack is empty. osc1's main output and sine cannot: they
-  // normal into osc2's sync and FM.
-  if (needSub) {
-    const float subFreq = freq / 2.f;
-    const float subDelta = subFreq * sampleTime;
-    const bool subWrapped = subPhase.advance(subFreq, sampleTime);
-
-    // Steps from -1 to +1 at phase 0 and back at phase 0.5.
-    float sp = phaseCrossing(subPhase.phase, subDelta, subWrapped, 0.f);
-    if (sp <= 0.f)
-      subBlep.insertDiscontinuity(sp, 2.f);
-    sp = phaseCrossing(subPhase.phase, subDelta, subWrapped, 0.5f);
-    if (sp <= 0.f)
-      subBlep.insertDiscontinuity(sp, -2.f);
-
-    sub = ki1h::square(subPhase.phase) + subBlep.process();
-  } else {
-    sub = 0.f;
-  }
-
-  // ==========================================================================
-  // MAIN WAVEFORM
-  // ==========================================================================
-  // Each hard edge gets a MinBLEP of the same magnitude as the jump, placed at
-  // the sub-sample instant it actually happened. mainBlep.process() is called
-  // exactly once per sample whatever the waveform, so switching waveform lets
-  // any residual correction decay out rather than desyncing the buffer.
-  switch (waveType) {
-  case WAVE_TRI:
-    // Triangle is continuous. Its slope discontinuity would need a MinBLAMP,
-    // which the SDK does not ship; it also aliases far less (-12 dB/oct
-    // against a saw's -6).
-    output = ki1h::triangle(phase.phase);
-    break;
-  case WAVE_SAW: {
-    // Falling saw: steps from -1 up to +1 at the wrap.
-    const float p = crossing(0.f);
-    if (p <= 0.f)
-      mainBlep.insertDiscontinuity(p, 2.f);
-    output = ki1h::saw(phase.phase);
-    break;
+  void setValue(float value) override {
+    module->unisonDetune = clamp(value, getMinValue(), getMaxValue());
   }
-  case WAVE_SQ: {
-    const float pw = clampPulseWidth(pulseWidth);
-    const float pRise = crossing(0.f);
-    if (pRise <= 0.f)
-      mainBlep.insertDiscontinuity(pRise, 2.f);
-    const float pFall = crossing(pw);
-    if (pFall <= 0.f)
-      mainBlep.insertDiscontinuity(pFall, -2.f);
-    output = ki1h::square(phase.phase, pw);
-    break;
+  float getValue() override {
+    return module->unisonDetune;
   }
-  default:
-    output = 0.f;
-  }
-
-  output += mainBlep.process();
-}
-
-// ============================================================================
-// SHAPEROSCILLATOR CLASS
-// ============================================================================
-void ShaperOscillator::process(float pitch, float linFM, float AM, int syncType, float syncVal,
-                               float shape, int waveType, float sampleTime, bool needOutput) {
-  float freq = calculateFreq(pitch);
-
-  // Apply linear FM directly to frequency BEFORE phase update
-  freq += freq * linFM * 0.1f;
-
-  updatePhases(freq, sampleTime);
-  // ============================================================================
-  // SYNC PROCESSING
-  // ============================================================================
-  // Hard sync - digital reset when sync signal crosses threshold
-  bool synced = false;
-  if (syncType == 2) {
-    if (syncTrigger.process(syncVal)) {
-      // Locate the crossing of the trigger's 1.0 threshold within this sample
-      // by interpolating the sync input, then correct the step the reset puts
-      // in the output. Without this the reset is a raw discontinuity.
-      const float before = waveAt(phase.phase, shape, waveType);
-      phase.reset();
-      const float after = waveAt(phase.phase, shape, waveType);
-
-      const float rise = syncVal - prevSyncVal;
-      const float frac = (rise > 0.f) ? (syncVal - 1.f) / rise : 0.f;
-      float p = -clamp(frac, 0.f, 0.999999f);
-      blep.insertDiscontinuity(p, after - before);
-      synced = true;
-    }
+  float getMinValue() override {
+    return 0.f;
   }
-  prevSyncVal = syncVal;
-
-  // Soft sync - analog-modeled continuous phase pulling
-  // The sync signal creates a "force" that pulls the phase toward reset
-  if (syncType == 0) {
-    float syncPull = 0.f;
-    if (syncVal > 0.1f) { // Only pull when sync signal is above noise floor
-      // Create exponential pull force - stronger as phase increases
-      float pullStrength = syncVal * 0.2f;     // Scale sync signal
-      // Quadratic pull (gets stronger near end of cycle)
-      syncPull = pullStrength * phase.phase * phase.phase;
-
-      // Pull phase backward toward 0, creating the chaotic analog behavior
-      phase.phase -= syncPull * sampleTime * freq;
-
-      // Prevent phase from going negative
-      if (phase.phase < 0.f)
-        phase.reset();
-    }
+  float getMaxValue() override {
+    return KI1H_VCO::UNISON_DETUNE_MAX;
   }
-
-  sin = ki1h::sine(phase.phase);
-
-  // generateShapedWave is the most expensive routine in the plugin. Skip it
-  // when WAVE2_OUTPUT is empty. The phase accumulation and sync above still
-  // run, so BLINK2_LIGHT keeps blinking whether or not anything is patched.
-  // blep still has to be processed: hard sync inserts a discontinuity above,
-  // and leaving it in the buffer would fire as a burst on reconnection.
-  if (!needOutput) {
-    blep.process();
-    output = 0.f;
-    return;
+  float getDefaultValue() override {
+    return 20.f;
   }
-
-  // Band-limiting. When a sync reset already happened this sample its BLEP
-  // covers the jump, so the natural wrap must not be corrected as well.
-  switch (waveType) {
-  case SHAPER_SINSAW:
-    // The Fourier series in generateShapedWave is a sum of sines and is
-    // already band-limited. Its `harmonicReduction < 0.01` shortcut is not —
-    // that path returns a raw rising saw, which steps from +1 down to -1.
-    if (!synced && std::abs(1.f - shape) < 0.01f) {
-      const float p = crossing(0.f);
-      if (p <= 0.f)
-        blep.insertDiscontinuity(p, -2.f);
-    }
-    output = generateShapedWave(phase.phase, shape);
-    break;
-  case SHAPER_PULSE: {
-    if (!synced) {
-      const float pw = clampPulseWidth(shape);
-      const float pRise = crossing(0.f);
-      if (pRise <= 0.f)
-        blep.insertDiscontinuity(pRise, 2.f);
-      const float pFall = crossing(pw);
-      if (pFall <= 0.f)
-        blep.insertDiscontinuity(pFall, -2.f);
-    }
-    output = ki1h::square(phase.phase, shape);
-    break;
+  int getDisplayPrecision() override {
+    return 3;
   }
-  default:
-    output = 0.f;
+  std::string getLabel() override {
+    return "Unison detune";
   }
-
-  output += blep.process();
-  output *= AM;
-}
-
-float ShaperOscillator::waveAt(float ph, float shape, int waveType) {
-  switch (waveType) {
-  case 0:
-    return generateShapedWave(ph, shape);
-  case 1:
-    return ki1h::square(ph, shape);
-  default:
-    return 0.f;
+  std::string getUnit() override {
+    return " cents";
   }
-}
+};
 
-/** Recomputes the per-harmonic amplitudes for a given shape.
-
-Each is (1/h) * (1 - harmonicReduction)^(h-1). Building the power by repeated
-multiplication instead of std::pow removes every pow from the audio path, and
-handles a negative base — reachable when shape CV pushes shape outside
-[0, 2] — the same way the integer-exponent pow did. */
-void ShaperOscillator::updateHarmonics(float shape) {
-  cachedShape = shape;
-
-  const float harmonicReduction = std::abs(1.f - shape);
-  numHarmonics = (int)(8.f * (1.f - harmonicReduction)) + 1;
-  if (numHarmonics > MAX_HARMONICS)
-    numHarmonics = MAX_HARMONICS;
-
-  const float base = 1.f - harmonicReduction;
-  float gain = 1.f; // base^(h-1)
-  for (int h = 1; h <= numHarmonics; h++) {
-    harmonicCoef[h - 1] = gain / h; // (1/h) is the sawtooth harmonic series
-    gain *= base;
+struct UnisonDetuneSlider : ui::Slider {
+  UnisonDetuneSlider(KI1H_VCO *module) {
+    quantity = new UnisonDetuneQuantity(module);
   }
-}
-
-float ShaperOscillator::generateShapedWave(float ph, float shape) {
-  // harmonicReduction: 0.0 = full saw, 1.0 = approaching sine
-  if (std::abs(1.f - shape) < 0.01f)
-    return ph * 2.f - 1.f; // Pure sawtooth
-
-  if (shape != cachedShape)
-    updateHarmonics(shape);
-
-  // sin(h * theta) is built by angle addition from sin(theta) and cos(theta),
-  // so the whole series costs one sin and one cos instead of one sin per
-  // harmonic. This is an identity, not an approximation:
-  //   sin((h+1)t) = sin(ht)cos(t) + cos(ht)sin(t)
-  //   cos((h+1)t) = cos(ht)cos(t) - sin(ht)sin(t)
-  const float theta = 2.f * M_PI * ph;
-  const float s1 = std::sin(theta);
-  const float c1 = std::cos(theta);
-
-  float sh = s1, ch = c1;
-  float result = 0.f;
-  for (int h = 1; h <= numHarmonics; h++) {
-    result += harmonicCoef[h - 1] * sh;
-    const float nextS = sh * c1 + ch * s1;
-    const float nextC = ch * c1 - sh * s1;
-    sh = nextS;
-    ch = nextC;
+  ~UnisonDetuneSlider() {
+    delete quantity;
   }
+};
 
-  return result;
-}
+struct KI1H_VCOWidget : ModuleWidget {
+  KI1H_VCOWidget(KI1H_VCO *module);
+  void appendContextMenu(Menu *menu) override;
+};
 
 // ============================================================================
 // MODULE CONSTRUCTOR - PARAMETER & I/O CONFIGURATION
 // ============================================================================
 KI1H_VCO::KI1H_VCO() {
   config(KI1H_VCO::NUM_PARAMS, KI1H_VCO::NUM_INPUTS, KI1H_VCO::NUM_OUTPUTS, KI1H_VCO::NUM_LIGHTS);
+  osc1.bleps = &bleps;
+  osc2.bleps = &bleps;
+  setSampleTime(APP->engine->getSampleTime());
 
   // ============================================================================
   // OSCILLATOR 1 - PARAMETER CONFIGURATION
@@ -489,6 +201,8 @@ KI1H_VCO::KI1H_VCO() {
 }
 
 void KI1H_VCO::process(const ProcessArgs &args) {
+  if (warmStart.step(this, args))
+    return;
   // ============================================================================
   // OSCILLATOR 1 - PITCH & PWM PROCESSING
   // ============================================================================
@@ -500,38 +214,21 @@ void KI1H_VCO::process(const ProcessArgs &args) {
   float pulseWidth1 = params[PULSEWIDTH_PARAM].getValue();
   int waveType1 = (int)params[WAVE_PARAM].getValue();
 
-  // ============================================================================
-  // OSCILLATOR 1 - PROCESS & OUTPUT
-  // ============================================================================
-  osc1.process(pitch1, pulseWidth1 + pwm1, waveType1, args.sampleTime,
-               outputs[SUB_OUTPUT].isConnected());
-  outputs[WAVE_OUTPUT].setVoltage(CV_SCALE * osc1.getOutput());
-  outputs[SUB_OUTPUT].setVoltage(CV_SCALE * osc1.getSub());
-
   // ============================================================================
   // OSCILLATOR 2 - PITCH & SYNC SETUP
   // ============================================================================
   int syncType = (int)params[SYNC_PARAM].getValue();
-  float pitch2 = params[PFINE2_PARAM].getValue() + params[PCOARSE2_PARAM].getValue();
-  pitch2 += inputs[PITCH2_INPUT].getVoltage();
+  float pitch2Base = params[PFINE2_PARAM].getValue() + params[PCOARSE2_PARAM].getValue();
+  pitch2Base += inputs[PITCH2_INPUT].getVoltage();
 
   // ============================================================================
   // OSCILLATOR 2 - FM PROCESSING
   // ============================================================================
   int fmSwitch = (int)params[FM_SWITCH_PARAM].getValue();
+  float fmAmount = params[FM_PARAM].getValue();
   // FM source selection: external input overrides internal hardwire from Osc1
-  float fmVal = 1.f;
-  if (inputs[FM_INPUT].isConnected())
-    fmVal = inputs[FM_INPUT].getVoltage();
-  else
-    fmVal = osc1.getSin() * CV_SCALE;
-
-  // FM mode switching: 0=linear, 1=off, 2=exponential
-  float linFM = 0.f;
-  if (fmSwitch == 0)
-    linFM = fmVal * params[FM_PARAM].getValue();
-  if (fmSwitch == 2)
-    pitch2 += fmVal * params[FM_PARAM].getValue() * 0.2f;
+  const bool fmExternal = inputs[FM_INPUT].isConnected();
+  const float fmIn = fmExternal ? inputs[FM_INPUT].getVoltage() : 0.f;
 
   // ============================================================================
   // OSCILLATOR 2 - AM PROCESSING
@@ -552,25 +249,93 @@ void KI1H_VCO::process(const ProcessArgs &args) {
   float shapeIn = 0;
   if (inputs[SHAPE_INPUT].isConnected())
     shapeIn = inputs[SHAPE_INPUT].getVoltage() / PWM_OFFSET;
+  float shape = shapeKnob.process(params[SHAPE_PARAM].getValue());
+  int waveType2 = (int)params[WAVE2_PARAM].getValue();
 
   // ============================================================================
-  // OSCILLATOR 2 - SYNC PROCESSING
+  // OSCILLATOR 2 - SYNC SOURCE
   // ============================================================================
-  float syncVal = 0.f;
-  if (inputs[SYNC_INPUT].isConnected())
-    syncVal = inputs[SYNC_INPUT].getVoltage();
-  else
-    syncVal = (CV_SCALE * osc1.getOutput());
+  const bool syncExternal = inputs[SYNC_INPUT].isConnected();
+  const float syncIn = syncExternal ? inputs[SYNC_INPUT].getVoltage() : 0.f;
 
   // ============================================================================
-  // OSCILLATOR 2 - PROCESS & OUTPUT
+  // OVERSAMPLED OSCILLATOR LOOP
   // ============================================================================
-  float shape = params[SHAPE_PARAM].getValue();
-  int waveType2 = (int)params[WAVE2_PARAM].getValue();
+  // Jack and knob values are held across the sub-steps. What osc1 feeds osc2 —
+  // the normalled FM and sync — is taken per sub-step, since audio-rate
+  // modulation between the oscillators is what oversampling is for.
+  if (oversample != activeOversample) {
+    decimator.reset();
+    activeOversample = oversample;
+  }
+  const int factor = activeOversample;
+  const float sampleTime = args.sampleTime / factor;
+  // A listening bus receiver on the right takes all three outputs.
+  BusMessage *busOut = busOutput(this);
+  const bool needSub = outputs[SUB_OUTPUT].isConnected() || busOut;
+  const bool needOutput2 = outputs[WAVE2_OUTPUT].isConnected() || busOut;
+
+  const int voices = unisonVoices;
+  // The bank only feeds WAVE OUT (and the bus lane that copies it), so it
+  // rests while nobody listens.
+  const bool unisonOn = voices > 1 && (outputs[WAVE_OUTPUT].isConnected() || busOut);
+  const bool stereo = unisonOn && unisonStereo;
+  if (unisonOn && voices != unison.voices)
+    unison.setVoices(voices, unisonDetune);
+  else if (unisonOn && unisonDetune != unison.spreadCents)
+    unison.setSpread(unisonDetune);
+
+  simd::float_4 out[ki1h::HalfBandCascade<>::MAX_FACTOR];
+  for (int k = 0; k < factor; k++) {
+    osc1.process(pitch1, pulseWidth1 + pwm1, waveType1, sampleTime, needSub);
+
+    float fmVal = fmExternal ? fmIn : osc1.getSin() * CV_SCALE;
+    // FM mode switching: 0=linear, 1=off, 2=exponential
+    float linFM = 0.f;
+    float pitch2 = pitch2Base;
+    if (fmSwitch == 0)
+      linFM = fmVal * fmAmount;
+    if (fmSwitch == 2)
+      pitch2 += fmVal * fmAmount * 0.2f;
+
+    float syncVal = syncExternal ? syncIn : CV_SCALE * osc1.getOutput();
+
+    osc2.process(pitch2, linFM, throughZeroFM, am, syncType, syncVal, shape + shapeIn, waveType2,
+                 sampleTime, needOutput2);
+    // Both oscillators have read their lanes through current(); clear this
+    // sample's slot and move on.
+    bleps.process();
+
+    float main = osc1.getOutput(), right = 0.f;
+    if (unisonOn) {
+      unison.process(pitch1, pulseWidth1 + pwm1, waveType1, sampleTime);
+      main = stereo ? unison.getLeft() : unison.getMono();
+      right = unison.getRight();
+    }
+    out[k] = simd::float_4(main, right, osc1.getSub(), osc2.getOutput());
+  }
 
-  osc2.process(pitch2, linFM, am, syncType, syncVal, shape + shapeIn, waveType2, args.sampleTime,
-               outputs[WAVE2_OUTPUT].isConnected());
-  outputs[WAVE2_OUTPUT].setVoltage(CV_SCALE * osc2.getOutput());
+  // ============================================================================
+  // OUTPUTS
+  // ============================================================================
+  // The decimator runs every lane even for unpatched outputs, whose
+  // oscillators produce zeros, so that a newly patched cable does not get a
+  // burst of stale history.
+  const simd::float_4 decimated = CV_SCALE * decimator.process(out, factor);
+  outputs[WAVE_OUTPUT].setChannels(stereo ? 2 : 1);
+  outputs[WAVE_OUTPUT].setVoltage(decimated[0], 0);
+  if (stereo)
+    outputs[WAVE_OUTPUT].setVoltage(decimated[1], 1);
+  outputs[SUB_OUTPUT].setVoltage(decimated[2]);
+  outputs[WAVE2_OUTPUT].setVoltage(decimated[3]);
+
+  if (busOut) {
+    busOut->lanes[0] = outputs[WAVE_OUTPUT].getVoltage(0);
+    busOut->lanes[1] = outputs[WAVE2_OUTPUT].getVoltage();
+    busOut->lanes[2] = outputs[SUB_OUTPUT].getVoltage();
+    busOut->lanes[3] = 0.f;
+    busOut->fresh = true;
+  }
 
   // ============================================================================
   // STATUS LIGHT PROCESSING
@@ -579,6 +344,65 @@ void KI1H_VCO::process(const ProcessArgs &args) {
   lights[BLINK2_LIGHT].setBrightness(osc2.getBlink() < 0.5f ? 1.f : 0.f);
 }
 
+// ============================================================================
+// STATE PERSISTENCE
+// ============================================================================
+json_t *KI1H_VCO::dataToJson() {
+  json_t *root = json_object();
+  json_object_set_new(root, "throughZeroFM", json_boolean(throughZeroFM));
+  json_object_set_new(root, "oversample", json_integer(oversample));
+  json_object_set_new(root, "unisonVoices", json_integer(unisonVoices));
+  json_object_set_new(root, "unisonDetune", json_real(unisonDetune));
+  json_object_set_new(root, "unisonStereo", json_boolean(unisonStereo));
+  warmStart.toJson(root);
+
+  // Phases and sync history only. The MinBLEP and decimator buffers hold a few
+  // samples of ringing, which is not worth saving.
+  ki1h::StateWriter state(STATE_VERSION);
+  state.put(osc1.phase.phase);
+  state.put(osc1.subPhase.phase);
+  state.put(osc2.phase.phase);
+  state.put(osc2.syncTrigger.state);
+  state.put(osc2.prevSyncVal);
+  state.put(osc2.prevPull);
+  unison.saveState(state);
+  json_object_set_new(root, "state", state.toJson());
+  return root;
+}
+
+void KI1H_VCO::dataFromJson(json_t *root) {
+  // Patches saved before the option existed keep the default, which matches
+  // how LIN FM already let the phase run backward.
+  if (json_t *j = json_object_get(root, "throughZeroFM"))
+    throughZeroFM = json_boolean_value(j);
+  if (json_t *j = json_object_get(root, "oversample")) {
+    // Anything that is not a factor the decimator cascade supports falls back
+    // to no oversampling.
+    const int factor = (int)json_integer_value(j);
+    oversample = (factor == 2 || factor == 4 || factor == 8) ? factor : 1;
+  }
+  if (json_t *j = json_object_get(root, "unisonVoices"))
+    unisonVoices = clamp((int)json_integer_value(j), 1, UnisonOscillator::MAX_VOICES);
+  if (json_t *j = json_object_get(root, "unisonDetune"))
+    unisonDetune = clamp((float)json_number_value(j), 0.f, UNISON_DETUNE_MAX);
+  if (json_t *j = json_object_get(root, "unisonStereo"))
+    unisonStereo = json_boolean_value(j);
+  warmStart.fromJson(root);
+
+  ki1h::StateReader state(json_object_get(root, "state"), STATE_VERSION);
+  state.get(osc1.phase.phase);
+  state.get(osc1.subPhase.phase);
+  state.get(osc2.phase.phase);
+  state.get(osc2.syncTrigger.state);
+  state.get(osc2.prevSyncVal);
+  state.get(osc2.prevPull);
+  unison.loadState(state);
+  warmStart.stateRestored = state.ok();
+  osc1.phase.phase -= std::floor(osc1.phase.phase);
+  osc1.subPhase.phase -= std::floor(osc1.subPhase.phase);
+  osc2.phase.phase -= std::floor(osc2.phase.phase);
+}
+
 KI1H_VCOWidget::KI1H_VCOWidget(KI1H_VCO *module) {
   setModule(module);
   setPanel(createPanel(asset::plugin(pluginInstance, "res/KI1H-VCO.svg")));
@@ -661,4 +485,33 @@ KI1H_VCOWidget::KI1H_VCOWidget(KI1H_VCO *module) {
                                              module, KI1H_VCO::AM_INPUT));
 }
 
+void KI1H_VCOWidget::appendContextMenu(Menu *menu) {
+  KI1H_VCO *module = getModule<KI1H_VCO>();
+  menu->addChild(new MenuSeparator);
+  menu->addChild(createBoolPtrMenuItem("Through-zero linear FM", "", &module->throughZeroFM));
+  // Menu index i selects a factor of 2^i.
+  menu->addChild(createIndexSubmenuItem(
+      "Oversampling", {"Off", "2x", "4x", "8x"},
+      [=]() {
+        size_t index = 0;
+        while ((1 << index) < module->oversample)
+          index++;
+        return index;
+      },
+      [=](size_t index) { module->oversample = 1 << index; }));
+
+  menu->addChild(new MenuSeparator);
+  menu->addChild(createIndexSubmenuItem(
+      "Unison voices", {"Off", "2", "3", "4", "5", "6", "7", "8"},
+      [=]() { return (size_t)(module->unisonVoices - 1); },
+      [=](size_t index) { module->unisonVoices = (int)index + 1; }));
+  UnisonDetuneSlider *detune = new UnisonDetuneSlider(module);
+  detune->box.size.x = 200.f;
+  menu->addChild(detune);
+  menu->addChild(createBoolPtrMenuItem("Unison stereo spread", "", &module->unisonStereo));
+
+  menu->addChild(new MenuSeparator);
+  menu->addChild(module->warmStart.createMenuItem());
+}
+
 Model *modelKI1H_VCO = createModel<KI1H_VCO, KI1H_VCOWidget>("KI1H-VCO");
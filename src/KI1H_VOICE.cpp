@@ -0,0 +1,252 @@
+#include "voice.hpp"
+#include "plugin.hpp"
+#include <algorithm>
+
+// ============================================================================
+// VOICE MODULE DEFINITION
+// ============================================================================
+/** A complete polyphonic voice, VCO -> FILTER -> ENVELOPE -> VCA, in one
+module. Each channel of the pitch and gate inputs plays its own Voice. */
+struct KI1H_VOICE : Module {
+  enum ParamIds {
+    PCOARSE_PARAM,
+    PFINE_PARAM,
+    WAVE_PARAM,
+    PULSEWIDTH_PARAM,
+    INTERVAL_PARAM,
+    WAVE2_PARAM,
+    SHAPE_PARAM,
+    SYNC_PARAM,
+    BLEND_PARAM,
+    CUTOFF_PARAM,
+    RES_PARAM,
+    ENV_CUTOFF_PARAM,
+    ATTACK_PARAM,
+    SUSTAIN_PARAM,
+    RELEASE_PARAM,
+    LEVEL_PARAM,
+    NUM_PARAMS
+  };
+  enum InputIds { PITCH_INPUT, GATE_INPUT, CUTOFF_INPUT, NUM_INPUTS };
+  enum OutputIds { VOICE_OUTPUT, ENV_OUTPUT, NUM_OUTPUTS };
+
+  KI1H_VOICE();
+  void process(const ProcessArgs &args) override;
+
+  void onReset(const ResetEvent &e) override {
+    Module::onReset(e);
+    for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+      voices[c].reset();
+  }
+  void onSampleRateChange(const SampleRateChangeEvent &e) override {
+    setSampleTime(e.sampleTime);
+  }
+
+  // Saves every voice, sounding or not, so a reloaded patch resumes held
+  // notes and ringing releases where they were.
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *root) override;
+  // Layout version of the "state" array; bump it when the fields change.
+  static constexpr int STATE_VERSION = 1;
+
+  /** The ENVELOPE's 3 ms to 10 s stage-time curve. */
+  static const ki1h::StageTimeMap stageTimes;
+  /** Cutoff FM and the envelope amount share the FILTER's 1 kHz per volt, so
+  a full envelope at full amount adds what 10 V of FM would. */
+  static constexpr float HZ_PER_VOLT = 1000.f;
+
+private:
+  Voice voices[PORT_MAX_CHANNELS];
+  void setSampleTime(float sampleTime) {
+    for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+      voices[c].setSampleTime(sampleTime);
+  }
+};
+
+const ki1h::StageTimeMap KI1H_VOICE::stageTimes(0.003f, 10.f);
+
+// ============================================================================
+// VOICE WIDGET DEFINITION
+// ============================================================================
+struct KI1H_VOICEWidget : ModuleWidget {
+  KI1H_VOICEWidget(KI1H_VOICE *module);
+};
+
+// ============================================================================
+// MODULE CONSTRUCTOR - PARAMETER & I/O CONFIGURATION
+// ============================================================================
+KI1H_VOICE::KI1H_VOICE() {
+  config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS);
+  setSampleTime(APP->engine->getSampleTime());
+
+  // ============================================================================
+  // OSCILLATORS
+  // ============================================================================
+  // Ranges and labels as on the VCO.
+  configParam(PFINE_PARAM, -0.5f, 0.5f, 0.f, "Detune", " cents", 0.f, 100.f, 0.f);
+  configParam(PCOARSE_PARAM, -4.6f, 5.2f, 0.f, "Frequency", " Hz", 2.f, dsp::FREQ_C4, 0.f);
+  auto waveParam = configSwitch(WAVE_PARAM, 0.f, 2.f, 1.f, "Osc 1 wave",
+                                {"Triangle", "Sawtooth", "Pulse"});
+  waveParam->snapEnabled = true;
+  configParam(PULSEWIDTH_PARAM, 0.1f, 0.9f, 0.5f, "Osc 1 pulse width", " %", 0.f, 100.f, 0.f);
+  configParam(INTERVAL_PARAM, -1.f, 1.f, 0.f, "Osc 2 interval", " semitones", 0.f, 12.f, 0.f);
+  auto wave2Param = configSwitch(WAVE2_PARAM, 0.f, 1.f, 0.f, "Osc 2 wave", {"Sin-Saw", "Pulse"});
+  wave2Param->snapEnabled = true;
+  configParam(SHAPE_PARAM, 0.1f, 0.9f, 0.5f, "Osc 2 shape", " %", 0.f, 100.f, 0.f);
+  auto syncParam = configSwitch(SYNC_PARAM, 0.f, 2.f, 1.f, "Sync", {"Weak", "OFF", "Strong"});
+  syncParam->snapEnabled = true;
+  configParam(BLEND_PARAM, 0.f, 1.f, 0.f, "Osc 1/2 mix", " %", 0.f, 100.f, 0.f);
+
+  // ============================================================================
+  // FILTER
+  // ============================================================================
+  configParam(CUTOFF_PARAM, LPFilter::minFreq, LPFilter::maxFreq, 1000.f, "LP Freq", " Hz", 0.f,
+              1.f, 0.f);
+  configParam(RES_PARAM, 0.f, 1.666f, 0.f, "LP Resonance", " %", 0.f, 1.f, 0.f);
+  configParam(ENV_CUTOFF_PARAM, 0.f, 1.f, 0.5f, "Envelope to LP Freq", " Hz", 0.f,
+              10.f * HZ_PER_VOLT, 0.f);
+
+  // ============================================================================
+  // ENVELOPE & VCA
+  // ============================================================================
+  configParam(ATTACK_PARAM, 0.f, 1.f, 0.1f, "Attack");
+  configParam(SUSTAIN_PARAM, 0.f, 1.f, 0.7f, "Sustain");
+  configParam(RELEASE_PARAM, 0.f, 1.f, 0.3f, "Release");
+  configParam(LEVEL_PARAM, 0.f, 1.f, 1.f, "Level", "%", 0.f, 100.f, 0.f);
+
+  configInput(PITCH_INPUT, "1V/oct pitch");
+  configInput(GATE_INPUT, "Gate");
+  configInput(CUTOFF_INPUT, "LP FM");
+  configOutput(VOICE_OUTPUT, "Voice");
+  configOutput(ENV_OUTPUT, "Envelope");
+}
+
+void KI1H_VOICE::process(const ProcessArgs &args) {
+  // ============================================================================
+  // SHARED CONTROLS
+  // ============================================================================
+  VoiceControls controls;
+  controls.pitch = params[PCOARSE_PARAM].getValue() + params[PFINE_PARAM].getValue();
+  controls.interval = params[INTERVAL_PARAM].getValue();
+  controls.pulseWidth = params[PULSEWIDTH_PARAM].getValue();
+  controls.wave = (int)params[WAVE_PARAM].getValue();
+  controls.shape = params[SHAPE_PARAM].getValue();
+  controls.wave2 = (int)params[WAVE2_PARAM].getValue();
+  controls.syncType = (int)params[SYNC_PARAM].getValue();
+  controls.blend = params[BLEND_PARAM].getValue();
+  controls.cutoff = params[CUTOFF_PARAM].getValue();
+  controls.resonance = params[RES_PARAM].getValue();
+  controls.envCutoff = params[ENV_CUTOFF_PARAM].getValue() * 10.f * HZ_PER_VOLT;
+  controls.attackStep = stageTimes.increment(params[ATTACK_PARAM].getValue(), args.sampleTime);
+  controls.releaseStep = stageTimes.increment(params[RELEASE_PARAM].getValue(), args.sampleTime);
+  controls.sustain = params[SUSTAIN_PARAM].getValue();
+  controls.level = params[LEVEL_PARAM].getValue();
+
+  // ============================================================================
+  // VOICES
+  // ============================================================================
+  // One voice per pitch or gate channel, whichever has more; a mono pitch or
+  // gate is shared by every voice. Voices above the count are not run.
+  const int channels = std::max(
+      {1, inputs[PITCH_INPUT].getChannels(), inputs[GATE_INPUT].getChannels()});
+  const bool cutoffPatched = inputs[CUTOFF_INPUT].isConnected();
+  outputs[VOICE_OUTPUT].setChannels(channels);
+  outputs[ENV_OUTPUT].setChannels(channels);
+  for (int c = 0; c < channels; c++) {
+    const float cutoffMod =
+        cutoffPatched ? inputs[CUTOFF_INPUT].getPolyVoltage(c) * HZ_PER_VOLT : 0.f;
+    const float out = voices[c].process(controls, inputs[PITCH_INPUT].getPolyVoltage(c),
+                                        inputs[GATE_INPUT].getPolyVoltage(c), cutoffMod,
+                                        args.sampleTime);
+    outputs[VOICE_OUTPUT].setVoltage(out, c);
+    outputs[ENV_OUTPUT].setVoltage(voices[c].env.env * ki1h::CV_SCALE_10V, c);
+  }
+}
+
+// ============================================================================
+// STATE PERSISTENCE
+// ============================================================================
+json_t *KI1H_VOICE::dataToJson() {
+  json_t *root = json_object();
+  ki1h::StateWriter state(STATE_VERSION);
+  for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+    voices[c].saveState(state);
+  json_object_set_new(root, "state", state.toJson());
+  return root;
+}
+
+void KI1H_VOICE::dataFromJson(json_t *root) {
+  ki1h::StateReader state(json_object_get(root, "state"), STATE_VERSION);
+  for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+    voices[c].loadState(state);
+}
+
+KI1H_VOICEWidget::KI1H_VOICEWidget(KI1H_VOICE *module) {
+  setModule(module);
+  setPanel(createPanel(asset::plugin(pluginInstance, "res/KI1H-VOICE.svg")));
+
+  // ============================================================================
+  // PANEL SCREWS
+  // ============================================================================
+  addPanelScrews(this);
+
+  // ============================================================================
+  // OSCILLATORS
+  // ============================================================================
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[0], ROWS[0])), module,
+                                         KI1H_VOICE::PFINE_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[1], ROWS[0])), module,
+                                         KI1H_VOICE::PCOARSE_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[2], ROWS[0])), module,
+                                         KI1H_VOICE::PULSEWIDTH_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[3], ROWS[0])), module,
+                                         KI1H_VOICE::INTERVAL_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[4], ROWS[0])), module,
+                                         KI1H_VOICE::SHAPE_PARAM));
+  addParam(createParamCentered<KI1HSwitch>(mm2px(Vec(COLUMNS[0], ROWS[1])), module,
+                                           KI1H_VOICE::WAVE_PARAM));
+  addParam(createParamCentered<KI1HSwitch>(mm2px(Vec(COLUMNS[1], ROWS[1])), module,
+                                           KI1H_VOICE::SYNC_PARAM));
+  addParam(createParamCentered<BefacoToggle>(mm2px(Vec(COLUMNS[2], ROWS[1])), module,
+                                             KI1H_VOICE::WAVE2_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[3], ROWS[1])), module,
+                                         KI1H_VOICE::BLEND_PARAM));
+
+  // ============================================================================
+  // FILTER
+  // ============================================================================
+  addParam(createParamCentered<KI1HBigKnob>(mm2px(Vec(COLUMNS[0] + HALF_C, ROWS[2] + HALF_R)),
+                                            module, KI1H_VOICE::CUTOFF_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[2], ROWS[2])), module,
+                                         KI1H_VOICE::RES_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[2], ROWS[3])), module,
+                                         KI1H_VOICE::ENV_CUTOFF_PARAM));
+
+  // ============================================================================
+  // ENVELOPE & VCA
+  // ============================================================================
+  addParam(createParamCentered<KI1HSlidePot>(mm2px(Vec(COLUMNS[3], ROWS[3] - HALF_R)), module,
+                                             KI1H_VOICE::ATTACK_PARAM));
+  addParam(createParamCentered<KI1HSlidePot>(mm2px(Vec(COLUMNS[4], ROWS[3] - HALF_R)), module,
+                                             KI1H_VOICE::RELEASE_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[3], ROWS[4])), module,
+                                         KI1H_VOICE::SUSTAIN_PARAM));
+  addParam(createParamCentered<KI1HKnob>(mm2px(Vec(COLUMNS[4], ROWS[4])), module,
+                                         KI1H_VOICE::LEVEL_PARAM));
+
+  // ============================================================================
+  // JACKS
+  // ============================================================================
+  addInput(createInputCentered<BananutBlack>(mm2px(Vec(COLUMNS[0], ROWS[5])), module,
+                                             KI1H_VOICE::PITCH_INPUT));
+  addInput(createInputCentered<BananutBlack>(mm2px(Vec(COLUMNS[1], ROWS[5])), module,
+                                             KI1H_VOICE::GATE_INPUT));
+  addInput(createInputCentered<BananutBlack>(mm2px(Vec(COLUMNS[2], ROWS[5])), module,
+                                             KI1H_VOICE::CUTOFF_INPUT));
+  addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(COLUMNS[3], ROWS[5])), module,
+                                             KI1H_VOICE::ENV_OUTPUT));
+  addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(COLUMNS[4], ROWS[5])), module,
+                                             KI1H_VOICE::VOICE_OUTPUT));
+}
+
+Model *modelKI1H_VOICE = createModel<KI1H_VOICE, KI1H_VOICEWidget>("KI1H-VOICE");
@@ -1,6 +1,11 @@
 #pragma once
 #include "plugin.hpp"
+#include <algorithm>
 #include <cmath>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
 
 /** Shared DSP primitives.
 
@@ -42,23 +47,97 @@ inline float pitchToFreq(float pitch) {
   return dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
 }
 
+// ============================================================================
+// DENORMALS
+// A recursive filter fed silence decays toward zero exponentially, and once
+// its state drops below ~1e-38 it goes subnormal, where x86 arithmetic runs
+// ten to a hundred times slower. Rack's engine threads set flush-to-zero, but
+// not everything runs there: the test and render tools run on a plain main
+// thread.
+// ============================================================================
+/** Turns on flush-to-zero and denormals-are-zero for the current thread for
+its lifetime, and restores the previous mode after. Wrap DSP that runs outside
+Rack's engine in one. */
+struct DenormalGuard {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int saved;
+  // MXCSR bit 15 is FTZ, bit 6 DAZ.
+  DenormalGuard() : saved(_mm_getcsr()) {
+    _mm_setcsr(saved | 0x8040);
+  }
+  ~DenormalGuard() {
+    _mm_setcsr(saved);
+  }
+#elif defined(__aarch64__)
+  uint64_t saved;
+  // FPCR bit 24 is FZ, which covers both inputs and results.
+  DenormalGuard() {
+    __asm__ volatile("mrs %0, fpcr" : "=r"(saved));
+    __asm__ volatile("msr fpcr, %0" : : "r"(saved | (uint64_t(1) << 24)));
+  }
+  ~DenormalGuard() {
+    __asm__ volatile("msr fpcr, %0" : : "r"(saved));
+  }
+#endif
+  DenormalGuard(const DenormalGuard &) = delete;
+  DenormalGuard &operator=(const DenormalGuard &) = delete;
+};
+
+/** Snaps filter state that has decayed to 1e-20 V or below, some 400 dB down,
+to exact zero. Applied to the state a recursive filter feeds back, it keeps
+the filter's cost flat through silence whatever the thread's FP mode: zero fed
+zero stays zero, where a subnormal would be stuck there. */
+inline float flushDenormal(float x) {
+  return std::fabs(x) < 1e-20f ? 0.f : x;
+}
+inline simd::float_4 flushDenormal(simd::float_4 x) {
+  return simd::ifelse(simd::fabs(x) < 1e-20f, 0.f, x);
+}
+
+/** When a filter with a long feedback chain should flush its state. Doing it
+on every sample puts a compare on each stage of the chain, which costs the
+ladder half its speed; once every PERIOD samples costs nothing measurable, and
+a state between 1e-20 and the subnormal range cannot get through more than a
+handful of them before the next flush. */
+struct DenormalFlush {
+  static const int PERIOD = 64;
+  int count = 0;
+
+  bool due() {
+    if (++count < PERIOD)
+      return false;
+    count = 0;
+    return true;
+  }
+};
+
 /** A phase accumulator normalized to [0, 1). */
 struct Phasor {
   float phase = 0.f;
 
-  /** Advances by freq * dt and wraps. Returns whether the phase passed 1.0
-  during the step, which the band-limiting in the VCO needs to place its
-  discontinuity corrections.
+  /** Advances by freq * dt and wraps. See step(). */
+  bool advance(float freq, float dt) {
+    return step(freq * dt);
+  }
+
+  /** Advances by a per-sample increment, which may be negative under
+  through-zero FM, and wraps. Returns whether the phase wrapped during the
+  step — passing 1.0 going forward or 0.0 going backward — which the
+  band-limiting in the VCO needs to place its discontinuity corrections.
 
   The wrap is a floor, not a single subtraction. `if (phase >= 1) phase -= 1`
   only handles phase < 2, so at very high frequencies or very low sample rates
   — where freq * dt exceeds 1 — it leaves the phase above 1 and the oscillator
-  silently breaks. */
-  bool advance(float freq, float dt) {
-    phase += freq * dt;
+  silently breaks. The same floor takes a phase that stepped below 0 back up
+  into range. */
+  bool step(float delta) {
+    phase += delta;
     float wraps = std::floor(phase);
     phase -= wraps;
-    return wraps > 0.f;
+    // A tiny negative phase wraps to 1 - epsilon, which rounds to exactly 1.
+    if (phase >= 1.f)
+      phase = 0.f;
+    return wraps != 0.f;
   }
 
   void reset() {
@@ -66,6 +145,54 @@ struct Phasor {
   }
 };
 
+/** Sub-sample position, in (-1, 0], at which a phase moving by `delta` per
+sample crossed threshold `t` during the sample that ended at `phase`.
+
+`phase` is the post-wrap value in [0, 1) and `wrapped` is what Phasor::step
+returned. `delta` may be negative: a phase running backward under
+through-zero FM crosses thresholds too, and its discontinuities are the
+forward ones with the sign flipped. Returns 1.f when no crossing happened,
+which callers test with `<= 0.f`. The result is exactly what
+MinBlepGenerator::insertDiscontinuity wants, and is clamped to stay inside its
+required open interval. */
+inline float phaseCrossing(float phase, float delta, bool wrapped, float t) {
+  if (delta == 0.f)
+    return 1.f;
+  // Work in un-wrapped coordinates so a crossing that straddles the wrap is
+  // just an ordinary interval test. Either way the swept interval is (lo, hi]
+  // in phase, so arriving at t going forward and leaving it going backward
+  // both count.
+  float lo, hi, end;
+  if (delta > 0.f) {
+    end = phase + (wrapped ? 1.f : 0.f);
+    lo = end - delta;
+    hi = end;
+  } else {
+    end = phase - (wrapped ? 1.f : 0.f);
+    lo = end;
+    hi = end - delta;
+  }
+
+  float hit = -2.f;
+  if (lo < t && t <= hi)
+    hit = t;
+  else if (lo < t + 1.f && t + 1.f <= hi)
+    hit = t + 1.f;
+  else if (lo < t - 1.f && t - 1.f <= hi)
+    hit = t - 1.f;
+  if (hit == -2.f)
+    return 1.f;
+
+  float p = -std::fabs(end - hit) / std::fabs(delta);
+  // insertDiscontinuity requires -1 < p <= 0 and silently ignores anything
+  // else, which would leave the discontinuity uncorrected.
+  if (p <= -1.f)
+    p = -0.999999f;
+  if (p > 0.f)
+    p = 0.f;
+  return p;
+}
+
 // ============================================================================
 // WAVEFORM GENERATORS
 // All take a phase in [0, 1) and return [-1, +1].
@@ -97,6 +224,909 @@ inline float square(float ph, float pw = 0.5f) {
   return (ph > pw) ? -1.f : 1.f;
 }
 
+// ============================================================================
+// BAND-LIMITED RAMP (MinBLAMP)
+// The SDK ships a MinBLEP for steps but nothing for slope discontinuities —
+// triangle corners, and the kink soft sync puts in a waveform when its phase
+// pull switches on or off. These fill that gap.
+// ============================================================================
+
+/** The minimum-phase band-limited unit step underneath both the MinBLEP and
+the MinBLAMP: 2*z*o + 1 values, sampled o times per sample across 2*z samples
+after the edge, rising from 0 and settling at exactly 1.
+
+Built exactly the way the SDK's minBlepImpulse builds its own — Blackman-Harris
+windowed sinc, made minimum phase through the real cepstrum. The SDK's version
+lives in libRack; this one is header-only, so the tests can exercise tables
+built on it.
+
+Runs an O(n^2) DFT with n = 2*z*o. That is a few milliseconds for a 16x16
+table, and the tables below pay it once per process — never on the audio
+thread. */
+inline std::vector<double> minPhaseStep(int z, int o) {
+  const int n = 2 * z * o;
+  const double pi = 3.14159265358979323846;
+  std::vector<double> re(n), im(n), tRe(n), tIm(n), twRe(n), twIm(n);
+  for (int i = 0; i < n; i++) {
+    twRe[i] = std::cos(2.0 * pi * i / n);
+    twIm[i] = -std::sin(2.0 * pi * i / n);
+  }
+  // In-place DFT over (re, im); the inverse conjugates the twiddles and scales.
+  auto dft = [&](bool inverse) {
+    for (int k = 0; k < n; k++) {
+      double sr = 0.0, si = 0.0;
+      for (int t = 0; t < n; t++) {
+        const int w = (int)(((long long)k * t) % n);
+        const double wr = twRe[w], wi = inverse ? -twIm[w] : twIm[w];
+        sr += re[t] * wr - im[t] * wi;
+        si += re[t] * wi + im[t] * wr;
+      }
+      tRe[k] = inverse ? sr / n : sr;
+      tIm[k] = inverse ? si / n : si;
+    }
+    re.swap(tRe);
+    im.swap(tIm);
+  };
+
+  // Windowed sinc with z zero crossings either side.
+  for (int i = 0; i < n; i++) {
+    const double x = -z + 2.0 * z * i / (n - 1);
+    const double sinc = (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+    const double a = 2.0 * pi * i / (n - 1);
+    const double window =
+        0.35875 - 0.48829 * std::cos(a) + 0.14128 * std::cos(2 * a) - 0.01168 * std::cos(3 * a);
+    re[i] = sinc * window;
+    im[i] = 0.0;
+  }
+
+  // Real cepstrum, folded onto positive quefrencies: the minimum-phase
+  // reconstruction of the same magnitude response.
+  dft(false);
+  for (int i = 0; i < n; i++) {
+    re[i] = std::log(std::max(std::hypot(re[i], im[i]), 1e-30));
+    im[i] = 0.0;
+  }
+  dft(true);
+  for (int i = 1; i < n / 2; i++) {
+    re[i] *= 2.0;
+    im[i] *= 2.0;
+  }
+  for (int i = n / 2 + 1; i < n; i++)
+    re[i] = im[i] = 0.0;
+  dft(false);
+  for (int i = 0; i < n; i++) {
+    const double mag = std::exp(re[i]);
+    const double ph = im[i];
+    re[i] = mag * std::cos(ph);
+    im[i] = mag * std::sin(ph);
+  }
+  dft(true);
+
+  // Integrate the impulse into a step, normalized to settle at 1.
+  std::vector<double> step(n + 1);
+  double total = 0.0;
+  for (int i = 0; i < n; i++) {
+    total += re[i];
+    step[i] = total;
+  }
+  for (int i = 0; i < n; i++)
+    step[i] /= total;
+  step[n] = 1.0;
+  return step;
+}
+
+/** Fills `out[0 .. 2*z*o]` (2*z*o + 1 values) with the MinBLAMP residual for a
+unit slope change: the band-limited ramp minus the naive one, sampled o times
+per sample across 2*z samples after the corner.
+
+The residual is the running integral of minPhaseStep's residual. A
+minimum-phase step lags the ideal one by its centroid d, so that integral
+settles at -d instead of 0 and could never be dropped. The lag is cancelled by
+adding d times a raised-cosine step spanning the whole table. That term only
+has energy below a few percent of the sample rate, so it bends the corner
+slightly without reintroducing aliasing. (Cancelling it with d times the
+MinBLEP step instead is a first-order time advance, which boosts the residual
+toward Nyquist by roughly 1 + pi * d and undoes the band-limiting.) The
+residual then decays to exactly 0 at the end of the table, which is what lets a
+generator drop it after 2*z samples. */
+inline void minBlampImpulse(int z, int o, float *out) {
+  const int n = 2 * z * o;
+  const double pi = 3.14159265358979323846;
+  const std::vector<double> step = minPhaseStep(z, o);
+
+  // Integrate the step residual (trapezoid, in samples), then cancel the lag
+  // with a raised-cosine step spanning the whole table.
+  std::vector<double> ramp(n + 1);
+  ramp[0] = 0.0;
+  for (int i = 1; i <= n; i++)
+    ramp[i] = ramp[i - 1] + 0.5 * ((step[i - 1] - 1.0) + (step[i] - 1.0)) / o;
+  const double lag = -ramp[n];
+  for (int i = 0; i <= n; i++) {
+    const double u = (double)i / n;
+    const double smoothStep = u - std::sin(2.0 * pi * u) / (2.0 * pi);
+    out[i] = (float)(ramp[i] + lag * smoothStep);
+  }
+  out[n] = 0.f;
+}
+
+/** The MinBLAMP residual for a given zero-crossing count and oversampling,
+built once and shared by every generator of that size. Constructed on first
+use from a module constructor, which runs on the UI thread. */
+template <int Z, int O>
+struct MinBlampTable {
+  float residual[2 * Z * O + 1];
+
+  MinBlampTable() {
+    minBlampImpulse(Z, O, residual);
+  }
+
+  static const MinBlampTable &get() {
+    static const MinBlampTable table;
+    return table;
+  }
+};
+
+/** Slope-discontinuity counterpart of dsp::MinBlepGenerator, with the same
+interface: p in (-1, 0] is where the corner fell within the sample that just
+ended, and x is the change of slope in output units per sample. Call process()
+exactly once per sample. Templated on T like the SDK's, so a float_4 bank
+works too. */
+template <int Z, int O, typename T = float>
+struct MinBlampGenerator {
+  T buf[2 * Z] = {};
+  int pos = 0;
+  const float *residual;
+
+  MinBlampGenerator() : residual(MinBlampTable<Z, O>::get().residual) {}
+
+  void insertDiscontinuity(float p, T x) {
+    // Same contract as the SDK: anything outside (-1, 0] is ignored.
+    if (!(-1.f < p && p <= 0.f))
+      return;
+    for (int j = 0; j < 2 * Z; j++) {
+      const float index = ((float)j - p) * O;
+      const int i = (int)index;
+      const float lambda = index - i;
+      const float r = residual[i] + lambda * (residual[i + 1] - residual[i]);
+      buf[(pos + j) % (2 * Z)] += x * r;
+    }
+  }
+
+  T process() {
+    T v = buf[pos];
+    buf[pos] = T(0.f);
+    pos = (pos + 1) % (2 * Z);
+    return v;
+  }
+};
+
+// ============================================================================
+// SHARED MinBLEP BANK
+// One accumulator for up to four band-limited outputs, in place of a
+// dsp::MinBlepGenerator per output. The residual buffer is time-major with a
+// float_4 per sample, one lane per output, so reading every output's
+// correction for a sample is one aligned load.
+// ============================================================================
+/** The MinBLEP residual (band-limited step minus the naive one), transposed
+so that the 2*Z taps an insertion needs sit contiguously: rows[k][j] is the
+residual j + k/O samples after the edge. Row O is row 0 shifted by one tap,
+which lets the interpolation between rows k and k + 1 run without a special
+case. */
+template <int Z, int O>
+struct MinBlepTable {
+  simd::float_4 rows[O + 1][2 * Z / 4];
+
+  MinBlepTable() {
+    static_assert(Z % 2 == 0, "2 * Z taps must fill whole float_4s");
+    const std::vector<double> step = minPhaseStep(Z, O);
+    for (int k = 0; k <= O; k++)
+      for (int j = 0; j < 2 * Z; j++)
+        rows[k][j / 4].s[j % 4] = (float)(step[j * O + k] - 1.0);
+  }
+
+  static const MinBlepTable &get() {
+    static const MinBlepTable table;
+    return table;
+  }
+};
+
+/** A MinBLEP accumulator shared by up to four outputs (lanes). Same contract
+as dsp::MinBlepGenerator per lane: insertDiscontinuity with p in (-1, 0], then
+process() exactly once per sample, after every lane's insertions for that
+sample.
+
+The sub-sample interpolation weight is the same for every tap of an insertion,
+so it is computed once and the 2*Z taps are interpolated four at a time. The
+buffer is linear rather than circular: insertions never wrap, and once every
+2*Z samples the pending half is moved down, which costs less than a modulo per
+tap. */
+template <int Z, int O>
+struct MinBlepBank {
+  simd::float_4 buf[4 * Z];
+  int pos = 0;
+  const MinBlepTable<Z, O> *table;
+
+  MinBlepBank() : table(&MinBlepTable<Z, O>::get()) {
+    reset();
+  }
+
+  /** Drops every pending correction. */
+  void reset() {
+    std::fill(buf, buf + 4 * Z, simd::float_4(0.f));
+    pos = 0;
+  }
+
+  void insertDiscontinuity(int lane, float p, float x) {
+    if (!(-1.f < p && p <= 0.f))
+      return;
+    const float index = -p * O;
+    const int k = std::min((int)index, O - 1);
+    const float lambda = index - k;
+    const simd::float_4 *a = table->rows[k];
+    const simd::float_4 *b = table->rows[k + 1];
+    simd::float_4 *out = buf + pos;
+    for (int j = 0; j < 2 * Z / 4; j++) {
+      const simd::float_4 r = x * (a[j] + lambda * (b[j] - a[j]));
+      for (int m = 0; m < 4; m++)
+        out[4 * j + m].s[lane] += r.s[m];
+    }
+  }
+
+  /** This sample's correction for one lane, once its insertions are done.
+  Lets an output that feeds another oscillator be completed before that
+  oscillator inserts into its own lane. */
+  float current(int lane) const {
+    return buf[pos].s[lane];
+  }
+
+  simd::float_4 process() {
+    const simd::float_4 v = buf[pos];
+    buf[pos] = 0.f;
+    if (++pos == 2 * Z) {
+      std::copy(buf + 2 * Z, buf + 4 * Z, buf);
+      std::fill(buf + 2 * Z, buf + 4 * Z, simd::float_4(0.f));
+      pos = 0;
+    }
+    return v;
+  }
+};
+
+// ============================================================================
+// HALF-BAND DECIMATION
+// Brings an oversampled signal back down to the engine rate one octave at a
+// time. Every other tap of a half-band FIR is zero, so the polyphase form
+// costs K multiplies per output sample for a 4K-1 tap filter.
+// ============================================================================
+/** Zeroth-order modified Bessel function of the first kind, for the Kaiser
+window. The series converges fast for the betas used here. */
+inline double besselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < 1e-12 * sum)
+      break;
+  }
+  return sum;
+}
+
+/** Non-zero side taps of a 4K-1 tap half-band lowpass: Kaiser-windowed sinc
+with a cutoff at a quarter of the input rate, beta = 9 for roughly 90 dB of
+stopband. Only the taps an odd distance from the centre are stored — the rest
+are zero apart from the centre, which is exactly 0.5 — and they are scaled so
+that the filter has unity gain at DC. */
+template <int K>
+struct HalfBandTable {
+  float taps[2 * K];
+
+  HalfBandTable() {
+    const double pi = 3.14159265358979323846;
+    const double beta = 9.0;
+    const int half = 2 * K - 1; // centre tap index
+    double sum = 0.0;
+    for (int i = 0; i < 2 * K; i++) {
+      const int d = half - 2 * i; // odd distance from the centre
+      const double r = (double)d / half;
+      const double w = besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+      taps[i] = (float)(std::sin(pi * d / 2.0) / (pi * d) * w);
+      sum += taps[i];
+    }
+    for (int i = 0; i < 2 * K; i++)
+      taps[i] = (float)(taps[i] * 0.5 / sum);
+  }
+
+  static const HalfBandTable &get() {
+    static const HalfBandTable table;
+    return table;
+  }
+};
+
+/** Decimates by two through a 4K-1 tap half-band FIR, in polyphase form: the
+newer sample of each pair goes through the 2K non-zero taps, the older one
+through a plain delay to the 0.5 centre tap. Linear phase, with a latency of
+K - 1/2 output samples.
+
+Templated on T like MinBlampGenerator: a float_4 decimator runs four signals
+through the same taps at once, one per lane. */
+template <int K, typename T = float>
+struct HalfBandDecimator {
+  // Each delay line is stored twice over so the taps can be read as one
+  // contiguous run, with no wrap inside the loop.
+  T even[4 * K] = {};
+  T odd[2 * K] = {};
+  int evenPos = 0;
+  int oddPos = 0;
+  const float *taps;
+
+  HalfBandDecimator() : taps(HalfBandTable<K>::get().taps) {}
+
+  /** in[0] is the older sample of the pair, in[1] the newer. */
+  T process(const T *in) {
+    evenPos = (evenPos == 0) ? 2 * K - 1 : evenPos - 1;
+    even[evenPos] = even[evenPos + 2 * K] = in[1];
+    oddPos = (oddPos == 0) ? K - 1 : oddPos - 1;
+    odd[oddPos] = odd[oddPos + K] = in[0];
+
+    const T *e = even + evenPos;
+    T y = 0.f;
+    // The taps are symmetric, so fold the line and halve the multiplies.
+    for (int i = 0; i < K; i++)
+      y += taps[i] * (e[i] + e[2 * K - 1 - i]);
+    return y + 0.5f * odd[oddPos + K - 1];
+  }
+
+  void reset() {
+    std::fill(even, even + 4 * K, T(0.f));
+    std::fill(odd, odd + 2 * K, T(0.f));
+    evenPos = oddPos = 0;
+  }
+};
+
+/** Decimates by 1, 2, 4 or 8 through a cascade of half-bands. Only the last
+stage has to hold the audio band flat up to its transition, so it gets the
+long filter; the earlier ones just have to stop what would fold onto the audio
+band, which a much wider transition allows.
+
+With T = float_4 the four lanes are independent signals. A module with several
+oversampled outputs decimates them together: the tap loop is the same length,
+and there is no horizontal sum at the end of it. */
+template <typename T = float>
+struct HalfBandCascade {
+  static const int MAX_FACTOR = 8;
+
+  HalfBandDecimator<8, T> stage8x;
+  HalfBandDecimator<8, T> stage4x;
+  HalfBandDecimator<16, T> stage2x;
+
+  /** `in` holds `factor` consecutive oversampled values, oldest first. */
+  T process(const T *in, int factor) {
+    T a[4], b[2];
+    switch (factor) {
+    case 8:
+      for (int i = 0; i < 4; i++)
+        a[i] = stage8x.process(in + 2 * i);
+      for (int i = 0; i < 2; i++)
+        b[i] = stage4x.process(a + 2 * i);
+      return stage2x.process(b);
+    case 4:
+      for (int i = 0; i < 2; i++)
+        b[i] = stage4x.process(in + 2 * i);
+      return stage2x.process(b);
+    case 2:
+      return stage2x.process(in);
+    default:
+      return in[0];
+    }
+  }
+
+  void reset() {
+    stage8x.reset();
+    stage4x.reset();
+    stage2x.reset();
+  }
+};
+
+// ============================================================================
+// STATE PERSISTENCE
+// ============================================================================
+// Rack saves only params, so without these every module reloads cold:
+// oscillators back at phase 0, S&H outputs at 0 V, the clock PLL unlocked and
+// re-measuring. Each module writes its live state into one StateWriter in a
+// fixed order, saves it under a single "state" key, and reads it back in the
+// same order.
+//
+// The first value is the layout version. A module bumps it whenever its order
+// changes, and a reader for any other version reads nothing, so an older patch
+// comes back cold rather than with fields loaded into the wrong places.
+
+/** Collects a module's state as a flat list of numbers. Non-finite values are
+stored as 0, since JSON cannot hold them. */
+struct StateWriter {
+  std::vector<float> values;
+
+  explicit StateWriter(int version) {
+    values.push_back((float)version);
+  }
+
+  void put(float v) {
+    values.push_back(std::isfinite(v) ? v : 0.f);
+  }
+  void put(int v) {
+    values.push_back((float)v);
+  }
+  void put(bool v) {
+    values.push_back(v ? 1.f : 0.f);
+  }
+  void put(simd::float_4 v) {
+    for (int i = 0; i < 4; i++)
+      put(v[i]);
+  }
+  void put(const float *v, int count) {
+    for (int i = 0; i < count; i++)
+      put(v[i]);
+  }
+
+  /** A new JSON array; the caller owns the reference. */
+  json_t *toJson() const {
+    json_t *array = json_array();
+    for (float v : values)
+      json_array_append_new(array, json_real(v));
+    return array;
+  }
+};
+
+/** Reads back what a StateWriter of the same version wrote. Every get()
+leaves its target untouched and returns false once the state is exhausted, or
+from the start if it was missing or from another version. */
+struct StateReader {
+  std::vector<float> values;
+  size_t pos = 1;
+
+  StateReader(const std::vector<float> &saved, int version) {
+    if (!saved.empty() && saved[0] == (float)version)
+      values = saved;
+  }
+
+  /** From the array StateWriter::toJson produced. A null or malformed one
+  reads as missing. */
+  StateReader(json_t *array, int version) {
+    std::vector<float> saved;
+    for (size_t i = 0; i < json_array_size(array); i++) {
+      json_t *v = json_array_get(array, i);
+      if (!json_is_number(v))
+        return;
+      saved.push_back((float)json_number_value(v));
+    }
+    if (!saved.empty() && saved[0] == (float)version)
+      values = saved;
+  }
+
+  /** Whether a state of the right version was found. */
+  bool ok() const {
+    return !values.empty();
+  }
+
+  bool get(float &v) {
+    if (pos >= values.size())
+      return false;
+    v = values[pos++];
+    return true;
+  }
+  bool get(int &v) {
+    float f;
+    if (!get(f))
+      return false;
+    v = (int)f;
+    return true;
+  }
+  bool get(bool &v) {
+    float f;
+    if (!get(f))
+      return false;
+    v = f != 0.f;
+    return true;
+  }
+  bool get(simd::float_4 &v) {
+    if (pos + 4 > values.size())
+      return false;
+    for (int i = 0; i < 4; i++)
+      v.s[i] = values[pos++];
+    return true;
+  }
+  bool get(float *v, int count) {
+    if (pos + count > values.size())
+      return false;
+    for (int i = 0; i < count; i++)
+      v[i] = values[pos++];
+    return true;
+  }
+};
+
+// ============================================================================
+// WARM START
+// ============================================================================
+/** A module's warm-start setting. When a module is added without a saved
+state, it first runs its own process() for a short while before anything
+hears it. Oscillators, lag and noise filters are then already at steady state
+on the first sample that leaves the module. A module that restored its state
+from the patch is already warm, so it skips this: pre-rolling would only pull
+the restored state away from where it was saved.
+
+onAdd only arms the pre-roll; Rack sends it with the engine locked, so the
+work itself is spread over the module's first process() calls, CHUNK frames
+at a time, with the outputs held at 0 V until it is done. A 50 ms pre-roll
+at 48 kHz keeps the outputs silent for 6 ms of playback and costs CHUNK + 1
+frames of DSP per frame while it lasts. Off by default. */
+struct WarmStart {
+  static const int NUM_LENGTHS = 4;
+  /** Pre-roll frames run per process() call while a warm start is pending. */
+  static const int CHUNK = 8;
+
+  int length = 0; // index into lengthMs()
+  bool stateRestored = false;
+  /** Pre-roll frames still to run. */
+  int pending = 0;
+
+  static int lengthMs(int index) {
+    static const int ms[NUM_LENGTHS] = {0, 20, 50, 200};
+    return ms[clamp(index, 0, NUM_LENGTHS - 1)];
+  }
+  static int lengthFrames(int index, float sampleRate) {
+    return (int)(sampleRate * lengthMs(index) / 1000.f);
+  }
+
+  /** Call from onAdd. */
+  void arm(Module *module, float sampleRate) {
+    pending = stateRestored ? 0 : lengthFrames(length, sampleRate);
+    channels.resize(module->outputs.size());
+  }
+
+  /** Call first thing in process(). While a pre-roll is pending, runs the
+  next CHUNK frames of it through `module` and returns true; the caller then
+  returns straight away. */
+  bool step(Module *module, const Module::ProcessArgs &args) {
+    if (pending <= 0 || running)
+      return false;
+    running = true;
+    // Mark every output connected, so that work a module skips for empty
+    // jacks is warmed too, and put them back afterwards.
+    const size_t outputs = std::min(module->outputs.size(), channels.size());
+    for (size_t i = 0; i < outputs; i++) {
+      channels[i] = module->outputs[i].channels;
+      module->outputs[i].channels = std::max<uint8_t>(channels[i], 1);
+    }
+    const int frames = std::min(pending, CHUNK);
+    for (int i = 0; i < frames; i++)
+      module->process(args);
+    pending -= frames;
+    for (size_t i = 0; i < outputs; i++) {
+      for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+        module->outputs[i].setVoltage(0.f, c);
+      module->outputs[i].channels = channels[i];
+    }
+    running = false;
+    return true;
+  }
+
+  void toJson(json_t *root) const {
+    json_object_set_new(root, "warmStart", json_integer(length));
+  }
+  void fromJson(json_t *root) {
+    if (json_t *j = json_object_get(root, "warmStart"))
+      length = clamp((int)json_integer_value(j), 0, NUM_LENGTHS - 1);
+  }
+
+  ui::MenuItem *createMenuItem() {
+    return createIndexPtrSubmenuItem("Warm-start pre-roll", {"Off", "20 ms", "50 ms", "200 ms"},
+                                     &length);
+  }
+
+private:
+  // Set while step() runs the module, whose process() calls step() again.
+  bool running = false;
+  // The outputs' channel counts, saved across a step(). Sized in arm(), so
+  // the audio thread never allocates.
+  std::vector<uint8_t> channels;
+};
+
+// ============================================================================
+// BLOCK PROCESSING
+// ============================================================================
+/** Runs a block kernel behind Rack's one-sample process(). Each frame the
+module writes its inputs to in[][pos] and reads its outputs from out[][pos],
+then calls end(); when that says the block is full, it runs its kernel from
+`in` into `out` in one call. Every output is then exactly one block late, and
+the kernel gets whole blocks to vectorize across time.
+
+Off by default. The latency is for rigs that compensate for it, not for a
+module in a feedback loop or one that has to line up with its neighbours.
+The size is a menu setting; the audio thread picks a change up on its next
+frame and restarts at the top of a block. That first block holds the last
+frame the module sent out, so the outputs do not drop to 0 V and click. */
+template <int INS, int OUTS>
+struct BlockFifo {
+  static const int NUM_SIZES = 4;
+  static const int MAX_SIZE = 64;
+
+  float in[INS][MAX_SIZE] = {};
+  float out[OUTS][MAX_SIZE] = {};
+  int sizeIndex = 0; // index into blockSize(): off
+  int size = 0;      // the block size in use, 0 while off
+  int pos = 0;
+
+  static int blockSize(int index) {
+    static const int sizes[NUM_SIZES] = {0, 16, 32, 64};
+    return sizes[clamp(index, 0, NUM_SIZES - 1)];
+  }
+
+  /** Call at the top of process() with the OUTS voltages the module sent out
+  last frame. Returns the block size in use, 0 while off, in which case the
+  module runs sample by sample as usual. */
+  int begin(const float *held) {
+    const int n = blockSize(sizeIndex);
+    if (n != size) {
+      size = n;
+      pos = 0;
+      for (int k = 0; k < OUTS; k++)
+        std::fill(out[k], out[k] + MAX_SIZE, held[k]);
+    }
+    return size;
+  }
+
+  /** Call once this frame's inputs are written and outputs read. True when
+  the block is full and the kernel is due. */
+  bool end() {
+    if (++pos < size)
+      return false;
+    pos = 0;
+    return true;
+  }
+
+  void toJson(json_t *root) const {
+    json_object_set_new(root, "blockLatency", json_integer(sizeIndex));
+  }
+  void fromJson(json_t *root) {
+    if (json_t *j = json_object_get(root, "blockLatency"))
+      sizeIndex = clamp((int)json_integer_value(j), 0, NUM_SIZES - 1);
+  }
+
+  ui::MenuItem *createMenuItem() {
+    return createIndexPtrSubmenuItem("Block processing latency",
+                                     {"Off", "16 samples", "32 samples", "64 samples"},
+                                     &sizeIndex);
+  }
+};
+
+// ============================================================================
+// CLOCK TRACKING
+// ============================================================================
+/** Second-order digital PLL that follows an external clock.
+
+`phase` runs from 0 to 1 over one input period, so a multiplied or divided clock
+derived from it stays locked to the input without being hard-reset by every
+edge. Each input edge, located to a fraction of a sample, measures how far
+`phase` was from 0 at that instant. Two corrections follow. The proportional
+one bends the rate over the next period, rather than jumping the phase, so a
+derived clock never gains or loses a cycle. The integral one moves the
+frequency estimate. Jitter in the edge times is averaged over roughly
+1 / bandwidth periods instead of landing directly on the output.
+
+The first period is measured directly, so the loop is running from the
+second edge. Any interval outside half to double the current estimate is
+treated as a tempo change and re-acquired the same way rather than slewed
+toward. */
+struct ClockPLL {
+  float phase = 0.f;
+  float freq = 0.f;      // Hz, averaged input rate; 0 until locked
+  float rate = 0.f;      // Hz, freq plus this period's proportional correction
+  float sinceEdge = -1.f; // seconds since the last edge; negative before one
+  float kp = 0.f;
+  float ki = 0.f;
+
+  ClockPLL() {
+    setBandwidth(0.05f);
+  }
+
+  /** Loop bandwidth as a fraction of the input clock rate, with critical
+  damping. Around 0.2 follows tempo changes within a few beats; 0.01 rides
+  out heavy jitter but takes tens of beats to settle. */
+  void setBandwidth(float bandwidth) {
+    const float zeta = 0.7071f;
+    const float theta = bandwidth / (zeta + 0.25f / zeta);
+    const float d = 1.f + 2.f * zeta * theta + theta * theta;
+    kp = 4.f * zeta * theta / d;
+    ki = 4.f * theta * theta / d;
+  }
+
+  bool isLocked() const {
+    return freq > 0.f;
+  }
+
+  /** Advances one sample. `edge` says an input edge happened during it, and
+  `edgeAge` how far before the end of the sample, as a fraction in [0, 1).
+  Returns whether `phase` wrapped this sample. */
+  bool process(bool edge, float edgeAge, float sampleTime) {
+    bool wrapped = false;
+    if (isLocked()) {
+      phase += rate * sampleTime;
+      if (phase >= 1.f) {
+        phase -= std::floor(phase);
+        wrapped = true;
+      }
+    }
+    if (sinceEdge >= 0.f)
+      sinceEdge += sampleTime;
+    if (!edge)
+      return wrapped;
+
+    const float age = edgeAge * sampleTime;
+    const float interval = sinceEdge - age;
+    const bool measured = sinceEdge >= 0.f && interval > 0.f;
+    sinceEdge = age;
+    if (!measured)
+      return wrapped;
+
+    if (!isLocked() || interval * freq < 0.5f || interval * freq > 2.f) {
+      // (Re-)acquire: take the period just measured and align to this edge.
+      freq = rate = 1.f / interval;
+      phase = freq * age;
+      return wrapped;
+    }
+
+    // Where the loop's phase stood at the edge, as a signed error in cycles.
+    float err = phase - freq * age;
+    err -= std::round(err);
+    freq -= ki * err * freq;
+    rate = freq * (1.f - kp * err);
+    return wrapped;
+  }
+
+  void reset() {
+    phase = freq = rate = 0.f;
+    sinceEdge = -1.f;
+  }
+
+  /** The loop state, not the gains: those follow the module's settings. */
+  void saveState(StateWriter &w) const {
+    w.put(phase);
+    w.put(freq);
+    w.put(rate);
+    w.put(sinceEdge);
+  }
+  void loadState(StateReader &r) {
+    r.get(phase);
+    r.get(freq);
+    r.get(rate);
+    r.get(sinceEdge);
+    phase -= std::floor(phase);
+    if (!(freq > 0.f))
+      reset();
+  }
+};
+
+// ============================================================================
+// ENVELOPE TIMING
+// ============================================================================
+/** Maps a 0..1 control to an envelope stage time exponentially: 0 gives
+minTime, 1 gives maxTime, and equal control steps multiply the time by equal
+factors.
+
+The log of the range is taken once, at construction, so each lookup is a
+single exp2_taylor5 (at most 6e-06 relative error) instead of a std::pow. That
+keeps a stage time modulated by CV every sample as cheap as one read off a
+knob. */
+struct StageTimeMap {
+  float minTime;
+  float invMinTime;
+  float octaves; // log2(maxTime / minTime)
+
+  StageTimeMap(float minTime, float maxTime)
+      : minTime(minTime), invMinTime(1.f / minTime), octaves(std::log2(maxTime / minTime)) {}
+
+  /** Stage time in seconds. */
+  float time(float x) const {
+    return minTime * dsp::exp2_taylor5(octaves * x);
+  }
+
+  /** Per-sample increment of a segment that crosses 0 to 1 in time(x): the
+  same sampleTime / time(x), without the division. */
+  float increment(float x, float sampleTime) const {
+    return sampleTime * invMinTime * dsp::exp2_taylor5(-octaves * x);
+  }
+};
+
+// ============================================================================
+// SMOOTHING
+// ============================================================================
+/** One-pole low-pass for de-zippering control signals. A step input reaches
+within 1% of its target in about 0.73 / cutoff seconds. */
+struct OnePole {
+  float y = 0.f;
+  float a = 1.f; // 1 passes the input straight through
+
+  /** Takes an exp, so call it when the sample rate changes, not per sample. */
+  void setCutoff(float freq, float sampleTime) {
+    a = 1.f - std::exp(-2.f * PI * freq * sampleTime);
+  }
+
+  float process(float x) {
+    y = flushDenormal(y + a * (x - y));
+    return y;
+  }
+
+  void reset(float value = 0.f) {
+    y = value;
+  }
+};
+
+/** A knob, slewed in a straight line to wherever it was last turned, for
+parameters a module would otherwise follow in jumps: each jump zippers, and
+while a knob or an automation lane moves, every sample's new value misses a
+downstream cache keyed on the exact float.
+
+The slew covers any distance in the same time, in `batch`-sample steps: the
+value holds still between steps, so a cache behind it recomputes once per
+batch rather than once per sample, and it lands exactly on the target, so the
+cache hits again from then on. A gain needs no batching, so a batch of 1
+gives a plain per-sample ramp. A new target mid-slew restarts the slew from
+the current value, keeping the batch phase. The first value read passes
+straight through, so a module does not slew up from nothing as a patch loads.
+
+The tail after the last knob movement is the full slew time, so it is kept to
+a few milliseconds. */
+struct SmoothedParam {
+  static constexpr float DEFAULT_TIME = 0.01f;
+
+  float value = 0.f;
+  float target = 0.f;
+  float step = 0.f;
+  int stepsLeft = 0; // 0 once settled
+  int countdown = 0; // samples to the next step
+  int steps = 1;     // per slew
+  int batch = 1;
+  bool primed = false;
+
+  /** How long a slew takes and how many samples each step holds. Call where
+  the sample rate changes, not per sample. A slew in progress finishes at the
+  old length. */
+  void configure(float sampleTime, float seconds = DEFAULT_TIME, int batchSize = 1) {
+    batch = std::max(batchSize, 1);
+    steps = std::max((int)std::round(seconds / (sampleTime * batch)), 1);
+  }
+
+  float process(float x) {
+    if (x != target) {
+      if (!primed) {
+        reset(x);
+        return value;
+      }
+      target = x;
+      // From rest the first step comes at once.
+      if (stepsLeft == 0)
+        countdown = 0;
+      stepsLeft = steps;
+      step = (target - value) / steps;
+    }
+    primed = true;
+    if (stepsLeft > 0 && --countdown <= 0) {
+      countdown = batch;
+      value = --stepsLeft == 0 ? target : value + step;
+    }
+    return value;
+  }
+
+  /** Settles at `x` at once. */
+  void reset(float x) {
+    value = target = x;
+    stepsLeft = 0;
+    primed = true;
+  }
+
+  bool settled() const {
+    return stepsLeft == 0;
+  }
+};
+
 /** One mixer/VCA channel: a gain stage into the soft limiter. */
 struct Channel {
   float output = 0.f;
@@ -0,0 +1,159 @@
+#pragma once
+#include "dsp.hpp"
+
+/** The AD and ASD envelope cores. KI1H_ENVELOPE.cpp owns the gates, the stage
+time mapping and the expander CV; everything here is reachable from the tests
+without a Module. */
+
+// ============================================================================
+// CLASS DEFINITION
+// ============================================================================
+struct Envelope {
+
+  enum Stage { STAGE_OFF, STAGE_ATTACK, STAGE_SUSTAIN, STAGE_RELEASE };
+  float env = 0.f;
+  float eoa = 0.f;
+  float eor = 1.f;
+
+  // End-of-attack is a 1 ms trigger pulse, not a latched level: processTransition
+  // fires it at the instant attack completes, and evolveEnvelope derives `eoa`
+  // from it every frame. A pulse cannot stick high through a held sustain the way
+  // a latched level could, which is what pinned the ASD's EOA jack at 10 V.
+  dsp::PulseGenerator eoaPulse;
+
+  Stage stage = STAGE_OFF;
+  float envState = 0.f;
+  // Per-sample increments of envState, i.e. sampleTime / stage time. The module
+  // sets them every sample from KI1H_ENVELOPE::stageTimes.
+  float attackStep = 0.f, releaseStep = 0.f;
+
+  void retrigger() {
+    eoa = 0.f;
+    eor = 1.f;
+    eoaPulse.reset();
+    stage = STAGE_ATTACK;
+    env = envState = 0.f;
+  }
+
+  /** Restores exactly the state a freshly constructed envelope has. */
+  void reset() {
+    env = 0.f;
+    eoa = 0.f;
+    eor = 1.f;
+    eoaPulse.reset();
+    stage = STAGE_OFF;
+    envState = 0.f;
+  }
+
+  /** The live stage and level. sustain (ASD only) is omitted: it is re-derived
+  from its param every sample. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put((int)stage);
+    w.put(env);
+    w.put(envState);
+    w.put(eoa);
+    w.put(eor);
+  }
+  void loadState(ki1h::StateReader &r) {
+    int saved = stage;
+    if (r.get(saved))
+      stage = (Stage)clamp(saved, (int)STAGE_OFF, (int)STAGE_RELEASE);
+    r.get(env);
+    r.get(envState);
+    r.get(eoa);
+    r.get(eor);
+  }
+
+  /** Advances envState for the current stage. Shared by both subclasses; the
+  only stage that behaves differently between them is the transition logic,
+  which is processTransition's job. */
+  void evolveEnvelope(const float &sampleTime) {
+    switch (stage) {
+    case STAGE_ATTACK: {
+      envState += attackStep;
+      env = std::min(envState, 1.f);
+      break;
+    }
+    case STAGE_RELEASE: {
+      envState -= releaseStep;
+      env = std::max(0.f, envState);
+      break;
+    }
+    case STAGE_SUSTAIN: {
+      // Held at its current level; only ASDEnvelope ever reaches this.
+      break;
+    }
+    case STAGE_OFF: {
+      env = 0.0f;
+      break;
+    }
+    }
+    // Advance the end-of-attack trigger and expose its level. eoaPulse.trigger()
+    // is called from processTransition (which runs just before this each frame).
+    eoa = eoaPulse.process(sampleTime) ? 1.f : 0.f;
+  }
+};
+
+/** Attack then straight into release. Never reaches STAGE_SUSTAIN. */
+struct ADEnvelope : Envelope {
+
+  // AD ignores the gate after it starts: attack runs to completion, then release.
+  void processTransition() {
+    if (stage == STAGE_ATTACK) {
+      if (envState >= 1.0f) {
+        eoaPulse.trigger(1e-3f);
+        eor = 0.f;
+        env = envState = 1.0f;
+        stage = STAGE_RELEASE;
+      }
+    } else if (stage == STAGE_RELEASE) {
+      if (envState <= 0.f) {
+        eor = 1.f;
+        stage = STAGE_OFF;
+        env = envState = 0.f;
+      }
+    }
+  }
+
+  void process(const float &sampleTime) {
+    processTransition();
+    evolveEnvelope(sampleTime);
+  }
+};
+
+/** Attack to a sustain level, hold there while gated (when asr is set), then
+release. The sustain stage is the only behavioural difference from AD. */
+struct ASDEnvelope : Envelope {
+
+  float sustain = 1.f;
+
+  void processTransition(const bool asr, const bool held) {
+    if (stage == STAGE_ATTACK) {
+      eor = 0.f;
+      if (envState >= sustain) {
+        eoaPulse.trigger(1e-3f);
+        env = envState = sustain;
+        if (asr) {
+          stage = STAGE_SUSTAIN;
+        } else {
+          stage = STAGE_RELEASE;
+        }
+      }
+    } else if (stage == STAGE_SUSTAIN) {
+      if (!held) {
+        stage = STAGE_RELEASE;
+      }
+    } else if (stage == STAGE_RELEASE) {
+      if (envState <= 0.f) {
+        eor = 1.f;
+        stage = STAGE_OFF;
+        env = envState = 0.f;
+      }
+    }
+  }
+
+  void process(const float &sampleTime, const bool sus, const bool held) {
+    processTransition(sus, held);
+    evolveEnvelope(sampleTime);
+  }
+};
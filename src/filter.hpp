@@ -0,0 +1,556 @@
+#pragma once
+#include "dsp.hpp"
+#include <cmath>
+
+/** The FILTER's LP ladder, BP and HP stages, and the soft-clip output stage.
+KI1H_FILTER.cpp owns the CV routing and the links between filters; everything
+here is reachable from the tests without a Module. */
+
+// Float pi, so the coefficient expressions below stay in single precision
+// instead of promoting through the double overloads of exp/cos/sin.
+static constexpr float PI_F = 3.14159265358979323846f;
+
+// Analog-style headroom + output stage. Internally each filter is allowed to
+// swing up to +/-HEADROOM, the way a modern op-amp fed from a hot rail can —
+// so resonance rings up loud instead of being flattened to unity. The output
+// stage is then a soft clip that is transparent for ordinary signal levels
+// (everything up to CLIP_KNEE passes untouched, no distortion of clean audio)
+// and only rounds the hot peaks off, trending toward CLIP_CEIL without ever
+// exceeding it. HEADROOM sizes the internal ceilings (LP feedback rail, BP
+// resonant-gain cap); CLIP_CEIL is what the jacks approach.
+static constexpr float HEADROOM = 12.f;
+static constexpr float CLIP_KNEE = 7.f;
+static constexpr float CLIP_CEIL = 10.f;
+static inline float softClip(float x) {
+  float a = std::fabs(x);
+  if (a <= CLIP_KNEE)
+    return x; // ordinary levels pass through untouched
+  float range = CLIP_CEIL - CLIP_KNEE;
+  return std::copysign(CLIP_KNEE + range * std::tanh((a - CLIP_KNEE) / range), x);
+}
+
+// ============================================================================
+// LANE SHUFFLES
+// ============================================================================
+// For the LP ladder's scan across its stages. Rack's SDK maps these SSE2
+// intrinsics onto NEON on ARM.
+
+/** The lanes moved up by N, zeros shifted in: {0, v0, v1, v2} for N = 1. */
+template <int N>
+inline simd::float_4 shiftLanes(simd::float_4 v) {
+  return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v.v), 4 * N));
+}
+
+/** Lane 3 in every lane. */
+inline simd::float_4 lane3(simd::float_4 v) {
+  return _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+/** {c3, v0, v1, v2}: v's lanes moved up by one, with c's top lane below. */
+inline simd::float_4 shiftIn(simd::float_4 v, simd::float_4 c) {
+  return _mm_move_ss(_mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(2, 1, 0, 3)),
+                     _mm_shuffle_ps(c.v, c.v, _MM_SHUFFLE(2, 1, 0, 3)));
+}
+
+// ============================================================================
+// LADDER STAGE SATURATION
+// ============================================================================
+/** The curve each stage of the saturating LP ladder drives through: the cubic
+g(u) = u - u^3 / (3 T^2), which flattens out at 2T/3 = HEADROOM when u = T.
+A polynomial, so it and its antiderivative cost a few multiplies in float_4
+and no divide. Past T the cubic would turn back, but only the first stage,
+fed the input less the feedback, is ever driven that hard, so only that input
+is limited to T. Each stage's state moves toward g of its input, at most
+HEADROOM, so the stages after it see at most about HEADROOM.
+
+The ladder adds only the bend, b(u) = -u^3 / (3 T^2), to a stage's input,
+and anti-aliases that with first-order ADAA: the bend's antiderivative
+-u^4 / (12 T^2), differenced across the sample, instead of the bend at the
+sample. That difference over the step factors exactly, so unlike the usual
+ADAA quotient it neither divides nor cancels as the step shrinks. */
+struct StageSaturator {
+  static constexpr float T = 1.5f * HEADROOM;
+
+  /** The ladder's input limited to the cubic's range, where the bend stops.
+  std::min/max compile to minss/maxss; rack::clamp's fmin/fmax are calls. */
+  static float limit(float u) {
+    return std::min(std::max(u, -T), T);
+  }
+
+  /** The bend averaged over the step from `prev` to `u`. */
+  static simd::float_4 adaa(simd::float_4 u, simd::float_4 prev) {
+    return (-1.f / (12.f * T * T)) * (u + prev) * (u * u + prev * prev);
+  }
+};
+
+// ============================================================================
+// CLASS DEFINITION
+// ============================================================================
+struct Filter {
+  float getOutput() const {
+    return output;
+  }
+  float output = 0.f;
+  // Set by setSampleTime() where the rate changes, so process() never checks
+  // it. Rack's default rate until then.
+  float sampleTime = 1.f / 44100.f;
+};
+
+struct LPFilter : Filter {
+  void process(float input, float cutoff, float resonance);
+  /** Call from onSampleRateChange, not per sample. The coefficient is redone
+  on the next process(). */
+  void setSampleTime(float st) {
+    sampleTime = st;
+    cachedCutoff = -1.f;
+  }
+  /** Restores the state a freshly constructed LPFilter has, keeping its sample
+  time. */
+  void reset() {
+    output = 0.f;
+    cutoff_coeff = 0.f;
+    cachedCutoff = -1.f;
+    for (int j = 0; j < 3; j++)
+      stages[j] = 0.f;
+    flush = ki1h::DenormalFlush();
+    primed = false;
+  }
+  /** The signal memory only; coefficients are re-derived from the knobs. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(output);
+    for (int j = 0; j < 3; j++)
+      w.put(stages[j]);
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(output);
+    for (int j = 0; j < 3; j++)
+      r.get(stages[j]);
+    primed = false;
+  }
+  static constexpr float minFreq = 20.f;
+  static constexpr float maxFreq = 22000.f;
+  // The 12 poles, four to a vector: stage 4 * j + k is lane k of stages[j].
+  simd::float_4 stages[3];
+  float cutoff_coeff = 0.f;
+  // Derived from cutoff_coeff c for the scan in process(): 1 - c, c^2, and
+  // c to c^4 by lane.
+  float pole = 1.f;
+  float coeff2 = 0.f;
+  simd::float_4 carryGain = 0.f;
+  ki1h::DenormalFlush flush;
+
+  /** Saturate every stage through StageSaturator, not only the feedback.
+  Off by default, which is the linear ladder. */
+  bool saturate = false;
+  // Each stage's last input for the ADAA, and the bend from it
+  // still to be added. Not saved: a loaded or just-enabled ladder starts from
+  // its first input, which `primed` marks.
+  simd::float_4 drive[3];
+  simd::float_4 bend[3];
+  bool primed = false;
+
+  // Cache keyed on the knob the coefficient derives from. A negative sentinel
+  // so the first process() call always computes.
+  float cachedCutoff = -1.f;
+};
+
+struct BPFilter : Filter {
+  void process(float input, float frequency, float width, float resonance);
+  /** Call from onSampleRateChange, not per sample. The coefficients are
+  redone on the next process(). */
+  void setSampleTime(float st) {
+    sampleTime = st;
+    cachedFreq = -1.f;
+  }
+  static constexpr float minFreq = 30.f;
+  static constexpr float maxFreq = 15000.f;
+  /** The Q-dependent terms: 1 / 2Q, and how far the numerator is scaled down
+  to cap the resonant peak. Width and resonance are knobs, so this runs far
+  less often than a frequency sweep. */
+  void setQ(float q) {
+    inv2q = 0.5f / q;
+
+    // This is an RBJ low-pass whose resonant peak gain rises with Q (~Q for
+    // high Q). Left raw, a Q of ~13 boosts a signal at the corner by >20 dB,
+    // so a +/-5 V input came out at tens of volts. Rather than flatten it to
+    // unity (which made resonance sound dead and quiet), cap the peak gain at
+    // BP_MAX_PEAK: resonance still rings, but only up to the +/-HEADROOM the
+    // output stage is built around. Below the cap the peak passes through at
+    // its natural gain; above it the numerator is scaled down to sit at the
+    // cap. BP_MAX_PEAK is HEADROOM / 5 V, i.e. a nominal +/-5 V input at the
+    // resonant frequency just fills the headroom.
+    static constexpr float BP_MAX_PEAK = HEADROOM / 5.f;
+    peakScale = 1.f;
+    if (q > 0.70710678f) {
+      float peak = q / std::sqrt(1.0f - 1.0f / (4.0f * q * q));
+      if (peak > BP_MAX_PEAK)
+        peakScale = BP_MAX_PEAK / peak;
+    }
+  }
+  /** The 6 dB HP and the biquad for a band centred on `frequency`, `width`
+  times as wide, with the Q terms setQ() left. */
+  void setFrequency(float frequency, float width);
+  /** The biquad from 1 - cos(w) and sin(w) of its cutoff, and the Q terms
+  setQ() left. One division. */
+  void setCoefficients(float oneMinusCos, float sin_w) {
+    const float alpha = sin_w * inv2q;
+    const float inv_a0 = 1.0f / (1.0f + alpha);
+    b0 = 0.5f * oneMinusCos * inv_a0 * peakScale;
+    b1 = 2.f * b0;
+    b2 = b0;
+    a1 = -2.0f * (1.0f - oneMinusCos) * inv_a0;
+    a2 = (1.0f - alpha) * inv_a0;
+  }
+  /** Restores the state a freshly constructed BPFilter has, keeping its sample
+  time. */
+  void reset() {
+    output = 0.f;
+    hp_prev_in = hp_prev_out = 1.f;
+    x1 = x2 = y1 = y2 = 0.f;
+    b0 = b1 = b2 = a1 = a2 = 0.f;
+    hp_alpha = 0.f;
+    inv2q = 0.f;
+    peakScale = 1.f;
+    cachedFreq = -1.f;
+    cachedWidth = -1.f;
+    cachedRes = -1.f;
+    flush = ki1h::DenormalFlush();
+  }
+  /** The signal memory only; coefficients are re-derived from the knobs. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(output);
+    w.put(hp_prev_in);
+    w.put(hp_prev_out);
+    w.put(x1);
+    w.put(x2);
+    w.put(y1);
+    w.put(y2);
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(output);
+    r.get(hp_prev_in);
+    r.get(hp_prev_out);
+    r.get(x1);
+    r.get(x2);
+    r.get(y1);
+    r.get(y2);
+  }
+
+  // 6dB HP state
+  float hp_prev_in = 1.f;
+  float hp_prev_out = 1.f;
+  float hp_alpha = 0.f;
+  float inv2q = 0.f;
+  float peakScale = 1.f;
+
+  // Cache keyed on everything the coefficients derive from.
+  float cachedFreq = -1.f;
+  float cachedWidth = -1.f;
+  float cachedRes = -1.f;
+
+  // 12dB LP biquad states
+  float x1 = 0.f, x2 = 0.f, y1 = 0.f, y2 = 0.f;             // State variables
+  float b0 = 0.f, b1 = 0.f, b2 = 0.f, a1 = 0.f, a2 = 0.f;   // Coefficients
+  ki1h::DenormalFlush flush;
+};
+
+struct HPFilter : Filter {
+  void process(float input, float cutoff);
+  /** Call from onSampleRateChange, not per sample. The coefficient is redone
+  on the next process(). */
+  void setSampleTime(float st) {
+    sampleTime = st;
+    cachedCutoff = -1.f;
+  }
+  /** Restores the state a freshly constructed HPFilter has, keeping its sample
+  time. */
+  void reset() {
+    output = 0.f;
+    prev_input = prev_output = 1.f;
+    alpha = 0.f;
+    cachedCutoff = -1.f;
+  }
+  /** The signal memory only; coefficients are re-derived from the knobs. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(output);
+    w.put(prev_input);
+    w.put(prev_output);
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(output);
+    r.get(prev_input);
+    r.get(prev_output);
+  }
+  static constexpr float minFreq = 30.f;
+  static constexpr float maxFreq = 10000.f;
+  float prev_input = 1.f;
+  float prev_output = 1.f;
+
+  float alpha = 0.f;
+  float cachedCutoff = -1.f;
+};
+
+// ============================================================================
+// PROCESS METHOD
+// ============================================================================
+inline void LPFilter::process(float input, float cutoff, float resonance) {
+  // cutoff comes from a knob plus optional CV, so it is control rate. Only
+  // pay for the exp() when it actually moves.
+  if (cutoff != cachedCutoff) {
+    cachedCutoff = cutoff;
+    const float c = 1.0f - std::exp(-2.0f * PI_F * cutoff * sampleTime);
+    cutoff_coeff = c;
+    pole = 1.f - c;
+    coeff2 = c * c;
+    carryGain = simd::float_4(c, coeff2, coeff2 * c, coeff2 * coeff2);
+  }
+
+  // Single feedback calculation. The feedback is saturated, not linear: at the
+  // top of the resonance range the loop gain exceeds unity and a purely linear
+  // ladder diverges without bound (output ran off to 1e30 V). A real ladder's
+  // transistors clip the feedback, which is what limits self-oscillation to a
+  // finite amplitude. tanh scaled to the +/-HEADROOM rail models that: it keeps
+  // the ladder inside the same headroom the output stage is built around while
+  // still letting the filter ring and self-oscillate.
+  float feedback = HEADROOM * std::tanh(stages[2][3] * resonance / HEADROOM);
+  float signal = input - feedback;
+
+  // Cascade of 12 one-pole lowpasses, y[i] = (1 - c) y[i] + c y[i - 1] with
+  // y[-1] the signal. Stage by stage that is a chain of 12 multiply-adds, and
+  // through the feedback it closes a loop the next sample waits on. Unrolled,
+  // y[i] is (1 - c) y[i] + c (1 - c) y[i - 1] + c^2 (1 - c) y[i - 2] + ... of
+  // the old states, which do not depend on this sample, plus c^(i + 1) times
+  // the signal. So each group of four stages does its part as a prefix scan
+  // across lanes, off the loop, and only the carry into it waits: three
+  // vector multiply-adds from the signal to the output instead of twelve
+  // scalar ones.
+  simd::float_4 carry = signal;
+  for (int j = 0; j < 3; j++) {
+    simd::float_4 z = pole * stages[j];
+    z += cutoff_coeff * shiftLanes<1>(z);
+    z += coeff2 * shiftLanes<2>(z);
+    stages[j] = z + carryGain * carry;
+    carry = lane3(stages[j]);
+  }
+
+  if (saturate) {
+    // Each stage's input is the stage below's new state from the linear scan,
+    // and the bend of it goes on top, a sample late. That keeps the scan
+    // linear, and keeps the bend off the loop: the next sample's scan waits
+    // on one add here, while the clamp and the ADAA of this sample's inputs
+    // run beside it.
+    const simd::float_4 in[3] = {shiftIn(stages[0], StageSaturator::limit(signal)),
+                                 shiftIn(stages[1], stages[0]), shiftIn(stages[2], stages[1])};
+    if (!primed) {
+      for (int j = 0; j < 3; j++) {
+        drive[j] = in[j];
+        bend[j] = 0.f;
+      }
+      primed = true;
+    }
+    for (int j = 0; j < 3; j++) {
+      stages[j] += bend[j];
+      bend[j] = cutoff_coeff * StageSaturator::adaa(in[j], drive[j]);
+      drive[j] = in[j];
+    }
+  } else {
+    primed = false;
+  }
+  if (flush.due())
+    for (int j = 0; j < 3; j++)
+      stages[j] = ki1h::flushDenormal(stages[j]);
+  output = stages[2][3];
+}
+
+inline void HPFilter::process(float input, float cutoff) {
+
+  // High-pass coefficient, recomputed only when cutoff moves.
+  if (cutoff != cachedCutoff) {
+    cachedCutoff = cutoff;
+    alpha = std::exp(-2.0f * PI_F * cutoff * sampleTime);
+  }
+
+  // RC high-pass
+  float hp_out = ki1h::flushDenormal(alpha * (prev_output + input - prev_input));
+
+  prev_input = input;
+  prev_output = hp_out;
+
+  output = hp_out;
+}
+
+inline void BPFilter::setFrequency(float frequency, float width) {
+  float bw = frequency * width;
+  float hpFreq = frequency - bw / 2;
+  float lpFreq = (bw / 2) + frequency;
+
+  hpFreq = std::max(hpFreq, 30.f);
+  lpFreq = std::min(15000.f, lpFreq);
+  hp_alpha = std::exp(-2.0f * PI_F * hpFreq * sampleTime);
+  float w = 2.0f * PI_F * lpFreq * sampleTime;
+  setCoefficients(1.0f - std::cos(w), std::sin(w));
+}
+
+inline void BPFilter::process(float input, float frequency, float width, float resonance) {
+  // frequency, width and resonance are all knob-plus-CV. Recompute only what
+  // moved: Q depends on width and resonance alone, so a frequency change,
+  // which an audio-rate BP MOD makes every sample, leaves the Q terms be.
+  const bool qMoved = width != cachedWidth || resonance != cachedRes;
+  if (qMoved) {
+    cachedWidth = width;
+    cachedRes = resonance;
+    // Q = centre / bandwidth, with bandwidth = frequency * width.
+    setQ((1.f + resonance * 10.f) / width);
+  }
+  if (qMoved || frequency != cachedFreq) {
+    cachedFreq = frequency;
+    setFrequency(frequency, width);
+  }
+
+  float hp_out = ki1h::flushDenormal(hp_alpha * (hp_prev_out + input - hp_prev_in));
+  hp_prev_in = input;
+  hp_prev_out = hp_out;
+
+  output = b0 * hp_out + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+
+  x2 = x1;
+  x1 = hp_out;
+  y2 = y1;
+  y1 = output;
+  // x1 and x2 come from hp_out, which is flushed as it is made.
+  if (flush.due()) {
+    y1 = ki1h::flushDenormal(y1);
+    y2 = ki1h::flushDenormal(y2);
+  }
+}
+
+// ============================================================================
+// FILTER BANK
+// ============================================================================
+/** Up to MAX_BANDS of BPFilter's bands side by side on one input, for
+vocoder-style and formant work. Centres are log-spaced from `low` to `high`,
+so the bands sit an equal musical interval apart, and all share one width and
+resonance.
+
+Each band is exactly a BPFilter, coefficients included: `design` works them
+out one band at a time when a knob moves. The signal path runs four bands to
+a float_4, struct-of-arrays, so 32 bands are eight vector biquads a sample,
+and every band's one-pole HP shares the single input history. */
+struct BPFilterBank {
+  static const int MAX_BANDS = 32;
+  static const int GROUPS = MAX_BANDS / 4;
+
+  /** Call from onSampleRateChange, not per sample; as BPFilter. */
+  void setSampleTime(float st) {
+    design.setSampleTime(st);
+    cachedBands = -1;
+  }
+  /** How many bands run, a multiple of 4 up to MAX_BANDS. */
+  void setBands(int n) {
+    bands = std::min(std::max(n / 4 * 4, 4), MAX_BANDS);
+  }
+  int getBands() const {
+    return bands;
+  }
+  void process(float input, float low, float high, float width, float resonance);
+  /** Band 0 is the one at `low`. */
+  float getOutput(int band) const {
+    return out[band / 4][band % 4];
+  }
+  /** Restores the state a freshly constructed bank has, keeping its sample
+  time and band count. */
+  void reset() {
+    hpPrevIn = 1.f;
+    for (int g = 0; g < GROUPS; g++) {
+      hpPrevOut[g] = 1.f;
+      x1[g] = x2[g] = y1[g] = y2[g] = out[g] = 0.f;
+    }
+    cachedBands = -1;
+    flush = ki1h::DenormalFlush();
+  }
+  /** Every group, active or not, so the layout does not depend on the band
+  count; as BPFilter's. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(hpPrevIn);
+    for (int g = 0; g < GROUPS; g++) {
+      w.put(hpPrevOut[g]);
+      w.put(x1[g]);
+      w.put(x2[g]);
+      w.put(y1[g]);
+      w.put(y2[g]);
+      w.put(out[g]);
+    }
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(hpPrevIn);
+    for (int g = 0; g < GROUPS; g++) {
+      r.get(hpPrevOut[g]);
+      r.get(x1[g]);
+      r.get(x2[g]);
+      r.get(y1[g]);
+      r.get(y2[g]);
+      r.get(out[g]);
+    }
+  }
+
+  int bands = 8;
+  BPFilter design;
+  // Band 4 * g + k is lane k of each array.
+  simd::float_4 hpAlpha[GROUPS], b0[GROUPS], a1[GROUPS], a2[GROUPS];
+  // As BPFilter's, whose HP starts from 1 V in and out.
+  float hpPrevIn = 1.f;
+  simd::float_4 hpPrevOut[GROUPS] = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f};
+  simd::float_4 x1[GROUPS] = {}, x2[GROUPS] = {}, y1[GROUPS] = {}, y2[GROUPS] = {};
+  simd::float_4 out[GROUPS] = {};
+  ki1h::DenormalFlush flush;
+
+  // Cache keyed on everything the coefficients derive from.
+  float cachedLow = -1.f;
+  float cachedHigh = -1.f;
+  float cachedWidth = -1.f;
+  float cachedRes = -1.f;
+  int cachedBands = -1;
+};
+
+inline void BPFilterBank::process(float input, float low, float high, float width,
+                                  float resonance) {
+  const bool qMoved = width != cachedWidth || resonance != cachedRes;
+  if (qMoved) {
+    cachedWidth = width;
+    cachedRes = resonance;
+    design.setQ((1.f + resonance * 10.f) / width);
+  }
+  if (qMoved || low != cachedLow || high != cachedHigh || bands != cachedBands) {
+    cachedLow = low;
+    cachedHigh = high;
+    cachedBands = bands;
+    low = clamp(low, BPFilter::minFreq, BPFilter::maxFreq);
+    high = clamp(high, BPFilter::minFreq, BPFilter::maxFreq);
+    const float ratio = std::pow(high / low, 1.f / (bands - 1));
+    float freq = low;
+    for (int i = 0; i < bands; i++, freq *= ratio) {
+      design.setFrequency(freq, width);
+      hpAlpha[i / 4][i % 4] = design.hp_alpha;
+      b0[i / 4][i % 4] = design.b0;
+      a1[i / 4][i % 4] = design.a1;
+      a2[i / 4][i % 4] = design.a2;
+    }
+  }
+
+  // BPFilter::process() four bands at a time; b1 = 2 b0 and b2 = b0.
+  for (int g = 0; g < bands / 4; g++) {
+    const simd::float_4 hp = ki1h::flushDenormal(hpAlpha[g] * (hpPrevOut[g] + input - hpPrevIn));
+    hpPrevOut[g] = hp;
+    out[g] = b0[g] * hp + (2.f * b0[g]) * x1[g] + b0[g] * x2[g] - a1[g] * y1[g] - a2[g] * y2[g];
+    x2[g] = x1[g];
+    x1[g] = hp;
+    y2[g] = y1[g];
+    y1[g] = out[g];
+  }
+  hpPrevIn = input;
+  if (flush.due())
+    for (int g = 0; g < bands / 4; g++) {
+      y1[g] = ki1h::flushDenormal(y1[g]);
+      y2[g] = ki1h::flushDenormal(y2[g]);
+    }
+}
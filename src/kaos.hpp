@@ -0,0 +1,277 @@
+#pragma once
+#include "dsp.hpp"
+
+/** KAOS's noise streams and the chaos sample & holds. Everything here is
+reachable from the tests without a Module. */
+
+/** One independent noise stream: a white generator plus the filter states that
+colour it.
+
+Each of the module's three outputs owns one. They were collapsed onto a single
+generator, with the brown and pink shapers fed from the same white sample, so
+noise, chaos 1 and chaos 2 all moved together — three views of one signal
+rather than three chaos sources. Patching the noise jack into an S&H then gave
+a voice that tracked the chaos outputs instead of wandering against them. */
+struct NoiseSource {
+  // Seeded from the global generator at construction time, which happens on
+  // the UI thread — never from process(). Two separate draws per stream, so
+  // no two instances share a starting state.
+  NoiseSource() : NoiseSource(rack::random::u64(), rack::random::u64()) {}
+  /** A fixed stream, for reproducible renders in the tests. */
+  NoiseSource(uint64_t seed0, uint64_t seed1) {
+    rng.seed(seed0, seed1);
+  }
+
+  // Per-instance noise stream. rack::random::local() backs the global
+  // random::normal(), and the SDK documents it as no longer thread-local, so
+  // sharing it would still race across engine worker threads.
+  rack::random::Xoroshiro128Plus rng;
+
+  // Brown noise state (integrator for 1/f² spectrum)
+  float brownState = 0.f;
+
+  // Pink noise state variables (Paul Kellet's algorithm)
+  float pinkState[5] = {0.f, 0.f, 0.f, 0.f, 0.f};
+
+  // Box-Muller produces two independent variates per pair of uniforms. Keeping
+  // the second one halves the sqrt/log/sin work, which is what pays for
+  // running three streams where there used to be one.
+  float spare = 0.f;
+  bool haveSpare = false;
+
+  /** Uniform float in [0, 1) drawn from this instance's stream. */
+  float uniform() {
+    return (uint32_t)(rng() >> 32) * 2.32830629e-10f;
+  }
+
+  float white();
+  void white(float *out, int n);
+  float brown(float whiteNoise);
+  float pink(float whiteNoise);
+
+  /** The colouring filters only. The generator is reseeded on every load on
+  purpose; see the constructor. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(brownState);
+    w.put(pinkState, 5);
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(brownState);
+    r.get(pinkState, 5);
+  }
+};
+
+struct KAOS {
+public:
+  KAOS() {}
+  /** Seeds the three streams from one value instead of the global generator,
+  for reproducible renders in the tests. */
+  explicit KAOS(uint64_t seed)
+      : noiseSrc(seed, 1), chaos1Src(seed, 2), chaos2Src(seed, 3) {}
+  void process(float color, float bkIn, bool bkConn, float pkIn, bool pkConn);
+  /** n frames of process() in one call, for a module running behind a
+  ki1h::BlockFifo: colour and trigger inputs per frame in, the three outputs
+  per frame out. The same streams as process(), within float tolerance. */
+  void processBlock(const float *color, const float *bkIn, bool bkConn, const float *pkIn,
+                    bool pkConn, float *noiseOut, float *pKaos, float *bKaos, int n);
+  void saveState(ki1h::StateWriter &w) const;
+  void loadState(ki1h::StateReader &r);
+  float getNoise() const {
+    return noise;
+  }
+  float getpKaos() const {
+    return pKaosOut;
+  }
+  float getbKaos() const {
+    return bKaosOut;
+  }
+  float noise = 1.f;
+  float pKaosOut = 0.f;
+  float bKaosOut = 0.f;
+  dsp::SchmittTrigger pKaosTrigger;
+  dsp::SchmittTrigger bKaosTrigger;
+
+  // One stream per output. Independent seeds are the whole point: the three
+  // jacks are meant to be uncorrelated chaos sources.
+  NoiseSource noiseSrc;
+  NoiseSource chaos1Src;
+  NoiseSource chaos2Src;
+
+private:
+  /** One frame, given this frame's white sample from each stream. */
+  void step(float color, float wNoise, float w1, float w2, float bkIn, bool bkConn, float pkIn,
+            bool pkConn);
+};
+
+inline void KAOS::process(float color, float bkIn, bool bkConn, float pkIn, bool pkConn) {
+  step(color, noiseSrc.white(), chaos1Src.white(), chaos2Src.white(), bkIn, bkConn, pkIn, pkConn);
+}
+
+inline void KAOS::processBlock(const float *color, const float *bkIn, bool bkConn,
+                               const float *pkIn, bool pkConn, float *noiseOut, float *pKaos,
+                               float *bKaos, int n) {
+  // The white samples are what vectorize; the colouring filters and the
+  // triggers are recursions and stay per frame.
+  static const int CHUNK = 64;
+  float w0[CHUNK], w1[CHUNK], w2[CHUNK];
+  for (int start = 0; start < n; start += CHUNK) {
+    const int m = std::min(CHUNK, n - start);
+    noiseSrc.white(w0, m);
+    chaos1Src.white(w1, m);
+    chaos2Src.white(w2, m);
+    for (int i = 0; i < m; i++) {
+      const int f = start + i;
+      step(color[f], w0[i], w1[i], w2[i], bkIn[f], bkConn, pkIn[f], pkConn);
+      noiseOut[f] = noise;
+      pKaos[f] = pKaosOut;
+      bKaos[f] = bKaosOut;
+    }
+  }
+}
+
+inline void KAOS::step(float color, float wNoise, float w1, float w2, float bkIn, bool bkConn,
+                       float pkIn, bool pkConn) {
+  // Proper white, brown, and pink noise for the NOISE jack. These three share
+  // a stream because the crossfade below blends between them: they are one
+  // signal being recoloured, not three sources.
+  float brownNoise = noiseSrc.brown(wNoise);
+  float pinkNoise = noiseSrc.pink(wNoise);
+
+  // Crossfade between noise types: brown (0.0) → pink (0.5) → white (1.0)
+  // Mathematical guarantee: coefficients always sum to 1.0, no phase cancellation
+  float brownLvl, pinkLvl, whiteLvl;
+
+  if (color < 0.f) {
+    // Brown to Pink crossfade
+    brownLvl = std::abs(color); // 1.0 → 0.0
+    pinkLvl = 1.0f + color;     // 0.0 → 1.0
+    whiteLvl = 0.0f;
+  } else {
+    // Pink to White crossfade
+    brownLvl = 0.0f;
+    pinkLvl = 1.0f - color; // 1.0 → 0.0
+    whiteLvl = color;       // 0.0 → 1.0
+  }
+
+  noise = brownLvl * brownNoise + pinkLvl * pinkNoise + whiteLvl * wNoise;
+
+  // Chaos 1 (pink) and chaos 2 (brown) each run their own stream, so the value
+  // held at one jack says nothing about the value held at the other or about
+  // the noise jack. The shapers have to run every sample whether or not a
+  // trigger fires — their filter states are what give pink and brown their
+  // spectra, and sampling a filter that only advances on trigger edges would
+  // just give a random walk of whatever the last white sample was.
+  const float chaos1 = chaos1Src.pink(w1);
+  const float chaos2 = chaos2Src.brown(w2);
+
+  if (pkConn)
+    if (pKaosTrigger.process(pkIn)) {
+      pKaosOut = chaos1;
+      // With no dedicated chaos-2 trigger patched, chaos 2 is held on chaos 1's
+      // edges. It still holds its own stream's value, not chaos 1's.
+      if (!bkConn)
+        bKaosOut = chaos2;
+    }
+
+  if (bkConn)
+    if (bKaosTrigger.process(bkIn))
+      bKaosOut = chaos2;
+}
+// The held chaos values are what a patch audibly depends on; the filter states
+// spare the pink and brown shapers a settling tail after a load.
+inline void KAOS::saveState(ki1h::StateWriter &w) const {
+  w.put(pKaosOut);
+  w.put(bKaosOut);
+  w.put(pKaosTrigger.state);
+  w.put(bKaosTrigger.state);
+  noiseSrc.saveState(w);
+  chaos1Src.saveState(w);
+  chaos2Src.saveState(w);
+}
+
+inline void KAOS::loadState(ki1h::StateReader &r) {
+  r.get(pKaosOut);
+  r.get(bKaosOut);
+  r.get(pKaosTrigger.state);
+  r.get(bKaosTrigger.state);
+  noiseSrc.loadState(r);
+  chaos1Src.loadState(r);
+  chaos2Src.loadState(r);
+}
+
+// ============================================================================
+// NOISE SOURCE - GENERATORS
+// ============================================================================
+
+inline float NoiseSource::white() {
+  // Box-Muller, matching the distribution rack::random::normal() produces. The
+  // sine and cosine legs are two independent variates, so returning one and
+  // banking the other costs a cosine and saves a whole sqrt/log/sin on the
+  // next call.
+  if (haveSpare) {
+    haveSpare = false;
+    return spare;
+  }
+
+  const float radius = std::sqrt(-2.f * std::log(1.f - uniform()));
+  const float theta = 2.f * ki1h::PI * uniform();
+  spare = radius * std::cos(theta) * 1.5f;
+  haveSpare = true;
+  return radius * std::sin(theta) * 1.5f;
+}
+
+/** n samples of the stream white() gives, for a block kernel. Four
+Box-Muller pairs at a time run in float_4, so the log, sqrt, sin and cos are
+paid once per eight samples instead of once per two. The uniforms are drawn in
+the same order as by white(), so the stream does not depend on how it is
+split into blocks. */
+inline void NoiseSource::white(float *out, int n) {
+  int i = 0;
+  if (haveSpare && n > 0) {
+    haveSpare = false;
+    out[i++] = spare;
+  }
+  for (; i + 8 <= n; i += 8) {
+    float u1[4], u2[4];
+    for (int k = 0; k < 4; k++) {
+      u1[k] = 1.f - uniform();
+      u2[k] = uniform();
+    }
+    const simd::float_4 radius = simd::sqrt(-2.f * simd::log(simd::float_4::load(u1)));
+    const simd::float_4 theta = 2.f * ki1h::PI * simd::float_4::load(u2);
+    const simd::float_4 s = radius * simd::sin(theta) * 1.5f;
+    const simd::float_4 c = radius * simd::cos(theta) * 1.5f;
+    for (int k = 0; k < 4; k++) {
+      out[i + 2 * k] = s[k];
+      out[i + 2 * k + 1] = c[k];
+    }
+  }
+  for (; i < n; i++)
+    out[i] = white();
+}
+
+inline float NoiseSource::brown(float whiteNoise) {
+  // Brown noise: integrate White noise with leaky integrator
+  // This creates a -6dB/octave (1/f²) spectrum
+  const float leakage = 0.99f; // Prevents DC buildup
+  brownState = brownState * leakage + whiteNoise * 0.1f;
+
+  // scale limits output to narrower pp range than Pink noise
+  return brownState;
+}
+
+inline float NoiseSource::pink(float whiteNoise) {
+  // Paul Kellet's Pink noise algorithm
+  // Uses multiple first-order filters to approximate 1/f spectrum
+  pinkState[0] = 0.99886f * pinkState[0] + whiteNoise * 0.0555179f;
+  pinkState[1] = 0.99332f * pinkState[1] + whiteNoise * 0.0750759f;
+  pinkState[2] = 0.96900f * pinkState[2] + whiteNoise * 0.1538520f;
+  pinkState[3] = 0.86650f * pinkState[3] + whiteNoise * 0.3104856f;
+  pinkState[4] = 0.55000f * pinkState[4] + whiteNoise * 0.5329522f;
+
+  float pink = pinkState[0] + pinkState[1] + pinkState[2] + pinkState[3] + pinkState[4] +
+               whiteNoise * 0.115926f;
+
+  // Scale output to slightly narrower range than Brown noise
+  return pink * 0.3f;
+}
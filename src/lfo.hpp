@@ -0,0 +1,402 @@
+#pragma once
+#include "dsp.hpp"
+
+/** The LFO and the sample & hold with its clock multiplier/divider. KI1H_LFO.cpp
+owns the params and the menu; everything here is reachable from the tests
+without a Module. */
+
+// Waveform switch positions. Order must match the configSwitch label lists in
+// the constructor: WAVE1_PARAM / WAVE2_PARAM {"Sine", "Sawtooth", "Pulse"} and
+// SWAVE_PARAM {"Sawtooth", "Ramp", "Triangle"}.
+enum LFOWaves { LFO_SINE, LFO_SAW, LFO_SQUARE };
+enum SHWaves { SH_SAW, SH_RAMP, SH_TRIANGLE };
+
+// External-clock multiplier/divider. Whenever CLOCK_INPUT is patched, the Sample
+// Rate knob is repurposed as a mult/div selector: its travel is quantized to a
+// table of ratios with the centre detent at unity. The output runs at
+// mult / div times the input rate.
+//
+// The power-of-two table is the original one, and stays the default so saved
+// patches keep their ratios:
+//   /8  /4  /2  x1  x2  x4  x8
+// The extended table, chosen from the context menu, adds the odd ratios and
+// the musical ones, taking the input clock as a quarter-note beat: dotted
+// quarters (x2/3), dotted eighths (x4/3), quarter triplets (x3/2) and eighth
+// triplets (x3).
+//   /8 /7 /6 /5 /4 /3 /2 x2/3 x1 x4/3 x3/2 x2 x3 x4 x5 x6 x8
+static constexpr float SRATE_MIN = -10.f;
+static constexpr float SRATE_MAX = -3.4f;
+
+struct ClockRatio {
+  int mult;
+  int div;
+  const char *label;
+};
+
+static const ClockRatio POW2_RATIOS[] = {
+    {1, 8, "/8"}, {1, 4, "/4"}, {1, 2, "/2"}, {1, 1, "x1"}, {2, 1, "x2"}, {4, 1, "x4"}, {8, 1, "x8"},
+};
+
+static const ClockRatio EXTENDED_RATIOS[] = {
+    {1, 8, "/8"},
+    {1, 7, "/7"},
+    {1, 6, "/6"},
+    {1, 5, "/5"},
+    {1, 4, "/4"},
+    {1, 3, "/3"},
+    {1, 2, "/2"},
+    {2, 3, "x2/3 (dotted quarter)"},
+    {1, 1, "x1"},
+    {4, 3, "x4/3 (dotted eighth)"},
+    {3, 2, "x3/2 (quarter triplet)"},
+    {2, 1, "x2"},
+    {3, 1, "x3 (eighth triplet)"},
+    {4, 1, "x4"},
+    {5, 1, "x5"},
+    {6, 1, "x6"},
+    {8, 1, "x8"},
+};
+
+// Maps a normalized [0,1] knob position to an entry of the selected table.
+static inline const ClockRatio &clockRatio(float norm, bool extended) {
+  const ClockRatio *table = extended ? EXTENDED_RATIOS : POW2_RATIOS;
+  const int steps = extended ? (int)(sizeof(EXTENDED_RATIOS) / sizeof(EXTENDED_RATIOS[0]))
+                             : (int)(sizeof(POW2_RATIOS) / sizeof(POW2_RATIOS[0]));
+  return table[clamp((int)std::round(norm * (steps - 1)), 0, steps - 1)];
+}
+
+// ============================================================================
+// LFO CLASS DEFINITION
+// ============================================================================
+// Note: SampleAndHold below hides rather than overrides process(), getOutput()
+// and getBlink(). That is fine because both are only ever used through their
+// concrete types; nothing calls them through an LFO*. Marking one of the three
+// virtual bought nothing and implied a polymorphism that does not exist.
+struct LFO {
+  void process(float pitch, int waveType, float sampletime);
+  float getOutput() const {
+    return output;
+  }
+  float getBlink() const {
+    return phase.phase;
+  }
+
+  float output = 0.f;
+  ki1h::Phasor phase;
+};
+
+// ============================================================================
+// SAMPLE AND HOLD CLASS DEFINITION (Inherits from LFO)
+// ============================================================================
+struct SampleAndHold : LFO {
+public:
+  void process(float oscPhase, float clockIn, float sampleRate, const ClockRatio &ratio,
+               float swing, bool bandLimit, float sampleIn, bool sampInConn, int waveType,
+               float lagTime, float sampleTime, bool needOutput);
+  static float waveAt(float ph, int waveType);
+  void saveState(ki1h::StateWriter &w) const;
+  void loadState(ki1h::StateReader &r);
+  float getOutput() const {
+    return laggedOutput;
+  }
+  float getClock() const {
+    return clockOutput;
+  }
+
+  ki1h::Phasor clockPhase;
+  float sampledValue = 0.f;
+  float laggedOutput = 0.f;
+  float clockOutput = 0.f;
+  float prevSampleIn = 0.f; // SAMP_INPUT's last value, to sample between samples
+  // Squares an external clock: turns any input waveform into the gate state that
+  // drives the 0-10 V clock output.
+  dsp::SchmittTrigger extClockGate;
+
+  // External-clock multiplier/divider state (used only while a clock is patched).
+  ki1h::ClockPLL pll;      // tracks the input clock; its phase spans one input period
+  float prevClockIn = 0.f; // last input sample, to place edges between samples
+  int divCycle = 0;        // input periods into the current pair of output pulses
+  float prevPair = 0.f;    // last position within that pair, to place edges
+  // Band-limits CLOCK_OUTPUT's transitions when the option is on.
+  dsp::MinBlepGenerator<16, 16> clockBlep;
+  // Last ratio, so a knob change re-aligns the division. Zero while
+  // free-running, forcing a clean re-lock when a clock is next patched. Kept
+  // by value rather than as a table pointer so it can be saved with the patch.
+  int cachedMult = 0, cachedDiv = 0;
+
+  /** Call from onSampleRateChange, not per sample: the lag coefficient is
+  cached on the knob alone, and this makes the next process() redo it at the
+  sampleTime it is then given. */
+  void sampleRateChanged() {
+    cachedLagTime = -1.f;
+  }
+
+  // Cached lag coefficient. lagTime is a knob, so the exp() behind it almost
+  // never needs redoing. The sentinel is negative so the first process() call
+  // always misses.
+  float lagAlpha = 0.f;
+  float cachedLagTime = -1.f;
+};
+
+inline void LFO::process(float pitch, int waveType, float sampleTime) {
+
+  float freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+
+  // ============================================================================
+  // PHASE ACCUMULATION
+  // ============================================================================
+  // Normal phase accumulation
+  phase.advance(freq, sampleTime);
+
+  // ============================================================================
+  // WAVEFORM GENERATION
+  // ============================================================================
+  // Generate waveform based on type
+  switch (waveType) {
+  case LFO_SINE:
+    output = ki1h::sine(phase.phase);
+    break;
+  case LFO_SAW:
+    output = ki1h::saw(phase.phase);
+    break;
+  case LFO_SQUARE:
+    output = ki1h::square(phase.phase);
+    break;
+  default:
+    output = 0.f;
+  }
+}
+
+// ============================================================================
+// SAMPLE AND HOLD PROCESS METHOD
+// ============================================================================
+// S&H waveforms (different from regular LFO waveforms)
+inline float SampleAndHold::waveAt(float ph, int sWaveType) {
+  switch (sWaveType) {
+  case SH_SAW:
+    return ki1h::saw(ph);
+  case SH_RAMP:
+    return ki1h::ramp(ph);
+  case SH_TRIANGLE:
+    return ki1h::triangle(ph);
+  default:
+    return 0.f;
+  }
+}
+
+inline void SampleAndHold::process(float oscPhase, float clockIn, float sampleRate,
+                                   const ClockRatio &ratio, float swing, bool bandLimit,
+                                   float sampleIn, bool sampInConn, int sWaveType, float lagTime,
+                                   float sampleTime, bool needOutput) {
+
+  float clockFreq = dsp::FREQ_C4 * dsp::exp2_taylor5(sampleRate);
+  // ============================================================================
+  // PHASE ACCUMULATION
+  // ============================================================================
+  // The clock half always runs: it drives CLOCK_OUTPUT and CLOCK_LIGHT.
+  const float clockDelta = clockFreq * sampleTime;
+  const bool clockWrapped = clockPhase.advance(clockFreq, sampleTime);
+
+  // Sub-sample position, in (-1, 0], of the clock edge the S&H samples on this
+  // sample; 1 when there was none. Same convention as ki1h::phaseCrossing.
+  float sampleEdge = 1.f;
+
+  // The clock output is always a clean 0-10 V square. Internally it free-runs off
+  // clockPhase; with a clock patched it squares that input — a bipolar sine, or a
+  // hot/uneven external square — into the same 0-10 V gate via hysteresis
+  // thresholds, so the output level never depends on the input's amplitude.
+  //
+  // Every transition is located to a fraction of a sample as well. The S&H
+  // samples at that instant, and with bandLimit the transition gets a MinBLEP
+  // there, so at audio rates the clock output is not stuck to the sample grid.
+  float naiveClock;
+  if (sampleRate == -1) {
+    // External clock patched: the Sample Rate knob is a mult/div selector.
+    const bool wasHigh = extClockGate.isHigh();
+    const bool rising = extClockGate.process(clockIn, 0.1f, 1.f);
+    const bool falling = wasHigh && !extClockGate.isHigh();
+
+    // Place each edge where the input crossed the trigger's threshold — 1 V
+    // rising, 0.1 V falling — interpolating between this sample and the last.
+    float edgeAge = 0.f;
+    if (rising) {
+      const float rise = clockIn - prevClockIn;
+      edgeAge = (rise > 0.f) ? clamp((clockIn - 1.f) / rise, 0.f, 0.999999f) : 0.f;
+      sampleEdge = -edgeAge;
+    }
+    float fallAge = 0.f;
+    if (falling) {
+      const float fall = prevClockIn - clockIn;
+      fallAge = (fall > 0.f) ? clamp((0.1f - clockIn) / fall, 0.f, 0.999999f) : 0.f;
+    }
+    prevClockIn = clockIn;
+    const bool wrapped = pll.process(rising, edgeAge, sampleTime);
+
+    // Re-align the division whenever the selected ratio changes, so a knob
+    // turn snaps to the new ratio instead of drifting in from the old one.
+    if (ratio.mult != cachedMult || ratio.div != cachedDiv) {
+      cachedMult = ratio.mult;
+      cachedDiv = ratio.div;
+      divCycle = 0;
+      prevPair = 0.f;
+    }
+
+    if (ratio.mult == 1 && ratio.div == 1 && swing <= 0.f) {
+      // x1: an exact, jitter-free clone of the squared input.
+      naiveClock = extClockGate.isHigh() ? 10.f : 0.f;
+      if (bandLimit && rising)
+        clockBlep.insertDiscontinuity(-edgeAge, 10.f);
+      if (bandLimit && falling)
+        clockBlep.insertDiscontinuity(-fallAge, -10.f);
+    } else if (!pll.isLocked()) {
+      // No period measured yet: hold low until the input clock is running.
+      naiveClock = 0.f;
+    } else {
+      // Every ratio is generated the same way, from the PLL phase: mult
+      // output pulses per div tracked input periods. divCycle counts input
+      // periods over a pair of output pulses, 2 * div of them, so `pair` runs
+      // 0 -> 1 across two pulses, and the second can be swung late. The PLL
+      // smooths the period over many edges, so input jitter does not flam the
+      // output.
+      if (wrapped && ++divCycle >= 2 * ratio.div)
+        divCycle = 0;
+      const float pairScale = ratio.mult / (2.f * ratio.div);
+      float pair = (divCycle + pll.phase) * pairScale;
+      pair -= std::floor(pair);
+      // Pulses narrow as the swing grows, so at full swing the late pulse
+      // still ends before the next pair begins.
+      const float width = 0.25f * (1.f - 0.5f * swing);
+      const float second = 0.5f + 0.25f * swing;
+      const bool high = pair < width || (pair >= second && pair < second + width);
+      naiveClock = high ? 10.f : 0.f;
+
+      if (bandLimit) {
+        const float pairDelta = pll.rate * sampleTime * pairScale;
+        const bool pairWrapped = pair < prevPair;
+        const float edges[4] = {0.f, width, second, second + width};
+        for (int e = 0; e < 4; e++) {
+          const float p = ki1h::phaseCrossing(pair, pairDelta, pairWrapped, edges[e]);
+          if (p <= 0.f)
+            clockBlep.insertDiscontinuity(p, (e % 2 == 0) ? 10.f : -10.f);
+        }
+      }
+      prevPair = pair;
+    }
+  } else {
+    cachedMult = cachedDiv = 0; // force a clean re-lock when a clock is next patched
+    pll.reset();
+    naiveClock = ki1h::square(clockPhase.phase) > 0.f ? 10.f : 0.f;
+
+    // Rises at the wrap, falls at mid-cycle.
+    sampleEdge = ki1h::phaseCrossing(clockPhase.phase, clockDelta, clockWrapped, 0.f);
+    if (bandLimit) {
+      if (sampleEdge <= 0.f)
+        clockBlep.insertDiscontinuity(sampleEdge, 10.f);
+      const float pFall = ki1h::phaseCrossing(clockPhase.phase, clockDelta, clockWrapped, 0.5f);
+      if (pFall <= 0.f)
+        clockBlep.insertDiscontinuity(pFall, -10.f);
+    }
+  }
+  // Processed every sample whether or not bandLimit is on, so toggling it lets
+  // any pending correction play out rather than desyncing the buffer.
+  clockOutput = naiveClock + clockBlep.process();
+
+  // Everything below feeds SWAVE_OUTPUT only, so it can be skipped when that jack
+  // is empty — saving the waveform generator and an exp.
+  if (!needOutput)
+    return;
+
+  // The S&H oscillator runs at lfo2's pitch, so it takes lfo2's phase directly
+  // rather than accumulating a bit-identical copy of it (and paying a second
+  // exp2 per sample to do so). The clock phase above is genuinely independent.
+  const float prevOscPhase = phase.phase;
+  phase.phase = oscPhase;
+
+  // ============================================================================
+  // S&H SPECIFIC WAVEFORM GENERATION
+  // ============================================================================
+  output = waveAt(phase.phase, sWaveType);
+
+  // ============================================================================
+  // SAMPLE ON CLOCK RISING EDGE
+  // ============================================================================
+  // The S&H tracks the raw incoming clock unmodified: with an external clock
+  // patched it samples on the input's own edges, independent of the mult/div
+  // ratio applied to CLOCK_OUTPUT. Free-running, it follows the internal clock.
+  //
+  // The value is taken at the edge's own instant rather than at the end of the
+  // sample. At audio-rate sampling, snapping it to the sample grid is a timing
+  // jitter of up to a sample, and that is heard as aliasing.
+  if (sampleEdge <= 0.f) {
+    if (sampInConn) {
+      sampledValue = sampleIn + sampleEdge * (sampleIn - prevSampleIn);
+    } else {
+      // The waveform has corners and a reset, so interpolate its phase, not
+      // its value. lfo2's phase only runs forward.
+      float unwrapped = oscPhase;
+      if (unwrapped < prevOscPhase)
+        unwrapped += 1.f;
+      float edgePhase = unwrapped + sampleEdge * (unwrapped - prevOscPhase);
+      edgePhase -= std::floor(edgePhase);
+      sampledValue = waveAt(edgePhase, sWaveType);
+    }
+  }
+  prevSampleIn = sampleIn;
+
+  // ============================================================================
+  // APPLY EXPONENTIAL LAG TO SAMPLED VALUE
+  // ============================================================================
+  // Recompute only when the knob actually moves; a sample-rate change goes
+  // through sampleRateChanged().
+  if (lagTime != cachedLagTime) {
+    cachedLagTime = lagTime;
+    // Time constant for 99% settling in lagTime
+    float timeConstant = lagTime / 4.605f;
+    lagAlpha = 1.0f - std::exp(-sampleTime / timeConstant);
+  }
+
+  // Apply lag filtering to the sampled value
+  laggedOutput =
+      ki1h::flushDenormal(lagAlpha * sampledValue + (1.0f - lagAlpha) * laggedOutput);
+}
+
+// ============================================================================
+// SAMPLE AND HOLD STATE
+// ============================================================================
+// Everything that lets the S&H and the mult/div clock resume mid-stride: the
+// held and lagged values, the free-run clock phase, and the PLL with its place
+// in the division. The clock MinBLEP's residue is not worth saving.
+inline void SampleAndHold::saveState(ki1h::StateWriter &w) const {
+  w.put(phase.phase);
+  w.put(clockPhase.phase);
+  w.put(sampledValue);
+  w.put(laggedOutput);
+  w.put(clockOutput);
+  w.put(prevSampleIn);
+  w.put(extClockGate.state);
+  pll.saveState(w);
+  w.put(prevClockIn);
+  w.put(divCycle);
+  w.put(prevPair);
+  w.put(cachedMult);
+  w.put(cachedDiv);
+}
+
+inline void SampleAndHold::loadState(ki1h::StateReader &r) {
+  r.get(phase.phase);
+  r.get(clockPhase.phase);
+  r.get(sampledValue);
+  r.get(laggedOutput);
+  r.get(clockOutput);
+  r.get(prevSampleIn);
+  r.get(extClockGate.state);
+  pll.loadState(r);
+  r.get(prevClockIn);
+  r.get(divCycle);
+  r.get(prevPair);
+  r.get(cachedMult);
+  r.get(cachedDiv);
+  phase.phase -= std::floor(phase.phase);
+  clockPhase.phase -= std::floor(clockPhase.phase);
+  divCycle = std::max(divCycle, 0);
+}
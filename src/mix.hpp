@@ -0,0 +1,44 @@
+#pragma once
+#include "dsp.hpp"
+#include <array>
+#include <numeric>
+
+/** MIX's summing stage. Everything here is reachable from the tests without a
+Module. */
+
+// ============================================================================
+// MIX CLASS DEFINITION
+// ============================================================================
+struct Mix {
+  void process(const std::array<float, 5> &all);
+  float getAllOut() const {
+    return allOut;
+  }
+  float getLeftOut() const {
+    return leftOut;
+  }
+  float getRightOut() const {
+    return rightOut;
+  }
+
+  float allOut = 0.f;
+  float leftOut = 0.f;
+  float rightOut = 0.f;
+};
+
+// ============================================================================
+// MIX PROCESS METHOD
+// ============================================================================
+inline void Mix::process(const std::array<float, 5> &all) {
+  std::array<float, 2> evens;
+  std::array<float, 3> odds;
+  for (std::size_t i = 0; i < all.size(); i++) {
+    if (i % 2 == 0)
+      odds[i / 2] = all[i];
+    else
+      evens[i / 2] = all[i];
+  }
+  allOut = ki1h::softLimit(std::accumulate(all.begin(), all.end(), 0.0f));
+  leftOut = ki1h::softLimit(std::accumulate(odds.begin(), odds.end(), 0.0f));
+  rightOut = ki1h::softLimit(std::accumulate(evens.begin(), evens.end(), 0.0f));
+}
@@ -13,6 +13,8 @@ void init(Plugin *p) {
   p->addModel(modelKI1H_ENVELOPE);
   p->addModel(modelKI1H_KAOS);
   p->addModel(modelKI1H_VCA);
+  p->addModel(modelKI1H_ENVCV);
+  p->addModel(modelKI1H_VOICE);
   // Any other plugin initialization may go here.
   // As an alternative, consider lazy-loading assets and lookup tables when your module is created
   // to reduce startup times of Rack.
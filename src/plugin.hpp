@@ -15,6 +15,111 @@ extern Model *modelKI1H_FILTER;
 extern Model *modelKI1H_ENVELOPE;
 extern Model *modelKI1H_KAOS;
 extern Model *modelKI1H_VCA;
+extern Model *modelKI1H_ENVCV;
+extern Model *modelKI1H_VOICE;
+
+/** What a KI1H-ENVCV hands the KI1H-ENVELOPE on its left: the expander's CV
+inputs in volts, 0 where unpatched. Envelopes are indexed as on the ENVELOPE,
+[0]=AD1 [1]=ASD1 [2]=AD2 [3]=ASD2; sustain is [0]=ASD1 [1]=ASD2.
+
+It travels through Rack's double-buffered expander messages, so it arrives one
+sample late, which is inaudible on an envelope time. */
+struct EnvelopeCVMessage {
+  float attack[4] = {};
+  float release[4] = {};
+  float sustain[2] = {};
+};
+
+// ============================================================================
+// MODULE BUS
+// ============================================================================
+/** Cable-free routing with one sample of latency. What a KI1H module hands
+the bus-capable KI1H module directly on its right, which takes it on inputs
+that have no cable in them. Lanes by sender:
+
+  VCO     [0] osc 1 WAVE (left channel in unison stereo), [1] osc 2 WAVE, [2] SUB
+  FILTER  [0] LP, [1] BP1, [2] BP2, [3] HP
+  MIX     [0] Odds, [1] Evens, [2] All
+
+and by receiver: the FILTER takes [0] on BP1 IN and [1] on HP IN, so its own
+BP1 -> LP and HP -> BP2 normals carry on from there; the VCA takes [0]-[3] on
+IN1-IN4.
+
+It travels through Rack's double-buffered expander messages. Rack swaps them
+between engine frames, so like a cable the bus arrives one sample late; no
+message scheme between two modules can do better, since the engine may run them
+on different threads in either order. What it saves is the patching: side by
+side modules chain without cables. */
+struct BusMessage {
+  static const int LANES = 4;
+  float lanes[LANES] = {};
+  // Set by the sender when it fills the lanes, cleared by the receiver once
+  // read, so a receiver that has just been switched on never reads lanes left
+  // from long ago.
+  bool fresh = false;
+  // Set by the receiver: whether it wants the lanes this frame. A sender skips
+  // the outputs it would otherwise not compute when nobody is listening.
+  bool listening = false;
+};
+
+inline bool isBusSender(Model *model) {
+  return model == modelKI1H_VCO || model == modelKI1H_FILTER || model == modelKI1H_MIX;
+}
+
+inline bool isBusReceiver(Model *model) {
+  return model == modelKI1H_FILTER || model == modelKI1H_VCA;
+}
+
+/** The receiving end of the bus, owned by the module on the right. Off by
+default, so that placing modules side by side never changes a saved patch. */
+struct BusInput {
+  BusMessage messages[2];
+  bool enabled = false;
+
+  /** Hands the two buffers to Rack. Call from the module's constructor. */
+  void attach(Module *module) {
+    module->leftExpander.producerMessage = &messages[0];
+    module->leftExpander.consumerMessage = &messages[1];
+  }
+
+  /** The lanes a bus sender on the left filled last frame, or null when the
+  option is off, nothing sends, or nothing was sent. Call once per process(). */
+  const BusMessage *receive(Module *module) {
+    Module *left = module->leftExpander.module;
+    if (!left || !isBusSender(left->model))
+      return nullptr;
+    // The buffer read now is the one the sender writes next frame, so that is
+    // where the receiver says whether it is listening.
+    BusMessage *msg = (BusMessage *)module->leftExpander.consumerMessage;
+    const bool fresh = msg->fresh;
+    msg->fresh = false;
+    msg->listening = enabled;
+    module->leftExpander.requestMessageFlip();
+    return enabled && fresh ? msg : nullptr;
+  }
+
+  void toJson(json_t *root) const {
+    json_object_set_new(root, "busInput", json_boolean(enabled));
+  }
+  void fromJson(json_t *root) {
+    if (json_t *j = json_object_get(root, "busInput"))
+      enabled = json_boolean_value(j);
+  }
+
+  ui::MenuItem *createMenuItem() {
+    return createBoolPtrMenuItem("Bus input from the module on the left", "", &enabled);
+  }
+};
+
+/** The sending end: the buffer to fill this frame, or null when the module on
+the right is not a bus receiver that is listening. */
+inline BusMessage *busOutput(Module *module) {
+  Module *right = module->rightExpander.module;
+  if (!right || !isBusReceiver(right->model))
+    return nullptr;
+  BusMessage *msg = (BusMessage *)right->leftExpander.producerMessage;
+  return msg->listening ? msg : nullptr;
+}
 
 // UI Layout Constants - 6 rows with 18.8 spacing
 constexpr float ROW_SPACING = 18.8f;
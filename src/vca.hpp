@@ -0,0 +1,53 @@
+#pragma once
+#include "dsp.hpp"
+#include <algorithm>
+#include <array>
+
+/** The VCA's panning stage. Everything here is reachable from the tests without
+a Module. */
+
+// ============================================================================
+// VCA CLASS DEFINITION
+// ============================================================================
+struct VCA {
+  void process(const std::array<float, 5> &channels, const std::array<float, 5> &pans);
+  float getLeftOut() const {
+    return leftOut;
+  }
+  float getRightOut() const {
+    return rightOut;
+  }
+
+  float leftOut = 0.f;
+  float rightOut = 0.f;
+};
+
+// ============================================================================
+// VCA PROCESS METHOD
+// ============================================================================
+inline void VCA::process(const std::array<float, 5> &channels,
+                         const std::array<float, 5> &pans) {
+  float leftSum = 0.f;
+  float rightSum = 0.f;
+
+  // Distribute each channel to left/right based on panning
+  // Pan: -1 = full left, 0 = center, +1 = full right
+  for (int i = 0; i < 5; i++) {
+    float pan = pans[i];
+    // Clamp pan to [-1, 1] range
+    pan = std::max(-1.f, std::min(1.f, pan));
+
+    // Calculate left and right gains (linear panning)
+    // When pan = -1: left = 1, right = 0
+    // When pan = 0: left = 0.5, right = 0.5
+    // When pan = +1: left = 0, right = 1
+    float leftGain = (1.f - pan) * 0.5f;
+    float rightGain = (1.f + pan) * 0.5f;
+
+    leftSum += channels[i] * leftGain;
+    rightSum += channels[i] * rightGain;
+  }
+
+  leftOut = ki1h::softLimit(leftSum);
+  rightOut = ki1h::softLimit(rightSum);
+}
@@ -0,0 +1,654 @@
+#pragma once
+#include "dsp.hpp"
+
+/** The VCO's oscillators: the naive waveforms, their MinBLEP/MinBLAMP band-limiting,
+hard and soft sync, and the unison bank. KI1H_VCO.cpp owns the params, the
+oversampling and the shared BLEP bank; everything here is reachable from the
+tests without a Module. */
+
+// Waveform switch positions. Order must match the configSwitch label lists in
+// the constructor: WAVE_PARAM {"Triangle", "Sawtooth", "Pulse"} and
+// WAVE2_PARAM {"Sin-Saw", "Pulse"}.
+enum Waves { WAVE_TRI, WAVE_SAW, WAVE_SQ };
+enum ShaperWaves { SHAPER_SINSAW, SHAPER_PULSE };
+
+// Lanes of the MinBLEP bank both oscillators share. 16 zero-crossings at 16x
+// oversampling is what Rack's own VCO uses.
+typedef ki1h::MinBlepBank<16, 16> BlepBank;
+enum BlepLanes { BLEP_OSC1, BLEP_SUB, BLEP_OSC2 };
+
+// ============================================================================
+// OSCILLATOR BASE CLASS
+// ============================================================================
+struct Oscillator {
+  float getOutput() const {
+    return output;
+  }
+  float getBlink() const {
+    return blinkPhase;
+  }
+  float getSin() const {
+    return sin;
+  }
+
+  ki1h::Phasor phase;
+  float output = 0.f;
+  // Owned by the module. Each oscillator inserts into its own lanes and reads
+  // them back with current(); the module advances the bank once per sample.
+  BlepBank *bleps = nullptr;
+  // Not an alias for phase.phase: updatePhases sets this before the subclasses
+  // apply hard/soft sync, so it holds the pre-sync phase. The blink LEDs read it.
+  float blinkPhase = 0.f;
+  float sin = 0.f;
+
+  // Set by updatePhases, consumed by the band-limiting in the subclasses.
+  float deltaPhase = 0.f;
+  bool wrapped = false;
+
+  /** phaseCrossing() for this oscillator's current step. */
+  float crossing(float t) const {
+    return ki1h::phaseCrossing(phase.phase, deltaPhase, wrapped, t);
+  }
+  /** +1 while the phase runs forward, -1 while through-zero FM runs it
+  backward. Crossing a threshold backward is the forward discontinuity in
+  reverse, so every BLEP and BLAMP magnitude is scaled by this. */
+  float direction() const {
+    return deltaPhase < 0.f ? -1.f : 1.f;
+  }
+
+  /** Advances the phase by a per-sample increment, which may be negative. */
+  void updatePhases(float delta);
+  float calculateFreq(float pitch);
+  /** The pulse-width clamp ki1h::square applies, exposed so the crossing
+  detection uses the same threshold the waveform does. */
+  static float clampPulseWidth(float pw) {
+    return clamp(pw, 0.1f, 0.9f);
+  }
+};
+
+// ============================================================================
+// RAW PURE WAVEFORM OSCILLATOR
+// ============================================================================
+struct RawOscillator : Oscillator {
+  void process(float pitch, float pulseWidth, int waveType, float sampleTime, bool needSub);
+  float getSub() const {
+    return sub;
+  }
+
+  ki1h::Phasor subPhase;
+  float sub = 0.f;
+
+  // The triangle's corners are slope, not value, discontinuities.
+  ki1h::MinBlampGenerator<16, 16> mainBlamp;
+};
+
+// ============================================================================
+// UNISON OSCILLATOR BANK
+// ============================================================================
+/** Up to MAX_VOICES detuned copies of osc1's waveform, four voices to a
+float_4. Each voice has its own phase, a fixed detune spread symmetrically
+around osc1's pitch, and a slow random pitch drift, so the copies beat against
+each other rather than phase-locking. Voices are panned across the stereo
+field in the same order as their detune. */
+struct UnisonOscillator {
+  static const int MAX_VOICES = 8;
+  static const int GROUPS = MAX_VOICES / 4;
+
+  UnisonOscillator() : UnisonOscillator(rack::random::u64(), rack::random::u64()) {}
+  /** Seeds the drift and phase scatter, for reproducible renders in the
+  tests. */
+  UnisonOscillator(uint64_t seed0, uint64_t seed1);
+  /** Lays out the detune and pan of `voices` voices spread over +/-
+  `spreadCents`. Only voices added by a larger count get a scattered phase:
+  the others carry on where they are, so a detune sweep does not click.
+  Cheap and allocation-free, so it can be called from process() when the
+  menu settings change. */
+  void setVoices(int voices, float spreadCents);
+  /** Re-lays the detune and pan for a new spread, leaving the phases alone. */
+  void setSpread(float spreadCents);
+  void saveState(ki1h::StateWriter &w) const;
+  void loadState(ki1h::StateReader &r);
+  void process(float pitch, float pulseWidth, int waveType, float sampleTime);
+
+  float getLeft() const {
+    return left;
+  }
+  float getRight() const {
+    return right;
+  }
+  float getMono() const {
+    return mono;
+  }
+
+  int voices = 0;
+  float spreadCents = -1.f;
+
+  simd::float_4 phase[GROUPS];
+  simd::float_4 detune[GROUPS]; // octaves
+  simd::float_4 drift[GROUPS];  // octaves
+  // Equal-power pan per voice, already scaled by 1/sqrt(voices) so the sum
+  // stays near the level of a single voice. Zero for unused lanes.
+  simd::float_4 gainL[GROUPS];
+  simd::float_4 gainR[GROUPS];
+  simd::float_4 gainMono[GROUPS];
+
+  // Drift is a slow random walk, stepped at a fixed interval rather than per
+  // sample.
+  static constexpr float DRIFT_INTERVAL = 0.005f; // seconds
+  static constexpr float DRIFT_DEPTH = 3.f / 1200.f; // octaves, ~3 cents
+  float driftTimer = 0.f;
+  rack::random::Xoroshiro128Plus rng;
+
+  // One generator per group: insertDiscontinuity takes one sub-sample
+  // position for all four lanes, so each lane's edge is inserted with the
+  // other lanes masked to zero, and the buffer arithmetic is vectorized across
+  // the voices.
+  dsp::MinBlepGenerator<16, 16, simd::float_4> blep[GROUPS];
+  ki1h::MinBlampGenerator<16, 16, simd::float_4> blamp[GROUPS];
+
+  float left = 0.f;
+  float right = 0.f;
+  float mono = 0.f;
+
+private:
+  float uniform() {
+    return (rng() >> 40) / 16777216.f; // top 24 bits, [0, 1)
+  }
+  /** Inserts, for each lane of `crossed`, a correction of size `x` at that
+  lane's sub-sample position `p`. */
+  template <typename G>
+  static void insertLanes(G &gen, simd::float_4 crossed, simd::float_4 p, simd::float_4 x) {
+    const int bits = simd::movemask(crossed);
+    for (int i = 0; i < 4; i++)
+      if (bits & (1 << i))
+        gen.insertDiscontinuity(p[i], simd::movemaskInverse<simd::float_4>(1 << i) & x);
+  }
+};
+
+// ============================================================================
+// WAVESHAPING OSCILLATOR
+// ============================================================================
+struct ShaperOscillator : Oscillator {
+  void process(float pitch, float linFM, bool throughZero, float am, int syncType,
+               float syncVal, float shape, int waveType, float sampleTime, bool needOutput);
+
+  float generateShapedWave(float ph, float shape);
+  /** The naive waveform at an arbitrary phase. Used to measure the size of the
+  jump a hard-sync reset introduces. */
+  float waveAt(float ph, float shape, int waveType);
+  /** d(waveAt)/d(phase), away from the pulse edges. Used to size the kink soft
+  sync puts in the output when its phase pull switches on or off. */
+  float slopeAt(float ph, float shape, int waveType);
+
+  ki1h::MinBlampGenerator<16, 16> blamp;
+
+  // Per-instance: the engine runs modules across worker threads, so a shared
+  // trigger would both steal edges between VCOs and race on its own state.
+  dsp::SchmittTrigger syncTrigger;
+  float prevSyncVal = 0.f;
+  // Soft sync's phase pull from the previous sample, as a fraction of the
+  // per-sample increment. Zero while the pull is disengaged.
+  float prevPull = 0.f;
+
+  // The harmonic amplitudes depend only on `shape`, which is a knob plus CV —
+  // control rate, not audio rate. Cache them so the per-sample loop is
+  // multiply-add only.
+  static const int MAX_HARMONICS = 9;
+  float harmonicCoef[MAX_HARMONICS] = {};
+  int numHarmonics = 0;
+  float cachedShape = -1e9f;
+  void updateHarmonics(float shape);
+};
+
+// ============================================================================
+// OSCILLATOR CLASS - SHARED FUNCTION
+// ============================================================================
+inline float Oscillator::calculateFreq(float pitch) {
+  // Calculate frequency from pitch (1V/octave). exp2_taylor5 is accurate to
+  // well under a cent over the audio range and about an order of magnitude
+  // cheaper than a generic std::pow with a runtime exponent.
+  return dsp::FREQ_C4 * dsp::exp2_taylor5(pitch);
+}
+
+inline void Oscillator::updatePhases(float delta) {
+  deltaPhase = delta;
+  wrapped = phase.step(delta);
+
+  blinkPhase = phase.phase;
+}
+
+// ============================================================================
+// RAWOSCILLATOR CLASS
+// ============================================================================
+inline void RawOscillator::process(float pitch, float pulseWidth, int waveType,
+                                   float sampleTime, bool needSub) {
+  float freq = calculateFreq(pitch);
+
+  updatePhases(freq * sampleTime);
+
+  sin = ki1h::sine(phase.phase);
+
+  // ==========================================================================
+  // SUB OSCILLATOR (50% square, one octave down)
+  // ==========================================================================
+  // The sub oscillator feeds SUB_OUTPUT and nothing else, so it can be skipped
+  // outright when that jack is empty. osc1's main output and sine cannot: they
+  // normal into osc2's sync and FM.
+  if (needSub) {
+    const float subFreq = freq / 2.f;
+    const float subDelta = subFreq * sampleTime;
+    const bool subWrapped = subPhase.advance(subFreq, sampleTime);
+
+    // Steps from -1 to +1 at phase 0 and back at phase 0.5.
+    float sp = ki1h::phaseCrossing(subPhase.phase, subDelta, subWrapped, 0.f);
+    if (sp <= 0.f)
+      bleps->insertDiscontinuity(BLEP_SUB, sp, 2.f);
+    sp = ki1h::phaseCrossing(subPhase.phase, subDelta, subWrapped, 0.5f);
+    if (sp <= 0.f)
+      bleps->insertDiscontinuity(BLEP_SUB, sp, -2.f);
+
+    sub = ki1h::square(subPhase.phase) + bleps->current(BLEP_SUB);
+  } else {
+    sub = 0.f;
+  }
+
+  // ==========================================================================
+  // MAIN WAVEFORM
+  // ==========================================================================
+  // Each hard edge gets a MinBLEP of the same magnitude as the jump, placed at
+  // the sub-sample instant it actually happened. The bank and mainBlamp
+  // advance exactly once per sample whatever the waveform, so switching
+  // waveform lets any residual correction decay out rather than desyncing the
+  // buffer.
+  switch (waveType) {
+  case WAVE_TRI: {
+    // Triangle is continuous, but its slope flips between -4 and +4 per cycle
+    // at each corner: a slope change of 8 * deltaPhase per sample, up at the
+    // wrap and down at the peak.
+    const float pLow = crossing(0.f);
+    if (pLow <= 0.f)
+      mainBlamp.insertDiscontinuity(pLow, 8.f * deltaPhase);
+    const float pHigh = crossing(0.5f);
+    if (pHigh <= 0.f)
+      mainBlamp.insertDiscontinuity(pHigh, -8.f * deltaPhase);
+    output = ki1h::triangle(phase.phase);
+    break;
+  }
+  case WAVE_SAW: {
+    // Falling saw: steps from -1 up to +1 at the wrap.
+    const float p = crossing(0.f);
+    if (p <= 0.f)
+      bleps->insertDiscontinuity(BLEP_OSC1, p, 2.f);
+    output = ki1h::saw(phase.phase);
+    break;
+  }
+  case WAVE_SQ: {
+    const float pw = clampPulseWidth(pulseWidth);
+    const float pRise = crossing(0.f);
+    if (pRise <= 0.f)
+      bleps->insertDiscontinuity(BLEP_OSC1, pRise, 2.f);
+    const float pFall = crossing(pw);
+    if (pFall <= 0.f)
+      bleps->insertDiscontinuity(BLEP_OSC1, pFall, -2.f);
+    output = ki1h::square(phase.phase, pw);
+    break;
+  }
+  default:
+    output = 0.f;
+  }
+
+  output += bleps->current(BLEP_OSC1) + mainBlamp.process();
+}
+
+// ============================================================================
+// UNISONOSCILLATOR CLASS
+// ============================================================================
+inline UnisonOscillator::UnisonOscillator(uint64_t seed0, uint64_t seed1) {
+  rng.seed(seed0, seed1);
+  for (int g = 0; g < GROUPS; g++) {
+    phase[g] = 0.f;
+    detune[g] = 0.f;
+    drift[g] = 0.f;
+    gainL[g] = gainR[g] = gainMono[g] = 0.f;
+  }
+}
+
+inline void UnisonOscillator::setVoices(int newVoices, float newSpread) {
+  const int previous = voices;
+  voices = clamp(newVoices, 1, MAX_VOICES);
+  for (int v = previous; v < voices; v++)
+    phase[v / 4].s[v % 4] = uniform();
+  setSpread(newSpread);
+}
+
+inline void UnisonOscillator::setSpread(float newSpread) {
+  spreadCents = newSpread;
+  const float norm = 1.f / std::sqrt((float)voices);
+  for (int v = 0; v < MAX_VOICES; v++) {
+    const int g = v / 4, i = v % 4;
+    if (v >= voices) {
+      detune[g].s[i] = 0.f;
+      gainL[g].s[i] = gainR[g].s[i] = gainMono[g].s[i] = 0.f;
+      continue;
+    }
+    // -1 for the lowest voice, +1 for the highest.
+    const float pos = (voices == 1) ? 0.f : 2.f * v / (voices - 1) - 1.f;
+    detune[g].s[i] = pos * spreadCents / 1200.f;
+    const float angle = (pos + 1.f) * ki1h::PI / 4.f;
+    gainL[g].s[i] = std::cos(angle) * norm;
+    gainR[g].s[i] = std::sin(angle) * norm;
+    gainMono[g].s[i] = norm;
+  }
+}
+
+// The voice layout is saved alongside the phases so that loading can lay it
+// out first. Otherwise the first process() would see a layout change and
+// scatter the restored phases again.
+inline void UnisonOscillator::saveState(ki1h::StateWriter &w) const {
+  w.put(voices);
+  w.put(spreadCents);
+  w.put(driftTimer);
+  for (int g = 0; g < GROUPS; g++) {
+    w.put(phase[g]);
+    w.put(drift[g]);
+  }
+}
+
+inline void UnisonOscillator::loadState(ki1h::StateReader &r) {
+  int savedVoices = 0;
+  float savedSpread = 0.f;
+  if (!r.get(savedVoices) || !r.get(savedSpread))
+    return;
+  if (savedVoices >= 1)
+    setVoices(savedVoices, savedSpread);
+  r.get(driftTimer);
+  for (int g = 0; g < GROUPS; g++) {
+    r.get(phase[g]);
+    r.get(drift[g]);
+    phase[g] -= simd::floor(phase[g]);
+  }
+}
+
+inline void UnisonOscillator::process(float pitch, float pulseWidth, int waveType,
+                                      float sampleTime) {
+  using simd::float_4;
+  const int groups = (voices + 3) / 4;
+
+  driftTimer += sampleTime;
+  if (driftTimer >= DRIFT_INTERVAL) {
+    driftTimer -= DRIFT_INTERVAL;
+    // A leaky random walk: each step nudges every voice by up to +/- 10% of
+    // the depth and pulls it 1% of the way back toward its nominal pitch.
+    for (int g = 0; g < groups; g++) {
+      const float_4 kick(uniform(), uniform(), uniform(), uniform());
+      drift[g] = drift[g] * 0.99f + (kick * 2.f - 1.f) * (0.1f * DRIFT_DEPTH);
+    }
+  }
+
+  const float pw = Oscillator::clampPulseWidth(pulseWidth);
+  float_4 sumL = 0.f, sumR = 0.f, sumMono = 0.f;
+  for (int g = 0; g < groups; g++) {
+    const float_4 freq = dsp::FREQ_C4 * dsp::exp2_taylor5(pitch + detune[g] + drift[g]);
+    const float_4 delta = freq * sampleTime;
+    // Un-wrapped end of this step, and whether it passed 1.0.
+    const float_4 end = phase[g] + delta;
+    const float_4 wrapped = end >= 1.f;
+    phase[g] = end - simd::floor(end);
+
+    // Sub-sample position of the wrap, and of the mid-cycle edge or corner at
+    // `t`, mirroring ki1h::phaseCrossing lane by lane.
+    const float_4 pWrap = simd::clamp(-(end - 1.f) / delta, -0.999999f, 0.f);
+    const float t = (waveType == WAVE_SQ) ? pw : 0.5f;
+    const float_4 hit = simd::ifelse(end - delta < t, float_4(t), float_4(t + 1.f));
+    const float_4 crossedMid = (end - delta < hit) & (hit <= end);
+    const float_4 pMid = simd::clamp(-(end - hit) / delta, -0.999999f, 0.f);
+
+    float_4 out;
+    switch (waveType) {
+    case WAVE_TRI:
+      insertLanes(blamp[g], wrapped, pWrap, 8.f * delta);
+      insertLanes(blamp[g], crossedMid, pMid, -8.f * delta);
+      out = simd::ifelse(phase[g] < 0.5f, phase[g] * 4.f - 1.f, 3.f - phase[g] * 4.f);
+      break;
+    case WAVE_SAW:
+      insertLanes(blep[g], wrapped, pWrap, 2.f);
+      out = 1.f - phase[g] * 2.f;
+      break;
+    case WAVE_SQ:
+      insertLanes(blep[g], wrapped, pWrap, 2.f);
+      insertLanes(blep[g], crossedMid, pMid, -2.f);
+      out = simd::ifelse(phase[g] > pw, -1.f, 1.f);
+      break;
+    default:
+      out = 0.f;
+    }
+    out += blep[g].process() + blamp[g].process();
+
+    sumL += out * gainL[g];
+    sumR += out * gainR[g];
+    sumMono += out * gainMono[g];
+  }
+
+  left = sumL[0] + sumL[1] + sumL[2] + sumL[3];
+  right = sumR[0] + sumR[1] + sumR[2] + sumR[3];
+  mono = sumMono[0] + sumMono[1] + sumMono[2] + sumMono[3];
+}
+
+// ============================================================================
+// SHAPEROSCILLATOR CLASS
+// ============================================================================
+inline void ShaperOscillator::process(float pitch, float linFM, bool throughZero, float AM,
+                                      int syncType, float syncVal, float shape, int waveType,
+                                      float sampleTime, bool needOutput) {
+  // Linear FM scales the per-sample phase increment directly. Deep
+  // modulation takes it negative, and the phase then runs backward: Phasor
+  // wraps either way, and the crossing and BLEP logic below flips the sign of
+  // each discontinuity to match, so the reversed waveform stays
+  // band-limited.
+  float delta = calculateFreq(pitch) * sampleTime * (1.f + linFM * 0.1f);
+  if (!throughZero && delta < 0.f)
+    delta = 0.f;
+
+  updatePhases(delta);
+  const float dir = direction();
+  // ============================================================================
+  // SYNC PROCESSING
+  // ============================================================================
+  // Hard sync - digital reset when sync signal crosses threshold
+  bool synced = false;
+  if (syncType == 2) {
+    if (syncTrigger.process(syncVal)) {
+      // Locate the crossing of the trigger's 1.0 threshold within this sample
+      // by interpolating the sync input, then correct the step the reset puts
+      // in the output. Without this the reset is a raw discontinuity.
+      const float before = waveAt(phase.phase, shape, waveType);
+      phase.reset();
+      const float after = waveAt(phase.phase, shape, waveType);
+
+      const float rise = syncVal - prevSyncVal;
+      const float frac = (rise > 0.f) ? (syncVal - 1.f) / rise : 0.f;
+      float p = -clamp(frac, 0.f, 0.999999f);
+      bleps->insertDiscontinuity(BLEP_OSC2, p, after - before);
+      synced = true;
+    }
+  }
+
+  // Soft sync - analog-modeled continuous phase pulling
+  // The sync signal creates a "force" that pulls the phase toward reset
+  float syncPull = 0.f;
+  if (syncType == 0) {
+    if (syncVal > 0.1f) { // Only pull when sync signal is above noise floor
+      // Create exponential pull force - stronger as phase increases
+      float pullStrength = syncVal * 0.2f;     // Scale sync signal
+      // Quadratic pull (gets stronger near end of cycle)
+      syncPull = pullStrength * phase.phase * phase.phase;
+
+      // Pull phase backward toward 0, creating the chaotic analog behavior.
+      // The pull brakes the phase in whichever direction it runs, so under
+      // through-zero FM it can push the phase up past 1 as well.
+      phase.phase -= syncPull * deltaPhase;
+
+      // Prevent phase from going negative
+      if (phase.phase < 0.f)
+        phase.reset();
+      else if (phase.phase >= 1.f)
+        phase.phase -= std::floor(phase.phase);
+    }
+  }
+
+  // The pull slows the phase by syncPull * deltaPhase per sample. While it
+  // varies smoothly the waveform just bends, but engaging or releasing it at
+  // the 0.1 threshold changes the phase rate abruptly, and that puts a corner
+  // in the output. Place it where the sync input crossed the threshold and
+  // correct it with a MinBLAMP sized by the waveform's slope there.
+  const bool pulling = syncPull > 0.f;
+  if (pulling != (prevPull > 0.f) && !synced) {
+    const float rise = syncVal - prevSyncVal;
+    const float frac = (rise != 0.f) ? (syncVal - 0.1f) / rise : 0.f;
+    const float p = -clamp(frac, 0.f, 0.999999f);
+    // deltaPhase carries the direction, so this needs no extra sign flip.
+    const float rateChange = (prevPull - syncPull) * deltaPhase;
+    blamp.insertDiscontinuity(p, slopeAt(phase.phase, shape, waveType) * rateChange);
+  }
+  prevPull = syncPull;
+  prevSyncVal = syncVal;
+
+  sin = ki1h::sine(phase.phase);
+
+  // generateShapedWave is the most expensive routine in the plugin. Skip it
+  // when WAVE2_OUTPUT is empty. The phase accumulation and sync above still
+  // run, so BLINK2_LIGHT keeps blinking whether or not anything is patched.
+  // blamp still has to be processed: soft sync inserts a corner above, and
+  // leaving it in the buffer would fire as a burst on reconnection. The shared
+  // BLEP bank is advanced by the module either way.
+  if (!needOutput) {
+    blamp.process();
+    output = 0.f;
+    return;
+  }
+
+  // Band-limiting. When a sync reset already happened this sample its BLEP
+  // covers the jump, so the natural wrap must not be corrected as well.
+  switch (waveType) {
+  case SHAPER_SINSAW:
+    // The Fourier series in generateShapedWave is a sum of sines and is
+    // already band-limited. Its `harmonicReduction < 0.01` shortcut is not —
+    // that path returns a raw rising saw, which steps from +1 down to -1.
+    if (!synced && std::abs(1.f - shape) < 0.01f) {
+      const float p = crossing(0.f);
+      if (p <= 0.f)
+        bleps->insertDiscontinuity(BLEP_OSC2, p, -2.f * dir);
+    }
+    output = generateShapedWave(phase.phase, shape);
+    break;
+  case SHAPER_PULSE: {
+    if (!synced) {
+      const float pw = clampPulseWidth(shape);
+      const float pRise = crossing(0.f);
+      if (pRise <= 0.f)
+        bleps->insertDiscontinuity(BLEP_OSC2, pRise, 2.f * dir);
+      const float pFall = crossing(pw);
+      if (pFall <= 0.f)
+        bleps->insertDiscontinuity(BLEP_OSC2, pFall, -2.f * dir);
+    }
+    output = ki1h::square(phase.phase, shape);
+    break;
+  }
+  default:
+    output = 0.f;
+  }
+
+  output += bleps->current(BLEP_OSC2) + blamp.process();
+  output *= AM;
+}
+
+inline float ShaperOscillator::waveAt(float ph, float shape, int waveType) {
+  switch (waveType) {
+  case 0:
+    return generateShapedWave(ph, shape);
+  case 1:
+    return ki1h::square(ph, shape);
+  default:
+    return 0.f;
+  }
+}
+
+inline float ShaperOscillator::slopeAt(float ph, float shape, int waveType) {
+  if (waveType != SHAPER_SINSAW)
+    return 0.f; // the pulse is flat between its edges
+  if (std::abs(1.f - shape) < 0.01f)
+    return 2.f; // generateShapedWave's raw rising saw
+
+  if (shape != cachedShape)
+    updateHarmonics(shape);
+
+  // d/dph of sum(c_h * sin(h * theta)) is 2pi * sum(h * c_h * cos(h * theta)),
+  // built with the same angle-addition recurrence as generateShapedWave.
+  const float theta = 2.f * ki1h::PI * ph;
+  const float s1 = std::sin(theta);
+  const float c1 = std::cos(theta);
+
+  float sh = s1, ch = c1;
+  float result = 0.f;
+  for (int h = 1; h <= numHarmonics; h++) {
+    result += h * harmonicCoef[h - 1] * ch;
+    const float nextS = sh * c1 + ch * s1;
+    const float nextC = ch * c1 - sh * s1;
+    sh = nextS;
+    ch = nextC;
+  }
+
+  return 2.f * ki1h::PI * result;
+}
+
+/** Recomputes the per-harmonic amplitudes for a given shape.
+
+Each is (1/h) * (1 - harmonicReduction)^(h-1). Building the power by repeated
+multiplication instead of std::pow removes every pow from the audio path, and
+handles a negative base — reachable when shape CV pushes shape outside
+[0, 2] — the same way the integer-exponent pow did. */
+inline void ShaperOscillator::updateHarmonics(float shape) {
+  cachedShape = shape;
+
+  const float harmonicReduction = std::abs(1.f - shape);
+  numHarmonics = (int)(8.f * (1.f - harmonicReduction)) + 1;
+  if (numHarmonics > MAX_HARMONICS)
+    numHarmonics = MAX_HARMONICS;
+
+  const float base = 1.f - harmonicReduction;
+  float gain = 1.f; // base^(h-1)
+  for (int h = 1; h <= numHarmonics; h++) {
+    harmonicCoef[h - 1] = gain / h; // (1/h) is the sawtooth harmonic series
+    gain *= base;
+  }
+}
+
+inline float ShaperOscillator::generateShapedWave(float ph, float shape) {
+  // harmonicReduction: 0.0 = full saw, 1.0 = approaching sine
+  if (std::abs(1.f - shape) < 0.01f)
+    return ph * 2.f - 1.f; // Pure sawtooth
+
+  if (shape != cachedShape)
+    updateHarmonics(shape);
+
+  // sin(h * theta) is built by angle addition from sin(theta) and cos(theta),
+  // so the whole series costs one sin and one cos instead of one sin per
+  // harmonic. This is an identity, not an approximation:
+  //   sin((h+1)t) = sin(ht)cos(t) + cos(ht)sin(t)
+  //   cos((h+1)t) = cos(ht)cos(t) - sin(ht)sin(t)
+  const float theta = 2.f * M_PI * ph;
+  const float s1 = std::sin(theta);
+  const float c1 = std::cos(theta);
+
+  float sh = s1, ch = c1;
+  float result = 0.f;
+  for (int h = 1; h <= numHarmonics; h++) {
+    result += harmonicCoef[h - 1] * sh;
+    const float nextS = sh * c1 + ch * s1;
+    const float nextC = ch * c1 - sh * s1;
+    sh = nextS;
+    ch = nextC;
+  }
+
+  return result;
+}
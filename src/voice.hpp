@@ -0,0 +1,141 @@
+#pragma once
+#include "envelope.hpp"
+#include "filter.hpp"
+#include "vco.hpp"
+
+/** One KI1H-VOICE voice: the VCO's two oscillators into the FILTER's LP
+ladder, shaped by an ENVELOPE ASD and a VCA channel. KI1H_VOICE.cpp owns the
+params and the polyphony; everything here is reachable from the tests without
+a Module.
+
+The stages are the same structs the four separate modules run, called back to
+back, so the voice sounds like the patched chain without its three cable hops
+of latency. */
+
+// ============================================================================
+// SHARED CONTROLS
+// ============================================================================
+/** The knob settings every voice reads, gathered once per frame rather than
+per voice. Pitches are in V/oct, frequencies in Hz. */
+struct VoiceControls {
+  float pitch = 0.f;    // coarse + fine
+  float interval = 0.f; // osc 2 above osc 1
+  float pulseWidth = 0.5f;
+  int wave = WAVE_SAW;
+  float shape = 0.5f;
+  int wave2 = SHAPER_SINSAW;
+  int syncType = 1; // the VCO's SYNC switch: 0 weak, 1 off, 2 strong
+  float blend = 0.f; // 0 is osc 1 alone, 1 is osc 2 alone
+  float cutoff = 1000.f;
+  float resonance = 0.f;
+  float envCutoff = 0.f; // added to the cutoff at full envelope
+  float attackStep = 0.f;
+  float releaseStep = 0.f;
+  float sustain = 1.f;
+  float level = 1.f;
+};
+
+// ============================================================================
+// VOICE
+// ============================================================================
+struct Voice {
+  BlepBank bleps;
+  RawOscillator osc1;
+  ShaperOscillator osc2;
+  LPFilter filter;
+  ASDEnvelope env;
+  ki1h::Channel vca;
+  dsp::SchmittTrigger gate;
+
+  Voice() {
+    osc1.bleps = &bleps;
+    osc2.bleps = &bleps;
+  }
+  // The oscillators point at this voice's own bank.
+  Voice(const Voice &) = delete;
+  Voice &operator=(const Voice &) = delete;
+
+  /** Runs one sample and returns the voice's output in volts. pitch and
+  cutoffMod are this voice's own CV, on top of the shared controls. */
+  float process(const VoiceControls &c, float pitch, float gateIn, float cutoffMod,
+                float sampleTime);
+
+  /** The ladder's coefficient. Call from onSampleRateChange; the oscillators
+  and the envelope take the sample time per sample. */
+  void setSampleTime(float st) {
+    filter.setSampleTime(st);
+  }
+
+  /** The silent state a freshly constructed voice has, phases aside. */
+  void reset() {
+    filter.reset();
+    env.reset();
+    gate.reset();
+    bleps.reset();
+    vca.output = 0.f;
+  }
+
+  /** Phases, sync history, filter memory and the envelope's stage. The BLEP
+  buffers hold a few samples of ringing, which is not worth saving. */
+  void saveState(ki1h::StateWriter &w) const {
+    w.put(osc1.phase.phase);
+    w.put(osc2.phase.phase);
+    w.put(osc2.syncTrigger.state);
+    w.put(osc2.prevSyncVal);
+    w.put(osc2.prevPull);
+    w.put(gate.state);
+    filter.saveState(w);
+    env.saveState(w);
+  }
+  void loadState(ki1h::StateReader &r) {
+    r.get(osc1.phase.phase);
+    r.get(osc2.phase.phase);
+    r.get(osc2.syncTrigger.state);
+    r.get(osc2.prevSyncVal);
+    r.get(osc2.prevPull);
+    r.get(gate.state);
+    filter.loadState(r);
+    env.loadState(r);
+    bleps.reset();
+    osc1.phase.phase -= std::floor(osc1.phase.phase);
+    osc2.phase.phase -= std::floor(osc2.phase.phase);
+  }
+};
+
+inline float Voice::process(const VoiceControls &c, float pitch, float gateIn, float cutoffMod,
+                            float sampleTime) {
+  // The envelope goes first: it gates everything after it, and an idle voice
+  // skips the oscillators and the ladder outright. Both simply pause, so the
+  // next note starts from wherever they stopped. The BLEP bank does not: its
+  // pending corrections belong to edges already played, so it is cleared on
+  // the way in rather than replayed at the next note.
+  const bool wasOff = env.stage == Envelope::STAGE_OFF;
+  if (gate.process(gateIn))
+    env.retrigger();
+  env.attackStep = c.attackStep;
+  env.releaseStep = c.releaseStep;
+  env.sustain = c.sustain;
+  env.process(sampleTime, true, gate.isHigh());
+  if (env.stage == Envelope::STAGE_OFF) {
+    if (!wasOff)
+      bleps.reset();
+    vca.output = 0.f;
+    return 0.f;
+  }
+
+  // Osc 1 normals into osc 2's sync exactly as on the VCO.
+  const float p = c.pitch + pitch;
+  osc1.process(p, c.pulseWidth, c.wave, sampleTime, false);
+  osc2.process(p + c.interval, 0.f, true, 1.f, c.syncType, ki1h::CV_SCALE_5V * osc1.getOutput(),
+               c.shape, c.wave2, sampleTime, true);
+  bleps.process();
+  const float mixed =
+      ki1h::CV_SCALE_5V * (osc1.getOutput() + c.blend * (osc2.getOutput() - osc1.getOutput()));
+
+  const float cutoff = clamp(c.cutoff + cutoffMod + c.envCutoff * env.env, LPFilter::minFreq,
+                             LPFilter::maxFreq);
+  filter.process(mixed, cutoff, c.resonance);
+
+  vca.process(softClip(filter.getOutput()), env.env * c.level);
+  return vca.getOutput();
+}
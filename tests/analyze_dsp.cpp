@@ -0,0 +1,342 @@
+/* Offline spectral analysis of the VCO and FILTER DSP.
+
+  make analyze RACK_DIR=/path/to/Rack-SDK
+
+The CPU benchmark says what each quality option costs; this says what it buys.
+Every oscillator mode is rendered at each oversampling factor across a sweep of
+pitches, and every filter mode is fed a sine at rising levels. Each render is
+windowed and run through the small FFT below, and reported as:
+
+- Oscillators: alias-to-signal ratio, in dB. Signal is the power in the bins
+  around each harmonic of the fundamental below Nyquist. Alias is everything
+  else between DC and 20 kHz, which for a periodic waveform can only be
+  components folded back from above Nyquist. The last few kHz below Nyquist
+  are left out: the half-band decimators fold their own transition band onto
+  them, and nobody hears it. Lower is better; around -90 dB is the floor the
+  window allows.
+- Filters: THD of harmonics 2 to 10, in percent, after the soft-clip output
+  stage, the way the module's jacks see it.
+
+Both print the CPU cost of the render next to the numbers, in ns per engine
+sample, so a quality setting can be chosen against its price. Built with the
+plugin's flags, like the benchmarks. */
+#include "filter.hpp"
+#include "vco.hpp"
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+static const double SAMPLE_RATE = 48000.0;
+// Transform length. At 48 kHz that is 1.46 Hz per bin, fine enough to keep
+// the harmonics of the lowest test pitch apart.
+static const int FFT_SIZE = 32768;
+// Rendered and discarded first, so the filters and BLEP buffers are settled.
+static const int SETTLE = 4096;
+// Half-width, in bins, of what counts as one spectral line. The window's main
+// lobe is 4 bins either side; the rest is margin for its skirt.
+static const int LINE_BINS = 6;
+// Top of the band aliasing is counted in.
+static const double ALIAS_BAND = 20000.0;
+
+// ============================================================================
+// FFT
+// ============================================================================
+/** In-place iterative radix-2 FFT. x.size() must be a power of two. */
+static void fft(std::vector<std::complex<double>> &x) {
+  const size_t n = x.size();
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(x[i], x[j]);
+  }
+  for (size_t len = 2; len <= n; len <<= 1) {
+    const double angle = -2.0 * M_PI / len;
+    const std::complex<double> w(std::cos(angle), std::sin(angle));
+    for (size_t i = 0; i < n; i += len) {
+      std::complex<double> wk(1.0, 0.0);
+      for (size_t k = 0; k < len / 2; k++) {
+        const std::complex<double> a = x[i + k];
+        const std::complex<double> b = x[i + k + len / 2] * wk;
+        x[i + k] = a + b;
+        x[i + k + len / 2] = a - b;
+        wk *= w;
+      }
+    }
+  }
+}
+
+/** Power spectrum, bins 0 to FFT_SIZE / 2, of a 4-term Blackman-Harris
+windowed signal. Its sidelobes sit at -92 dB, below anything measured here. */
+static std::vector<double> powerSpectrum(const std::vector<float> &signal) {
+  std::vector<std::complex<double>> x(FFT_SIZE);
+  for (int i = 0; i < FFT_SIZE; i++) {
+    const double a = 2.0 * M_PI * i / FFT_SIZE;
+    const double w =
+        0.35875 - 0.48829 * std::cos(a) + 0.14128 * std::cos(2 * a) - 0.01168 * std::cos(3 * a);
+    x[i] = signal[i] * w;
+  }
+  fft(x);
+  std::vector<double> power(FFT_SIZE / 2 + 1);
+  for (int i = 0; i <= FFT_SIZE / 2; i++)
+    power[i] = std::norm(x[i]);
+  return power;
+}
+
+/** Power in the line at `freq`, and marks its bins as used. */
+static double linePower(const std::vector<double> &power, std::vector<bool> &used, double freq) {
+  const int centre = (int)std::round(freq * FFT_SIZE / SAMPLE_RATE);
+  double sum = 0.0;
+  for (int i = std::max(centre - LINE_BINS, 0);
+       i <= std::min(centre + LINE_BINS, (int)power.size() - 1); i++) {
+    if (!used[i])
+      sum += power[i];
+    used[i] = true;
+  }
+  return sum;
+}
+
+static double toDb(double ratio) {
+  return 10.0 * std::log10(std::max(ratio, 1e-30));
+}
+
+/** Alias-to-signal ratio in dB of a periodic signal with fundamental f0,
+aliases counted up to ALIAS_BAND. */
+static double aliasRatio(const std::vector<float> &signal, double f0) {
+  const std::vector<double> power = powerSpectrum(signal);
+  std::vector<bool> used(power.size(), false);
+  linePower(power, used, 0.0); // DC is neither
+  double harmonics = 0.0;
+  for (double f = f0; f < SAMPLE_RATE / 2; f += f0)
+    harmonics += linePower(power, used, f);
+  const int top = (int)(ALIAS_BAND * FFT_SIZE / SAMPLE_RATE);
+  double alias = 0.0;
+  for (int i = 0; i <= top; i++)
+    if (!used[i])
+      alias += power[i];
+  return toDb(alias / harmonics);
+}
+
+/** THD of harmonics 2 to 10 of a sine at f0, as a percentage. */
+static double thdPercent(const std::vector<float> &signal, double f0) {
+  const std::vector<double> power = powerSpectrum(signal);
+  std::vector<bool> used(power.size(), false);
+  const double fundamental = linePower(power, used, f0);
+  double harmonics = 0.0;
+  for (int k = 2; k <= 10 && k * f0 < SAMPLE_RATE / 2; k++)
+    harmonics += linePower(power, used, k * f0);
+  return 100.0 * std::sqrt(harmonics / fundamental);
+}
+
+/** Renders SETTLE + FFT_SIZE samples through `next`, keeps the last FFT_SIZE,
+and times the whole render in ns per sample. */
+template <typename F>
+static std::vector<float> render(F next, double &ns) {
+  std::vector<float> out(FFT_SIZE);
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SETTLE; i++)
+    out[0] = next();
+  for (int i = 0; i < FFT_SIZE; i++)
+    out[i] = next();
+  const auto end = std::chrono::steady_clock::now();
+  ns = std::chrono::duration<double, std::nano>(end - start).count() / (SETTLE + FFT_SIZE);
+  return out;
+}
+
+// ============================================================================
+// OSCILLATORS
+// ============================================================================
+enum OscMode {
+  MODE_TRI,
+  MODE_SAW,
+  MODE_PULSE,
+  MODE_SUB,
+  MODE_SINSAW,
+  MODE_RAW_SAW,
+  MODE_SHAPER_PULSE,
+  MODE_HARD_SYNC,
+  MODE_LIN_FM,
+  NUM_OSC_MODES
+};
+
+static const char *OSC_MODE_NAMES[NUM_OSC_MODES] = {
+    "osc1 triangle",   "osc1 saw",         "osc1 pulse 50%",     "osc1 sub",
+    "osc2 sin-saw .5", "osc2 sin-saw 1.0", "osc2 pulse 30%",     "osc2 hard sync x1.5",
+    "osc2 lin FM",
+};
+
+/** The VCO's two oscillators, BLEP bank and decimators, run the way
+KI1H_VCO::process runs them, for one output of one mode. */
+struct VcoRender {
+  ki1h::MinBlepBank<16, 16> bank;
+  RawOscillator osc1;
+  ShaperOscillator osc2;
+  ki1h::HalfBandCascade<> decimator;
+  int mode;
+  int factor;
+  float pitch;
+
+  VcoRender(int mode, int factor, float pitch) : mode(mode), factor(factor), pitch(pitch) {
+    osc1.bleps = &bank;
+    osc2.bleps = &bank;
+  }
+  VcoRender(const VcoRender &) = delete;
+
+  float operator()() {
+    const float sampleTime = (float)(1.0 / SAMPLE_RATE) / factor;
+    float out[ki1h::HalfBandCascade<>::MAX_FACTOR];
+    for (int k = 0; k < factor; k++) {
+      out[k] = step(sampleTime);
+      bank.process();
+    }
+    return decimator.process(out, factor);
+  }
+
+  float step(float sampleTime) {
+    switch (mode) {
+    case MODE_TRI:
+      osc1.process(pitch, 0.5f, WAVE_TRI, sampleTime, false);
+      return osc1.getOutput();
+    case MODE_SAW:
+      osc1.process(pitch, 0.5f, WAVE_SAW, sampleTime, false);
+      return osc1.getOutput();
+    case MODE_PULSE:
+      osc1.process(pitch, 0.5f, WAVE_SQ, sampleTime, false);
+      return osc1.getOutput();
+    case MODE_SUB:
+      // One octave up, so the sub lands on the pitch under test.
+      osc1.process(pitch + 1.f, 0.5f, WAVE_SAW, sampleTime, true);
+      return osc1.getSub();
+    case MODE_SINSAW:
+      osc2.process(pitch, 0.f, true, 1.f, 1, 0.f, 0.5f, SHAPER_SINSAW, sampleTime, true);
+      return osc2.getOutput();
+    case MODE_RAW_SAW:
+      osc2.process(pitch, 0.f, true, 1.f, 1, 0.f, 1.f, SHAPER_SINSAW, sampleTime, true);
+      return osc2.getOutput();
+    case MODE_SHAPER_PULSE:
+      osc2.process(pitch, 0.f, true, 1.f, 1, 0.f, 0.3f, SHAPER_PULSE, sampleTime, true);
+      return osc2.getOutput();
+    case MODE_HARD_SYNC:
+      // Osc 1's square resets osc 2 a fifth above it, so the output repeats
+      // at osc 1's pitch.
+      osc1.process(pitch, 0.5f, WAVE_SQ, sampleTime, false);
+      osc2.process(pitch + 7.f / 12.f, 0.f, true, 1.f, 2, 5.f * osc1.getOutput(), 0.5f,
+                   SHAPER_SINSAW, sampleTime, true);
+      return osc2.getOutput();
+    case MODE_LIN_FM:
+      // Osc 1's sine at full depth into osc 2 at the same pitch: deep enough
+      // to run osc 2 through zero.
+      osc1.process(pitch, 0.5f, WAVE_SAW, sampleTime, false);
+      osc2.process(pitch, 5.f * osc1.getSin() * 3.f, true, 1.f, 1, 0.f, 0.5f, SHAPER_SINSAW,
+                   sampleTime, true);
+      return osc2.getOutput();
+    default:
+      return 0.f;
+    }
+  }
+};
+
+// 1 V/oct from C4: C3, C5, C7, C8 and C9, 131 Hz to 8.4 kHz.
+static const float PITCHES[] = {-1.f, 1.f, 3.f, 4.f, 5.f};
+static const int NUM_PITCHES = sizeof(PITCHES) / sizeof(PITCHES[0]);
+static const int FACTORS[] = {1, 2, 4, 8};
+
+static void analyzeOscillators() {
+  std::printf("Alias-to-signal ratio (dB) by pitch, and CPU (ns/sample)\n\n");
+  std::printf("%-22s %3s", "mode", "os");
+  for (int p = 0; p < NUM_PITCHES; p++)
+    std::printf(" %7.0fHz", dsp::FREQ_C4 * std::pow(2.f, PITCHES[p]));
+  std::printf("  %8s\n", "ns");
+
+  for (int mode = 0; mode < NUM_OSC_MODES; mode++) {
+    for (int factor : FACTORS) {
+      std::printf("%-22s %2dx", OSC_MODE_NAMES[mode], factor);
+      double totalNs = 0.0;
+      for (int p = 0; p < NUM_PITCHES; p++) {
+        VcoRender vco(mode, factor, PITCHES[p]);
+        double ns;
+        const std::vector<float> out = render([&]() { return vco(); }, ns);
+        totalNs += ns;
+        const double f0 = dsp::FREQ_C4 * std::pow(2.0, (double)PITCHES[p]);
+        std::printf(" %9.1f", aliasRatio(out, f0));
+      }
+      std::printf("  %8.1f\n", totalNs / NUM_PITCHES);
+    }
+  }
+}
+
+// ============================================================================
+// FILTERS
+// ============================================================================
+enum FilterMode { MODE_LP, MODE_LP_RES, MODE_BP, MODE_BP_RES, MODE_HP, NUM_FILTER_MODES };
+
+static const char *FILTER_MODE_NAMES[NUM_FILTER_MODES] = {
+    "LP 2 kHz", "LP 2 kHz res 1.2", "BP 440 Hz", "BP 440 Hz res 1.2", "HP 30 Hz",
+};
+
+static const float LEVELS[] = {1.f, 5.f, 10.f, 15.f};
+static const int NUM_LEVELS = sizeof(LEVELS) / sizeof(LEVELS[0]);
+// The test tone. On the BP's centre, and well inside the LP and HP passbands.
+static const double TONE = 440.0;
+
+static void analyzeFilters() {
+  std::printf("\nTHD (%%) of a %g Hz sine by input level, and CPU (ns/sample)\n\n", TONE);
+  std::printf("%-22s", "mode");
+  for (int l = 0; l < NUM_LEVELS; l++)
+    std::printf(" %8.0fV", LEVELS[l]);
+  std::printf("  %8s\n", "ns");
+
+  const float sampleTime = (float)(1.0 / SAMPLE_RATE);
+  for (int mode = 0; mode < NUM_FILTER_MODES; mode++) {
+    std::printf("%-22s", FILTER_MODE_NAMES[mode]);
+    double totalNs = 0.0;
+    for (int l = 0; l < NUM_LEVELS; l++) {
+      LPFilter lp;
+      BPFilter bp;
+      HPFilter hp;
+      lp.setSampleTime(sampleTime);
+      bp.setSampleTime(sampleTime);
+      hp.setSampleTime(sampleTime);
+      double phase = 0.0;
+      double ns;
+      const std::vector<float> out = render(
+          [&]() {
+            const float in = LEVELS[l] * (float)std::sin(2.0 * M_PI * phase);
+            phase += TONE / SAMPLE_RATE;
+            phase -= std::floor(phase);
+            switch (mode) {
+            case MODE_LP:
+              lp.process(in, 2000.f, 0.f);
+              return softClip(lp.getOutput());
+            case MODE_LP_RES:
+              lp.process(in, 2000.f, 1.2f);
+              return softClip(lp.getOutput());
+            case MODE_BP:
+              bp.process(in, (float)TONE, 1.f, 0.01f);
+              return softClip(bp.getOutput());
+            case MODE_BP_RES:
+              bp.process(in, (float)TONE, 1.f, 1.2f);
+              return softClip(bp.getOutput());
+            case MODE_HP:
+              hp.process(in, 30.f);
+              return softClip(hp.getOutput());
+            default:
+              return 0.f;
+            }
+          },
+          ns);
+      totalNs += ns;
+      std::printf(" %9.3f", thdPercent(out, TONE));
+    }
+    std::printf("  %8.1f\n", totalNs / NUM_LEVELS);
+  }
+}
+
+int main() {
+  analyzeOscillators();
+  analyzeFilters();
+  return 0;
+}
@@ -0,0 +1,445 @@
+/* Micro-benchmarks for src/dsp.hpp.
+
+  make bench RACK_DIR=/path/to/Rack-SDK
+
+Built with the same optimization flags the plugin is, so the numbers reflect
+what runs in Rack. The MinBLEP cases print nanoseconds per sample; they are
+for comparing layouts on one machine, not absolute budgets. The warm-start
+cases run the real modules, so unlike the rest this links every src/*.cpp
+against libRack.
+The silence cases turn flush-to-zero off, as on a host thread that never set
+it; linking with -funsafe-math-optimizations would otherwise turn it on for
+the whole process. */
+#include "dsp.hpp"
+#include "filter.hpp"
+#include "kaos.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using rack::simd::float_4;
+
+// Defeats dead-code elimination of the benchmarked loops.
+static volatile float sink;
+
+/** A line-for-line copy of dsp::MinBlepGenerator's insert/process loop, fed
+the same step as ki1h::MinBlepTable. The SDK's own generator builds its table
+with minBlepImpulse, which lives in libRack and is not linked here. */
+template <int Z, int O>
+struct ScalarBlep {
+  float buf[2 * Z] = {};
+  int pos = 0;
+  float impulse[2 * Z * O + 1];
+
+  ScalarBlep() {
+    const std::vector<double> step = ki1h::minPhaseStep(Z, O);
+    for (int i = 0; i <= 2 * Z * O; i++)
+      impulse[i] = (float)step[i];
+  }
+
+  void insertDiscontinuity(float p, float x) {
+    if (!(-1 < p && p <= 0))
+      return;
+    for (int j = 0; j < 2 * Z; j++) {
+      float minBlepIndex = ((float)j - p) * O;
+      int index = (int)minBlepIndex;
+      float lambda = minBlepIndex - index;
+      float minBlepValue = impulse[index] * (1 - lambda) + impulse[index + 1] * lambda;
+      buf[(pos + j) % (2 * Z)] += x * (-1.f + minBlepValue);
+    }
+  }
+
+  float process() {
+    float v = buf[pos];
+    buf[pos] = 0.f;
+    pos = (pos + 1) % (2 * Z);
+    return v;
+  }
+};
+
+/** The VCO's three band-limited outputs — osc1 main, osc1 sub, osc2 — as
+phasors at the given per-sample increments, each with a step at its wrap and
+the two square-wave outputs with a second at mid-cycle. */
+struct EdgeSource {
+  ki1h::Phasor phase[3];
+  float delta[3];
+
+  EdgeSource(float main, float osc2) {
+    delta[0] = main;
+    delta[1] = main / 2.f;
+    delta[2] = osc2;
+  }
+
+  /** Calls insert(lane, p, x) for every edge in this sample. */
+  template <typename F>
+  void step(F insert) {
+    for (int lane = 0; lane < 3; lane++) {
+      const bool wrapped = phase[lane].step(delta[lane]);
+      const float pWrap = ki1h::phaseCrossing(phase[lane].phase, delta[lane], wrapped, 0.f);
+      if (pWrap <= 0.f)
+        insert(lane, pWrap, 2.f);
+      if (lane == 0)
+        continue; // osc1 main is a saw
+      const float pMid = ki1h::phaseCrossing(phase[lane].phase, delta[lane], wrapped, 0.5f);
+      if (pMid <= 0.f)
+        insert(lane, pMid, -2.f);
+    }
+  }
+};
+
+static const int SAMPLES = 4000000;
+
+template <typename F>
+static double timeNs(F body) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SAMPLES; i++)
+    body();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+}
+
+static void benchBlep(const char *name, float main, float osc2) {
+  ScalarBlep<16, 16> separate[3];
+  EdgeSource a(main, osc2);
+  const double scalarNs = timeNs([&]() {
+    a.step([&](int lane, float p, float x) { separate[lane].insertDiscontinuity(p, x); });
+    sink = separate[0].process() + separate[1].process() + separate[2].process();
+  });
+
+  ki1h::MinBlepBank<16, 16> bank;
+  EdgeSource b(main, osc2);
+  const double bankNs = timeNs([&]() {
+    b.step([&](int lane, float p, float x) { bank.insertDiscontinuity(lane, p, x); });
+    const float_4 v = bank.process();
+    sink = v[0] + v[1] + v[2];
+  });
+
+  std::printf("%-28s 3 x MinBlepGenerator %6.2f ns/sample   MinBlepBank %6.2f ns/sample\n", name,
+              scalarNs, bankNs);
+}
+
+/** The VCO's four oversampled outputs decimated by four float cascades, and
+by the one float_4 cascade it runs instead. */
+static void benchHalfBand(int factor) {
+  const int n = ki1h::HalfBandCascade<>::MAX_FACTOR;
+  float in[4][n];
+  float_4 in4[n];
+  for (int k = 0; k < n; k++)
+    for (int d = 0; d < 4; d++)
+      in4[k].s[d] = in[d][k] = 0.1f * k - 0.2f * d;
+
+  ki1h::HalfBandCascade<> separate[4];
+  const double scalarNs = timeNs([&]() {
+    float sum = 0.f;
+    for (int d = 0; d < 4; d++)
+      sum += separate[d].process(in[d], factor);
+    sink = sum;
+  });
+
+  ki1h::HalfBandCascade<float_4> lanes;
+  const double lanesNs = timeNs([&]() {
+    const float_4 y = lanes.process(in4, factor);
+    sink = y[0] + y[1] + y[2] + y[3];
+  });
+
+  std::printf("Half-band, 4 outputs, %dx      4 x float cascade %6.2f ns/sample   float_4 %6.2f "
+              "ns/sample\n",
+              factor, scalarNs, lanesNs);
+}
+
+/** LPFilter's ladder as it was before its stages were flushed, feedback left
+out: a stand-in for any recursive filter left to decay on its own. Fed
+silence, each stage shrinks toward zero until it sticks at the smallest
+subnormal, where a * (x - y) rounds to nothing. */
+struct UnflushedLadder {
+  float stages[12] = {};
+  float coeff = 1.f - std::exp(-2.f * ki1h::PI * 1000.f / 48000.f);
+
+  float process(float input) {
+    for (int i = 0; i < 12; i++)
+      stages[i] += coeff * ((i ? stages[i - 1] : input) - stages[i]);
+    return stages[11];
+  }
+};
+
+/** LPFilter's ladder stage by stage, as it ran before the scan across lanes,
+feedback included. */
+struct SerialLadder {
+  float stages[12] = {};
+  float coeff = 1.f - std::exp(-2.f * ki1h::PI * 1000.f / 48000.f);
+
+  float process(float input, float resonance) {
+    float signal = input - HEADROOM * std::tanh(stages[11] * resonance / HEADROOM);
+    for (int i = 0; i < 12; i++)
+      stages[i] += coeff * ((i ? stages[i - 1] : signal) - stages[i]);
+    return stages[11];
+  }
+};
+
+/** The mono LP ladder at 1 kHz, stage by stage and as LPFilter runs it, linear
+and with every stage saturating. */
+static void benchLadder(float resonance) {
+  SerialLadder serial;
+  LPFilter lanes, saturating;
+  lanes.setSampleTime(1.f / 48000.f);
+  saturating.setSampleTime(1.f / 48000.f);
+  saturating.saturate = true;
+  int i = 0;
+  const double serialNs =
+      timeNs([&]() { sink = serial.process(5.f * std::sin(0.05f * i++), resonance); });
+  // The two LPFilters take turns, best of five each, since the ratio between
+  // them is what this is for and a busy machine skews a single pass.
+  double lanesNs = 1e9, saturatingNs = 1e9;
+  for (int round = 0; round < 5; round++) {
+    i = 0;
+    lanesNs = std::min(lanesNs, timeNs([&]() {
+      lanes.process(5.f * std::sin(0.05f * i++), 1000.f, resonance);
+      sink = lanes.getOutput();
+    }));
+    i = 0;
+    saturatingNs = std::min(saturatingNs, timeNs([&]() {
+      saturating.process(5.f * std::sin(0.05f * i++), 1000.f, resonance);
+      sink = saturating.getOutput();
+    }));
+  }
+  std::printf("LP ladder, resonance %.1f        stage by stage %6.2f ns/sample   scan %6.2f "
+              "ns/sample   saturating %6.2f ns/sample (%.2fx)\n",
+              resonance, serialNs, lanesNs, saturatingNs, saturatingNs / lanesNs);
+}
+
+/** Clears FTZ and DAZ for its lifetime: the inverse of ki1h::DenormalGuard. */
+struct SubnormalMode {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int saved = _mm_getcsr();
+  SubnormalMode() {
+    _mm_setcsr(saved & ~0x8040u);
+  }
+  ~SubnormalMode() {
+    _mm_setcsr(saved);
+  }
+#endif
+};
+
+/** ns/sample of `process` over the last 10 ms of 100 ms of a sine, then over
+the last 10 ms of 2 s of silence after it. */
+template <typename F>
+static void silenceCost(F process, double &loudNs, double &silentNs) {
+  const int rate = 48000;
+  const auto run = [&](int frames, bool signal, int offset) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+      sink = process(signal ? 5.f * std::sin(0.05f * (offset + i)) : 0.f);
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / frames;
+  };
+  run(rate / 10 - rate / 100, true, 0);
+  loudNs = run(rate / 100, true, rate / 10 - rate / 100);
+  run(2 * rate - rate / 100, false, 0);
+  silentNs = run(rate / 100, false, 0);
+}
+
+static void benchSilence() {
+  SubnormalMode subnormals;
+  double loud, silent;
+  UnflushedLadder bare;
+  silenceCost([&](float x) { return bare.process(x); }, loud, silent);
+  std::printf("Ladder into silence, no flush   %6.2f ns/sample loud   %6.2f ns/sample silent\n",
+              loud, silent);
+
+  UnflushedLadder guarded;
+  {
+    ki1h::DenormalGuard ftz;
+    silenceCost([&](float x) { return guarded.process(x); }, loud, silent);
+  }
+  std::printf("Ladder into silence, FTZ/DAZ    %6.2f ns/sample loud   %6.2f ns/sample silent\n",
+              loud, silent);
+
+  LPFilter lp;
+  lp.setSampleTime(1.f / 48000.f);
+  silenceCost([&](float x) {
+    lp.process(x, 1000.f, 0.f);
+    return lp.getOutput();
+  }, loud, silent);
+  std::printf("LPFilter into silence, flushed  %6.2f ns/sample loud   %6.2f ns/sample silent\n",
+              loud, silent);
+
+  BPFilter bp;
+  HPFilter hp;
+  bp.setSampleTime(1.f / 48000.f);
+  hp.setSampleTime(1.f / 48000.f);
+  silenceCost([&](float x) {
+    bp.process(x, 1000.f, 0.5f, 0.f);
+    hp.process(bp.getOutput(), 200.f);
+    return hp.getOutput();
+  }, loud, silent);
+  std::printf("BP + HP into silence, flushed   %6.2f ns/sample loud   %6.2f ns/sample silent\n",
+              loud, silent);
+}
+
+/** A BP whose frequency moves every sample, as under an audio-rate BP MOD,
+so its frequency terms are redone every sample and its Q terms never. */
+static void benchBPSweep() {
+  int i = 0;
+  BPFilter bp;
+  bp.setSampleTime(1.f / 48000.f);
+  const double ns = timeNs([&]() {
+    const float freq = 300.f + 2000.f * std::fabs((i++ & 1023) / 512.f - 1.f);
+    bp.process(0.3f, freq, 1.f, 0.5f);
+    sink = bp.getOutput();
+  });
+  std::printf("BP, frequency swept per sample  %6.2f ns/sample\n", ns);
+}
+
+/** An automation lane sweeping a BP's frequency, and the bottom of a 32-band
+bank, every sample: straight into the filter and through a SmoothedParam
+batching 16 samples, as the FILTER's knobs are. */
+static void benchKnobSweep() {
+  const float sampleTime = 1.f / 48000.f;
+  BPFilter bp;
+  bp.setSampleTime(sampleTime);
+  BPFilterBank bank;
+  bank.setSampleTime(sampleTime);
+  bank.setBands(BPFilterBank::MAX_BANDS);
+  ki1h::SmoothedParam knob;
+  knob.configure(sampleTime, ki1h::SmoothedParam::DEFAULT_TIME, 16);
+  int i = 0;
+  const auto lane = [&]() { return 100.f + 400.f * std::fabs((i++ & 4095) / 2048.f - 1.f); };
+  const auto runBP = [&](float freq) {
+    bp.process(0.3f, freq, 1.f, 0.5f);
+    sink = bp.getOutput();
+  };
+  const auto runBank = [&](float freq) {
+    bank.process(0.3f, freq, 8000.f, 0.5f, 0.3f);
+    sink = bank.getOutput(0);
+  };
+  const double bpRawNs = timeNs([&]() { runBP(lane()); });
+  i = 0;
+  const double bpSmoothedNs = timeNs([&]() { runBP(knob.process(lane())); });
+  i = 0;
+  const double bankRawNs = timeNs([&]() { runBank(lane()); });
+  i = 0;
+  const double bankSmoothedNs = timeNs([&]() { runBank(knob.process(lane())); });
+  std::printf("BP, knob automated              raw %6.2f ns/sample   smoothed %6.2f ns/sample\n",
+              bpRawNs, bpSmoothedNs);
+  std::printf("BP bank, 32 bands, automated    raw %6.2f ns/sample   smoothed %6.2f ns/sample\n",
+              bankRawNs, bankSmoothedNs);
+}
+
+/** A bank of `bands` BPs from 100 Hz to 8 kHz, as that many BPFilters and as
+one BPFilterBank. The knobs hold still, as they mostly do. */
+static void benchBank(int bands) {
+  const float sampleTime = 1.f / 48000.f;
+  std::vector<BPFilter> single(bands);
+  for (BPFilter &bp : single)
+    bp.setSampleTime(sampleTime);
+  BPFilterBank bank;
+  bank.setSampleTime(sampleTime);
+  bank.setBands(bands);
+  const float ratio = std::pow(80.f, 1.f / (bands - 1));
+  int i = 0;
+  const double singleNs = timeNs([&]() {
+    const float in = std::sin(0.05f * i++);
+    float freq = 100.f;
+    for (BPFilter &bp : single) {
+      bp.process(in, freq, 0.5f, 0.3f);
+      freq *= ratio;
+    }
+    sink = single[0].getOutput();
+  });
+  i = 0;
+  const double bankNs = timeNs([&]() {
+    bank.process(std::sin(0.05f * i++), 100.f, 8000.f, 0.5f, 0.3f);
+    sink = bank.getOutput(0);
+  });
+  std::printf("BP bank, %2d bands               BPFilters %6.2f ns/sample   bank %6.2f ns/sample\n",
+              bands, singleNs, bankNs);
+}
+
+/** KAOS's three noise streams, frame by frame as with block processing off,
+then through processBlock() at the latencies the menu offers. */
+static void benchKaosBlocks() {
+  KAOS perFrame(1);
+  int i = 0;
+  const double frameNs = timeNs([&]() {
+    perFrame.process(0.2f, 0.f, true, (i++ & 64) ? 10.f : 0.f, true);
+    sink = perFrame.getNoise() + perFrame.getpKaos();
+  });
+  std::printf("KAOS, per frame                 %6.2f ns/sample\n", frameNs);
+
+  for (int index = 1; index < ki1h::BlockFifo<3, 3>::NUM_SIZES; index++) {
+    const int n = ki1h::BlockFifo<3, 3>::blockSize(index);
+    KAOS blocked(1);
+    float color[64], trig[64], noise[64], pKaos[64], bKaos[64];
+    for (int k = 0; k < n; k++) {
+      color[k] = 0.2f;
+      trig[k] = (k & 8) ? 10.f : 0.f;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (int j = 0; j < SAMPLES; j += n) {
+      blocked.processBlock(color, trig, true, trig, true, noise, pKaos, bKaos, n);
+      sink = noise[0] + pKaos[0];
+    }
+    const auto end = std::chrono::steady_clock::now();
+    std::printf("KAOS, blocks of %2d              %6.2f ns/sample\n", n,
+                std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES);
+  }
+}
+
+/** Cost of a warm start in one of the modules that have one, built through
+the plugin's own Model with every output marked connected. The pre-roll runs
+ki1h::WarmStart::CHUNK frames per process() call, so what the audio thread
+feels is one of those calls next to a live one. */
+static void benchWarmStart(Model *model, int length) {
+  ki1h::DenormalGuard ftz;
+  Module *module = model->createModule();
+  for (Output &output : module->outputs)
+    output.channels = 1;
+  Module::SampleRateChangeEvent rate;
+  rate.sampleRate = 48000.f;
+  rate.sampleTime = 1.f / rate.sampleRate;
+  module->onSampleRateChange(rate);
+  json_t *data = json_object();
+  json_object_set_new(data, "warmStart", json_integer(length));
+  module->dataFromJson(data);
+  json_decref(data);
+  module->onAdd(Module::AddEvent());
+
+  Module::ProcessArgs args;
+  const int frames = ki1h::WarmStart::lengthFrames(length, rate.sampleRate);
+  const int calls = (frames + ki1h::WarmStart::CHUNK - 1) / ki1h::WarmStart::CHUNK;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++)
+    module->process(args);
+  const auto warm = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++)
+    module->process(args);
+  const auto end = std::chrono::steady_clock::now();
+  sink = module->outputs[0].getVoltage();
+  const double took = std::chrono::duration<double, std::milli>(warm - start).count();
+  const double live = std::chrono::duration<double, std::milli>(end - warm).count();
+  std::printf("Warm start, %-11s %3d ms  %6.3f ms over %4d calls, %5.2fx a live call\n",
+              model->slug.c_str(), ki1h::WarmStart::lengthMs(length), took, calls,
+              took / live);
+  delete module;
+}
+
+int main() {
+  // Increments are per sample at 48 kHz.
+  benchBlep("MinBLEP, A4 + E5", 440.f / 48000.f, 660.f / 48000.f);
+  benchBlep("MinBLEP, A7 + E8", 3520.f / 48000.f, 5274.f / 48000.f);
+  for (int factor = 2; factor <= ki1h::HalfBandCascade<>::MAX_FACTOR; factor *= 2)
+    benchHalfBand(factor);
+  benchLadder(0.f);
+  benchLadder(1.2f);
+  benchSilence();
+  benchBPSweep();
+  benchKnobSweep();
+  for (int bands = 8; bands <= BPFilterBank::MAX_BANDS; bands *= 2)
+    benchBank(bands);
+  benchKaosBlocks();
+  Model *warmStarted[] = {modelKI1H_VCO, modelKI1H_LFO, modelKI1H_FILTER, modelKI1H_KAOS};
+  for (Model *model : warmStarted)
+    for (int i = 1; i < ki1h::WarmStart::NUM_LENGTHS; i++)
+      benchWarmStart(model, i);
+  return 0;
+}
@@ -0,0 +1,39 @@
+/* The assertion harness shared by the test binaries.
+
+No test framework is vendored. The SDK pins -std=c++11, and the suites need
+two assertions and a float comparison, so a ~40-line harness costs less than
+dropping a 15,000-line single-header framework into the repo. Each binary is a
+single translation unit that includes this once. */
+#pragma once
+#include <cmath>
+#include <cstdio>
+
+static int checks = 0;
+static int failures = 0;
+
+static inline void check(bool ok, const char *expr, const char *file, int line) {
+  checks++;
+  if (!ok) {
+    failures++;
+    std::printf("FAIL %s:%d  %s\n", file, line, expr);
+  }
+}
+
+static inline void checkNear(float got, float want, float tol, const char *expr, const char *file,
+                             int line) {
+  checks++;
+  if (!(std::fabs(got - want) <= tol)) {
+    failures++;
+    std::printf("FAIL %s:%d  %s\n     got %.9g, want %.9g (tol %g)\n", file, line, expr, got, want,
+                tol);
+  }
+}
+
+#define CHECK(expr) check((expr), #expr, __FILE__, __LINE__)
+#define CHECK_NEAR(got, want, tol) checkNear((got), (want), (tol), #got " ~= " #want, __FILE__, __LINE__)
+
+/** Prints the tally and returns main()'s exit status. */
+static inline int report() {
+  std::printf("\n%d checks, %d failure%s\n", checks, failures, failures == 1 ? "" : "s");
+  return failures ? 1 : 0;
+}
@@ -1,10 +1,14 @@
-/* Minimal stubs so the test binary can link without libRack.
+/* Minimal stubs so the test binaries can link without libRack.
 
 Including plugin.hpp pulls in rack.hpp, whose component-library color
-constants are initialized at static-init time by calling into NanoVG. Those
-two functions are the only libRack symbols the test binary ends up needing;
-without them the process segfaults before main(). Nothing under test touches
-colors, so returning zeroes is fine. */
+constants are initialized at static-init time by calling into NanoVG. Without
+nvgRGB and nvgRGBA the process segfaults before main(). Nothing under test
+touches colors, so returning zeroes is fine.
+
+The module DSP the golden renders drive also constructs dsp::MinBlepGenerator,
+whose table comes from minBlepImpulse in libRack. ki1h::minPhaseStep builds
+the same minimum-phase step header-only, so it stands in here. */
+#include "dsp.hpp"
 #include <nanovg.h>
 
 extern "C" {
@@ -22,3 +26,15 @@ NVGcolor nvgRGBA(unsigned char r, unsigned char g, unsigned char b, unsigned cha
   return c;
 }
 }
+
+namespace rack {
+namespace dsp {
+
+void minBlepImpulse(int z, int o, float *output) {
+  const std::vector<double> step = ki1h::minPhaseStep(z, o);
+  for (int i = 0; i < 2 * z * o; i++)
+    output[i] = (float)step[i];
+}
+
+} // namespace dsp
+} // namespace rack
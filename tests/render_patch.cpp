@@ -0,0 +1,490 @@
+/* Headless renderer for Rack patches built from KI1H modules.
+
+  make render RACK_DIR=/path/to/Rack-SDK
+  tests/run_render [-s seconds] [-r rate] [--seed n] [-o module:output[:channel]]...
+                   [-w out.wav] patch.vcv
+
+Loads a .vcv (Rack 2's zstd-compressed tar, or a bare Rack 1 / extracted
+patch.json), builds every KI1H module in it through the plugin's own Models,
+restores its knobs and saved state, and wires the cables and expanders that
+run between KI1H modules. Then it steps the patch the way Rack's engine does:
+every module processes one frame, after which each cable copies its output to
+its input, so cables carry the same one-sample delay they do in Rack.
+
+Modules from other plugins are left out. Inputs they fed read as unpatched,
+and outputs that fed only them are still rendered. onAdd is not sent, so
+modules without saved state start cold, as they do in Rack with the warm
+start at its default, off. The random generator is seeded (--seed), so the
+KAOS noise and the unison drift repeat from run to run.
+
+-o picks what goes to the WAV, one channel per tap, as a module id or model
+slug (the first module of that model) and an output index; channel defaults
+to 0. Without -o, every KI1H output that has a cable is rendered. The WAV is
+32-bit float at 1.0 per 10 V.
+
+The timing table gives each module's average nanoseconds per frame and its
+share of the real-time budget at the render rate, measured around every
+process() call with the timer's own cost subtracted, so a module that
+costs less than the timer's jitter can read 0. Built with the plugin's
+flags, so the numbers are comparable to what Rack's CPU meter shows. */
+#include "dsp.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+  std::string patchPath;
+  std::string wavPath;
+  std::vector<std::string> taps;
+  float seconds = 10.f;
+  float sampleRate = 48000.f;
+  uint64_t seed = 0x4b493148;
+};
+
+void usage() {
+  std::fprintf(stderr, "usage: run_render [-s seconds] [-r rate] [--seed n] "
+                       "[-o module:output[:channel]]... [-w out.wav] patch.vcv\n");
+}
+
+bool parseOptions(int argc, char **argv, Options &opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "-s" && hasValue)
+      opts.seconds = std::atof(argv[++i]);
+    else if (arg == "-r" && hasValue)
+      opts.sampleRate = std::atof(argv[++i]);
+    else if (arg == "--seed" && hasValue)
+      opts.seed = std::strtoull(argv[++i], nullptr, 0);
+    else if (arg == "-o" && hasValue)
+      opts.taps.push_back(argv[++i]);
+    else if (arg == "-w" && hasValue)
+      opts.wavPath = argv[++i];
+    else if (arg[0] != '-' && opts.patchPath.empty())
+      opts.patchPath = arg;
+    else
+      return false;
+  }
+  return !opts.patchPath.empty() && opts.seconds > 0.f && opts.sampleRate > 0.f;
+}
+
+// ============================================================================
+// PATCH FILE
+// ============================================================================
+
+bool readFile(const std::string &path, std::string &out) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  return true;
+}
+
+/** Returns the patch's JSON root, or null. A file that starts with '{' is
+plain JSON, as Rack 1 saved it. Anything else is unpacked with libRack's own
+archive reader into a scratch directory, as Rack 2 does when it opens a patch. */
+json_t *loadPatch(const std::string &path) {
+  std::string text;
+  if (!readFile(path, text)) {
+    std::fprintf(stderr, "cannot read %s\n", path.c_str());
+    return nullptr;
+  }
+  if (text.empty() || text[0] != '{') {
+    std::string dir = system::join(system::getTempDirectory(), "ki1h-render-XXXXXX");
+    if (!mkdtemp(&dir[0])) {
+      std::fprintf(stderr, "cannot create a scratch directory\n");
+      return nullptr;
+    }
+    bool ok = false;
+    try {
+      system::unarchiveToDirectory(path, dir);
+      ok = readFile(system::join(dir, "patch.json"), text);
+    } catch (Exception &e) {
+      std::fprintf(stderr, "%s\n", e.what());
+    }
+    system::removeRecursively(dir);
+    if (!ok) {
+      std::fprintf(stderr, "%s holds no patch.json\n", path.c_str());
+      return nullptr;
+    }
+  }
+  json_error_t error;
+  json_t *root = json_loadb(text.data(), text.size(), 0, &error);
+  if (!root)
+    std::fprintf(stderr, "%s: %s\n", path.c_str(), error.text);
+  return root;
+}
+
+// ============================================================================
+// ENGINE
+// ============================================================================
+
+struct Slot {
+  int64_t id;
+  Module *module;
+  double seconds = 0.0;
+};
+
+struct Cable {
+  Output *output;
+  Input *input;
+};
+
+struct Tap {
+  std::string label;
+  Output *output;
+  int channel;
+};
+
+struct Patch {
+  std::vector<Slot> slots;
+  std::vector<Cable> cables;
+  std::map<int64_t, Module *> byId;
+  int skippedModules = 0;
+  int skippedCables = 0;
+
+  ~Patch() {
+    for (Slot &slot : slots)
+      delete slot.module;
+  }
+
+  Module *find(const std::string &key) {
+    char *end;
+    int64_t id = std::strtoll(key.c_str(), &end, 10);
+    if (*end == '\0') {
+      auto it = byId.find(id);
+      return it == byId.end() ? nullptr : it->second;
+    }
+    for (Slot &slot : slots)
+      if (slot.module->model->slug == key)
+        return slot.module;
+    return nullptr;
+  }
+};
+
+/** Creates the patch's KI1H modules and restores them as Rack's
+Module::fromJson does: params by id, then the module's own data. */
+bool buildModules(json_t *root, Plugin *plugin, Patch &patch) {
+  json_t *modulesJ = json_object_get(root, "modules");
+  for (size_t i = 0; i < json_array_size(modulesJ); i++) {
+    json_t *moduleJ = json_array_get(modulesJ, i);
+    const char *pluginSlug = json_string_value(json_object_get(moduleJ, "plugin"));
+    const char *modelSlug = json_string_value(json_object_get(moduleJ, "model"));
+    if (!pluginSlug || !modelSlug || plugin->slug != pluginSlug) {
+      patch.skippedModules++;
+      continue;
+    }
+    Model *model = plugin->getModel(modelSlug);
+    if (!model) {
+      std::fprintf(stderr, "this build has no %s module\n", modelSlug);
+      return false;
+    }
+    Module *module = model->createModule();
+    module->id = json_integer_value(json_object_get(moduleJ, "id"));
+
+    json_t *paramsJ = json_object_get(moduleJ, "params");
+    for (size_t p = 0; p < json_array_size(paramsJ); p++) {
+      json_t *paramJ = json_array_get(paramsJ, p);
+      json_t *idJ = json_object_get(paramJ, "id");
+      size_t paramId = idJ ? json_integer_value(idJ) : p;
+      if (paramId < module->params.size())
+        module->params[paramId].setValue(json_number_value(json_object_get(paramJ, "value")));
+    }
+    json_t *dataJ = json_object_get(moduleJ, "data");
+    if (dataJ)
+      module->dataFromJson(dataJ);
+
+    Slot slot;
+    slot.id = module->id;
+    slot.module = module;
+    patch.slots.push_back(slot);
+    patch.byId[module->id] = module;
+  }
+
+  // Expanders need every module to exist first.
+  for (size_t i = 0; i < json_array_size(modulesJ); i++) {
+    json_t *moduleJ = json_array_get(modulesJ, i);
+    auto it = patch.byId.find(json_integer_value(json_object_get(moduleJ, "id")));
+    if (it == patch.byId.end())
+      continue;
+    Module *module = it->second;
+    json_t *leftJ = json_object_get(moduleJ, "leftModuleId");
+    json_t *rightJ = json_object_get(moduleJ, "rightModuleId");
+    if (leftJ && patch.byId.count(json_integer_value(leftJ))) {
+      module->leftExpander.moduleId = json_integer_value(leftJ);
+      module->leftExpander.module = patch.byId[module->leftExpander.moduleId];
+    }
+    if (rightJ && patch.byId.count(json_integer_value(rightJ))) {
+      module->rightExpander.moduleId = json_integer_value(rightJ);
+      module->rightExpander.module = patch.byId[module->rightExpander.moduleId];
+    }
+  }
+  return true;
+}
+
+/** Connects the cables whose two ends are both KI1H modules. A newly
+connected output carries one channel until its module sets another count,
+as in Rack's Engine::addCable. */
+void buildCables(json_t *root, Patch &patch) {
+  json_t *cablesJ = json_object_get(root, "cables");
+  for (size_t i = 0; i < json_array_size(cablesJ); i++) {
+    json_t *cableJ = json_array_get(cablesJ, i);
+    auto from = patch.byId.find(json_integer_value(json_object_get(cableJ, "outputModuleId")));
+    auto to = patch.byId.find(json_integer_value(json_object_get(cableJ, "inputModuleId")));
+    size_t outputId = json_integer_value(json_object_get(cableJ, "outputId"));
+    size_t inputId = json_integer_value(json_object_get(cableJ, "inputId"));
+    if (from == patch.byId.end() || to == patch.byId.end() ||
+        outputId >= from->second->outputs.size() || inputId >= to->second->inputs.size()) {
+      patch.skippedCables++;
+      continue;
+    }
+    Cable cable = {&from->second->outputs[outputId], &to->second->inputs[inputId]};
+    if (cable.output->channels == 0)
+      cable.output->channels = 1;
+    patch.cables.push_back(cable);
+  }
+}
+
+std::string outputLabel(Module *module, int outputId, int channel) {
+  std::string name = module->outputInfos[outputId] ? module->outputInfos[outputId]->name : "";
+  std::string label = module->model->slug + " " + std::to_string(outputId);
+  if (!name.empty())
+    label += " (" + name + ")";
+  if (channel > 0)
+    label += " ch " + std::to_string(channel + 1);
+  return label;
+}
+
+/** Resolves the -o taps, or with none given, every KI1H output that has a
+cable, including cables into modules that are not rendered. */
+bool buildTaps(json_t *root, const Options &opts, Patch &patch, std::vector<Tap> &taps) {
+  if (opts.taps.empty()) {
+    json_t *cablesJ = json_object_get(root, "cables");
+    for (size_t i = 0; i < json_array_size(cablesJ); i++) {
+      json_t *cableJ = json_array_get(cablesJ, i);
+      auto from = patch.byId.find(json_integer_value(json_object_get(cableJ, "outputModuleId")));
+      int outputId = json_integer_value(json_object_get(cableJ, "outputId"));
+      if (from == patch.byId.end() || outputId >= (int)from->second->outputs.size())
+        continue;
+      Output *output = &from->second->outputs[outputId];
+      bool seen = false;
+      for (const Tap &tap : taps)
+        seen |= tap.output == output;
+      if (seen)
+        continue;
+      if (output->channels == 0)
+        output->channels = 1;
+      taps.push_back({outputLabel(from->second, outputId, 0), output, 0});
+    }
+    return true;
+  }
+
+  for (const std::string &spec : opts.taps) {
+    std::vector<std::string> fields;
+    std::stringstream stream(spec);
+    for (std::string field; std::getline(stream, field, ':');)
+      fields.push_back(field);
+    Module *module = fields.size() >= 2 ? patch.find(fields[0]) : nullptr;
+    int outputId = fields.size() >= 2 ? std::atoi(fields[1].c_str()) : -1;
+    int channel = fields.size() >= 3 ? std::atoi(fields[2].c_str()) : 0;
+    if (!module || outputId < 0 || outputId >= (int)module->outputs.size() || channel < 0 ||
+        channel >= PORT_MAX_CHANNELS) {
+      std::fprintf(stderr, "no such output: %s\n", spec.c_str());
+      return false;
+    }
+    Output *output = &module->outputs[outputId];
+    if (output->channels == 0)
+      output->channels = 1;
+    taps.push_back({outputLabel(module, outputId, channel), output, channel});
+  }
+  return true;
+}
+
+/** One Rack engine frame: process every module, then step the cables and
+swap any expander messages that were requested. */
+void stepFrame(Patch &patch, const Module::ProcessArgs &args, double timerCost) {
+  Clock::time_point last = Clock::now();
+  for (Slot &slot : patch.slots) {
+    slot.module->process(args);
+    Clock::time_point now = Clock::now();
+    slot.seconds += std::chrono::duration<double>(now - last).count() - timerCost;
+    last = now;
+  }
+
+  // As Rack's Cable_step: non-finite voltages become 0, and the input takes
+  // the output's channel count.
+  for (Cable &cable : patch.cables) {
+    int channels = cable.output->channels;
+    for (int c = 0; c < channels; c++) {
+      float v = cable.output->voltages[c];
+      cable.input->voltages[c] = std::isfinite(v) ? v : 0.f;
+    }
+    for (int c = channels; c < cable.input->channels; c++)
+      cable.input->voltages[c] = 0.f;
+    cable.input->channels = channels;
+  }
+
+  for (Slot &slot : patch.slots) {
+    for (Module::Expander *expander : {&slot.module->leftExpander, &slot.module->rightExpander}) {
+      if (!expander->messageFlipRequested)
+        continue;
+      std::swap(expander->producerMessage, expander->consumerMessage);
+      expander->messageFlipRequested = false;
+    }
+  }
+}
+
+/** Cost of one Clock::now(), which every module's time in stepFrame also
+contains. */
+double measureTimerCost() {
+  const int n = 1000000;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < n; i++)
+    Clock::now();
+  return std::chrono::duration<double>(Clock::now() - start).count() / n;
+}
+
+// ============================================================================
+// WAV OUTPUT
+// ============================================================================
+
+void putU16(std::string &out, uint32_t v) {
+  out += (char)(v & 0xff);
+  out += (char)((v >> 8) & 0xff);
+}
+
+void putU32(std::string &out, uint32_t v) {
+  putU16(out, v & 0xffff);
+  putU16(out, v >> 16);
+}
+
+/** Writes interleaved frames as a 32-bit IEEE float WAV. */
+bool writeWav(const std::string &path, const std::vector<float> &samples, int channels,
+              int sampleRate) {
+  uint32_t dataBytes = samples.size() * 4;
+  std::string out;
+  out += "RIFF";
+  putU32(out, 36 + dataBytes);
+  out += "WAVEfmt ";
+  putU32(out, 16);
+  putU16(out, 3);
+  putU16(out, channels);
+  putU32(out, sampleRate);
+  putU32(out, sampleRate * channels * 4);
+  putU16(out, channels * 4);
+  putU16(out, 32);
+  out += "data";
+  putU32(out, dataBytes);
+  for (float s : samples) {
+    uint32_t bits;
+    std::memcpy(&bits, &s, 4);
+    putU32(out, bits);
+  }
+  std::ofstream file(path, std::ios::binary);
+  file.write(out.data(), out.size());
+  return (bool)file;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parseOptions(argc, argv, opts)) {
+    usage();
+    return 2;
+  }
+
+  json_t *root = loadPatch(opts.patchPath);
+  if (!root)
+    return 1;
+
+  // Seeded before any module exists, since their noise sources seed
+  // themselves from it on construction.
+  random::local().seed(opts.seed, 0x9e3779b97f4a7c15ull);
+
+  Plugin *plugin = new Plugin;
+  plugin->slug = "Architexture";
+  init(plugin);
+
+  Patch patch;
+  if (!buildModules(root, plugin, patch))
+    return 1;
+  buildCables(root, patch);
+  // As Rack's engine does for every module it adds.
+  Module::SampleRateChangeEvent rateEvent;
+  rateEvent.sampleRate = opts.sampleRate;
+  rateEvent.sampleTime = 1.f / opts.sampleRate;
+  for (const Slot &slot : patch.slots)
+    slot.module->onSampleRateChange(rateEvent);
+  std::vector<Tap> taps;
+  if (!buildTaps(root, opts, patch, taps))
+    return 1;
+  if (patch.slots.empty()) {
+    std::fprintf(stderr, "%s has no KI1H modules\n", opts.patchPath.c_str());
+    return 1;
+  }
+
+  std::printf("%s: %d KI1H modules with %d cables between them; %d other modules and %d "
+              "cables left out\n",
+              opts.patchPath.c_str(), (int)patch.slots.size(), (int)patch.cables.size(),
+              patch.skippedModules, patch.skippedCables);
+
+  const int64_t frames = (int64_t)std::lround(opts.seconds * opts.sampleRate);
+  Module::ProcessArgs args;
+  args.sampleRate = opts.sampleRate;
+  args.sampleTime = 1.f / opts.sampleRate;
+
+  std::vector<float> samples;
+  if (!opts.wavPath.empty())
+    samples.reserve(frames * taps.size());
+
+  const double timerCost = measureTimerCost();
+  // Rack's engine threads flush denormals; so does this one.
+  ki1h::DenormalGuard ftz;
+  Clock::time_point start = Clock::now();
+  for (int64_t frame = 0; frame < frames; frame++) {
+    args.frame = frame;
+    stepFrame(patch, args, timerCost);
+    if (!opts.wavPath.empty())
+      for (const Tap &tap : taps)
+        samples.push_back(tap.output->voltages[tap.channel] / 10.f);
+  }
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  if (!opts.wavPath.empty()) {
+    if (!writeWav(opts.wavPath, samples, taps.size(), (int)opts.sampleRate)) {
+      std::fprintf(stderr, "cannot write %s\n", opts.wavPath.c_str());
+      return 1;
+    }
+    std::printf("\nwrote %s, %.2f s at %g Hz:\n", opts.wavPath.c_str(), opts.seconds,
+                opts.sampleRate);
+    for (size_t i = 0; i < taps.size(); i++)
+      std::printf("  ch %-2d %s\n", (int)i + 1, taps[i].label.c_str());
+  }
+
+  const double budgetNs = 1e9 / opts.sampleRate;
+  double moduleNs = 0.0;
+  std::printf("\n%-18s %-14s %10s %9s\n", "module id", "model", "ns/frame", "budget");
+  for (const Slot &slot : patch.slots) {
+    double ns = std::max(slot.seconds * 1e9 / frames, 0.0);
+    moduleNs += ns;
+    std::printf("%-18lld %-14s %10.1f %8.2f%%\n", (long long)slot.id,
+                slot.module->model->slug.c_str(), ns, 100.0 * ns / budgetNs);
+  }
+  std::printf("%-18s %-14s %10.1f %8.2f%%\n", "all modules", "", moduleNs,
+              100.0 * moduleNs / budgetNs);
+  std::printf("\nrendered %.2f s in %.3f s, %.1fx real time (cables and timers included)\n",
+              opts.seconds, elapsed, opts.seconds / elapsed);
+
+  json_decref(root);
+  return 0;
+}
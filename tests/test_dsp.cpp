@@ -2,47 +2,16 @@
 
 Run with `make test RACK_DIR=/path/to/Rack-SDK`.
 
-No test framework is vendored. The SDK pins -std=c++11, and the whole suite
-needs two assertions and a float comparison, so a ~40-line harness costs less
-than dropping a 15,000-line single-header framework into the repo.
-
-Scope: everything in src/dsp.hpp. The other functions the issue names —
-Mix::process, KI1H_ENVELOPE::convertCVToTimeInSeconds,
-Oscillator::calculateFreq, and the filter step responses — are still welded to
-their Module subclasses in the .cpp files, so they are not reachable from here
-yet. Each becomes testable when its own extraction lands; see issues #43, #54,
-#55 and #57. */
+Scope: everything in src/dsp.hpp, including the envelope stage-time mapping
+(StageTimeMap). The per-module DSP structs in src/vco.hpp, src/filter.hpp and
+the rest are covered end to end by the golden renders in tests/test_golden.cpp
+rather than here. */
 
 #include "dsp.hpp"
+#include "harness.hpp"
 #include <cmath>
 #include <cstdio>
-
-// ============================================================================
-// HARNESS
-// ============================================================================
-static int checks = 0;
-static int failures = 0;
-
-static void check(bool ok, const char *expr, const char *file, int line) {
-  checks++;
-  if (!ok) {
-    failures++;
-    std::printf("FAIL %s:%d  %s\n", file, line, expr);
-  }
-}
-
-static void checkNear(float got, float want, float tol, const char *expr, const char *file,
-                      int line) {
-  checks++;
-  if (!(std::fabs(got - want) <= tol)) {
-    failures++;
-    std::printf("FAIL %s:%d  %s\n     got %.9g, want %.9g (tol %g)\n", file, line, expr, got, want,
-                tol);
-  }
-}
-
-#define CHECK(expr) check((expr), #expr, __FILE__, __LINE__)
-#define CHECK_NEAR(got, want, tol) checkNear((got), (want), (tol), #got " ~= " #want, __FILE__, __LINE__)
+#include <vector>
 
 // ============================================================================
 // softLimit
@@ -146,6 +115,23 @@ static void testPhasor() {
 
   run.reset();
   CHECK_NEAR(run.phase, 0.f, 0.f);
+
+  // Negative increments, as through-zero FM produces. step() reports a wrap
+  // past 0.0 going backward just as it does past 1.0 going forward.
+  ki1h::Phasor back;
+  CHECK(!back.step(0.25f));
+  CHECK(back.step(-0.5f));
+  CHECK_NEAR(back.phase, 0.75f, 1e-6f);
+  CHECK(!back.step(-0.25f));
+  CHECK_NEAR(back.phase, 0.5f, 1e-6f);
+  CHECK(back.step(-2.25f));
+  CHECK_NEAR(back.phase, 0.25f, 1e-5f);
+
+  // A backward step too small to survive the wrap's rounding lands on 0, not
+  // on an out-of-range 1.0.
+  ki1h::Phasor tiny;
+  tiny.step(-1e-9f);
+  CHECK(tiny.phase >= 0.f && tiny.phase < 1.f);
 }
 
 // ============================================================================
@@ -226,6 +212,728 @@ static void testPitchToFreq() {
   }
 }
 
+// ============================================================================
+// StageTimeMap / OnePole
+// ============================================================================
+static void testStageTimeMap() {
+  // KI1H-ENVELOPE's range: 3 ms to 10 s.
+  const ki1h::StageTimeMap map(0.003f, 10.f);
+  CHECK_NEAR(map.time(0.f), 0.003f, 1e-7f);
+  CHECK_NEAR(map.time(1.f), 10.f, 1e-4f);
+
+  // Matches the std::pow mapping it replaced, to well under 0.01%, and the
+  // increment is the reciprocal of the time in samples.
+  const float sampleTime = 1.f / 48000.f;
+  for (int i = 0; i <= 100; i++) {
+    const float x = i * 0.01f;
+    const float exact = 0.003f * std::pow(10.f / 0.003f, x);
+    CHECK(std::fabs(map.time(x) - exact) / exact < 1e-4f);
+    CHECK(std::fabs(map.increment(x, sampleTime) * exact / sampleTime - 1.f) < 1e-4f);
+    if (failures)
+      return;
+  }
+
+  // Monotonic, including across the octave boundaries where exp2_taylor5
+  // switches exponent.
+  float prev = 0.f;
+  for (int i = 0; i <= 1000; i++) {
+    const float t = map.time(i * 0.001f);
+    CHECK(t > prev);
+    prev = t;
+  }
+}
+
+// ============================================================================
+// Denormals
+// ============================================================================
+static void testDenormals() {
+  CHECK_NEAR(ki1h::flushDenormal(1e-30f), 0.f, 0.f);
+  CHECK_NEAR(ki1h::flushDenormal(-1e-21f), 0.f, 0.f);
+  CHECK_NEAR(ki1h::flushDenormal(1e-6f), 1e-6f, 0.f);
+
+  ki1h::DenormalFlush flush;
+  int due = 0;
+  for (int i = 0; i < 10 * ki1h::DenormalFlush::PERIOD; i++)
+    due += flush.due();
+  CHECK(due == 10);
+
+  // A one-pole fed silence ends at exact zero instead of sticking at the
+  // smallest subnormal, whatever this thread's FP mode.
+  ki1h::OnePole lp;
+  lp.setCutoff(100.f, 1.f / 48000.f);
+  lp.reset(5.f);
+  for (int i = 0; i < 48000; i++)
+    lp.process(0.f);
+  CHECK(lp.y == 0.f);
+
+  // Under the guard, a product that would be subnormal comes out zero.
+  volatile float tiny = 1e-20f; // squared, 1e-40 is subnormal
+  {
+    ki1h::DenormalGuard ftz;
+    CHECK(tiny * tiny == 0.f);
+  }
+}
+
+static void testOnePole() {
+  ki1h::OnePole lp;
+
+  // Default coefficient passes straight through.
+  CHECK_NEAR(lp.process(3.f), 3.f, 0.f);
+
+  // A step settles to within 1% in about 0.73 / cutoff.
+  const float sampleTime = 1.f / 48000.f;
+  lp.reset();
+  lp.setCutoff(1000.f, sampleTime);
+  const int settle = (int)(0.73f / 1000.f / sampleTime);
+  float y = 0.f;
+  for (int i = 0; i < settle - 2; i++)
+    y = lp.process(1.f);
+  CHECK(y < 0.99f);
+  for (int i = 0; i < 4; i++)
+    y = lp.process(1.f);
+  CHECK(y > 0.99f && y <= 1.f);
+
+  // Never overshoots, and moves by at most the coefficient's share of a step
+  // per sample: a 10 V CV jump becomes a ramp, not a click.
+  lp.reset();
+  float last = 0.f;
+  for (int i = 0; i < 1000; i++) {
+    y = lp.process(10.f);
+    CHECK(y >= last && y <= 10.f);
+    CHECK(y - last <= 10.f * lp.a + 1e-6f);
+    last = y;
+  }
+}
+
+static void testSmoothedParam() {
+  ki1h::SmoothedParam knob;
+  // 10 ms at 48 kHz in 16-sample steps: 30 of them.
+  knob.configure(1.f / 48000.f, 0.01f, 16);
+  CHECK(knob.steps == 30);
+
+  // The first value passes straight through.
+  CHECK_NEAR(knob.process(0.25f), 0.25f, 0.f);
+  CHECK(knob.settled());
+
+  // A turn moves at once, then holds for a batch between steps, never
+  // overshoots, and lands on the target exactly after steps * batch samples.
+  float last = knob.process(1.25f);
+  CHECK(last > 0.25f);
+  int moves = 1;
+  bool monotonic = true, batched = true;
+  for (int i = 1; i < 30 * 16; i++) {
+    const float y = knob.process(1.25f);
+    monotonic = monotonic && y >= last && y <= 1.25f;
+    if (y != last) {
+      batched = batched && i % 16 == 0;
+      moves++;
+    }
+    last = y;
+  }
+  CHECK(monotonic);
+  CHECK(batched);
+  CHECK(moves == 30);
+  CHECK(last == 1.25f);
+  CHECK(knob.settled());
+
+  // Settled, it stays put without touching the value.
+  CHECK(knob.process(1.25f) == 1.25f);
+
+  // A new target mid-slew turns around from where the value is.
+  knob.configure(1.f / 48000.f, 0.01f, 1);
+  knob.process(0.f);
+  for (int i = 0; i < 240; i++)
+    last = knob.process(0.f);
+  CHECK(last > 0.f && last < 1.25f);
+  const float turn = knob.process(2.f);
+  CHECK(turn > last);
+  for (int i = 0; i < 480; i++)
+    last = knob.process(2.f);
+  CHECK(last == 2.f);
+
+  knob.reset(-1.f);
+  CHECK(knob.process(-1.f) == -1.f);
+  CHECK(knob.settled());
+}
+
+// ============================================================================
+// MinBLAMP
+// ============================================================================
+/** Fraction of a signal's energy, in dB, that lies off the harmonic series of a
+tone with `cycles` whole periods in the buffer. Plain DFT; the buffers here
+are short. */
+static float offHarmonicDb(const std::vector<float> &x, int cycles) {
+  const int n = (int)x.size();
+  std::vector<float> c(n), s(n);
+  for (int i = 0; i < n; i++) {
+    c[i] = std::cos(2.f * ki1h::PI * i / n);
+    s[i] = std::sin(2.f * ki1h::PI * i / n);
+  }
+  double harmonic = 0.0, other = 0.0;
+  for (int k = 1; k < n / 2; k++) {
+    double re = 0.0, im = 0.0;
+    for (int i = 0; i < n; i++) {
+      const int w = (int)(((long long)k * i) % n);
+      re += x[i] * c[w];
+      im -= x[i] * s[w];
+    }
+    const double e = re * re + im * im;
+    if (k % cycles == 0)
+      harmonic += e;
+    else
+      other += e;
+  }
+  return (float)(10.0 * std::log10(other / harmonic));
+}
+
+static void testMinBlamp() {
+  const ki1h::MinBlampTable<16, 16> &table = ki1h::MinBlampTable<16, 16>::get();
+
+  // The residual starts at the corner and has fully decayed by the end of the
+  // table; otherwise dropping it after 2 * Z samples would leave a step.
+  CHECK_NEAR(table.residual[0], 0.f, 1e-3f);
+  CHECK_NEAR(table.residual[2 * 16 * 16], 0.f, 0.f);
+  // Just after the corner the band-limited ramp has not turned yet, so the
+  // residual cancels almost all of the naive ramp's first sample.
+  CHECK(table.residual[16] < -0.5f);
+
+  // Silent until something is inserted.
+  ki1h::MinBlampGenerator<16, 16> quiet;
+  for (int i = 0; i < 64; i++)
+    CHECK_NEAR(quiet.process(), 0.f, 0.f);
+
+  // Out-of-range positions are ignored, exactly like the SDK's MinBLEP.
+  quiet.insertDiscontinuity(0.5f, 1.f);
+  quiet.insertDiscontinuity(-1.f, 1.f);
+  for (int i = 0; i < 64; i++)
+    CHECK_NEAR(quiet.process(), 0.f, 0.f);
+
+  // Linear in the slope change, and gone after 2 * Z samples.
+  ki1h::MinBlampGenerator<16, 16> one, two;
+  one.insertDiscontinuity(-0.3f, 1.f);
+  two.insertDiscontinuity(-0.3f, 2.f);
+  for (int i = 0; i < 32; i++)
+    CHECK_NEAR(two.process(), 2.f * one.process(), 1e-6f);
+  for (int i = 0; i < 32; i++) {
+    CHECK_NEAR(one.process(), 0.f, 0.f);
+    two.process();
+  }
+
+  // A triangle at 4940 Hz, 247 whole cycles in 2400 samples at 48 kHz. Every
+  // off-harmonic bin is aliasing, and correcting the corners must cut it hard.
+  const int n = 2400, cycles = 247;
+  const float delta = (float)cycles / n;
+  std::vector<float> naive(n), corrected(n);
+  ki1h::Phasor ph;
+  ki1h::MinBlampGenerator<16, 16> blamp;
+  for (int i = -64; i < n; i++) {
+    const bool wrapped = ph.advance(delta, 1.f);
+    const float end = ph.phase + (wrapped ? 1.f : 0.f);
+    if (wrapped)
+      blamp.insertDiscontinuity(-(end - 1.f) / delta, 8.f * delta);
+    if (end - delta < 0.5f && 0.5f <= end)
+      blamp.insertDiscontinuity(-(end - 0.5f) / delta, -8.f * delta);
+    else if (end - delta < 1.5f && 1.5f <= end)
+      blamp.insertDiscontinuity(-(end - 1.5f) / delta, -8.f * delta);
+    const float tri = ki1h::triangle(ph.phase);
+    const float out = tri + blamp.process();
+    if (i >= 0) {
+      naive[i] = tri;
+      corrected[i] = out;
+    }
+  }
+  const float naiveDb = offHarmonicDb(naive, cycles);
+  const float correctedDb = offHarmonicDb(corrected, cycles);
+  CHECK(correctedDb < naiveDb - 8.f);
+}
+
+// ============================================================================
+// Shared MinBLEP bank
+// ============================================================================
+static void testMinBlepBank() {
+  const std::vector<double> step = ki1h::minPhaseStep(16, 16);
+  const ki1h::MinBlepTable<16, 16> &table = ki1h::MinBlepTable<16, 16>::get();
+
+  // The step rises from 0 and settles at 1, so the residual runs from -1 to 0.
+  CHECK_NEAR(step[0], 0.f, 1e-3f);
+  CHECK_NEAR(step[2 * 16 * 16], 1.f, 0.f);
+  CHECK_NEAR(table.rows[0][0][0], -1.f, 1e-3f);
+  CHECK_NEAR(table.rows[16][7][3], 0.f, 0.f);
+
+  // Silent until something is inserted, and out-of-range positions are
+  // ignored, exactly like the SDK's MinBLEP.
+  ki1h::MinBlepBank<16, 16> quiet;
+  quiet.insertDiscontinuity(0, 0.5f, 1.f);
+  quiet.insertDiscontinuity(1, -1.f, 1.f);
+  for (int i = 0; i < 64; i++) {
+    const rack::simd::float_4 v = quiet.process();
+    for (int lane = 0; lane < 4; lane++)
+      CHECK_NEAR(v[lane], 0.f, 0.f);
+  }
+
+  // Each lane matches a direct evaluation of the residual, the way
+  // dsp::MinBlepGenerator does it, and leaves the other lanes alone. Inserted
+  // at staggered times so the buffer's fold-down happens mid-correction.
+  ki1h::MinBlepBank<16, 16> bank;
+  const float ps[3] = {0.f, -0.37f, -0.999f};
+  const float xs[3] = {2.f, -1.5f, 0.25f};
+  const int at[3] = {5, 20, 29};
+  for (int t = 0; t < 100; t++) {
+    for (int lane = 0; lane < 3; lane++)
+      if (t == at[lane])
+        bank.insertDiscontinuity(lane, ps[lane], xs[lane]);
+    float current[3];
+    for (int lane = 0; lane < 3; lane++)
+      current[lane] = bank.current(lane);
+    const rack::simd::float_4 v = bank.process();
+    for (int lane = 0; lane < 3; lane++) {
+      CHECK_NEAR(current[lane], v[lane], 0.f);
+      float expected = 0.f;
+      const int j = t - at[lane];
+      if (j >= 0 && j < 32) {
+        const float index = (j - ps[lane]) * 16;
+        const int i = (int)index;
+        const float lambda = index - i;
+        const double r = (step[i] - 1.0) * (1 - lambda) + (step[i + 1] - 1.0) * lambda;
+        expected = (float)(xs[lane] * r);
+      }
+      CHECK_NEAR(v[lane], expected, 1e-5f);
+    }
+    CHECK_NEAR(v[3], 0.f, 0.f);
+  }
+
+  // reset() drops a correction still in flight, so nothing replays later.
+  ki1h::MinBlepBank<16, 16> flushed;
+  flushed.insertDiscontinuity(1, -0.5f, 1.f);
+  flushed.process();
+  flushed.reset();
+  for (int i = 0; i < 64; i++)
+    CHECK_NEAR(flushed.process()[1], 0.f, 0.f);
+
+  // The same 4940 Hz test tone as testMinBlamp, as a saw. Correcting its wraps
+  // through the bank must cut the aliasing hard.
+  const int n = 2400, cycles = 247;
+  const float delta = (float)cycles / n;
+  std::vector<float> naive(n), corrected(n);
+  ki1h::Phasor ph;
+  ki1h::MinBlepBank<16, 16> sawBank;
+  for (int i = -64; i < n; i++) {
+    const bool wrapped = ph.step(delta);
+    const float p = ki1h::phaseCrossing(ph.phase, delta, wrapped, 0.f);
+    if (p <= 0.f)
+      sawBank.insertDiscontinuity(2, p, 2.f);
+    const float saw = ki1h::saw(ph.phase);
+    const float out = saw + sawBank.process()[2];
+    if (i >= 0) {
+      naive[i] = saw;
+      corrected[i] = out;
+    }
+  }
+  const float naiveDb = offHarmonicDb(naive, cycles);
+  const float correctedDb = offHarmonicDb(corrected, cycles);
+  CHECK(correctedDb < naiveDb - 15.f);
+}
+
+// ============================================================================
+// phaseCrossing
+// ============================================================================
+static void testPhaseCrossing() {
+  // Forward, within the cycle: 0.4 -> 0.6 crosses 0.5 halfway through.
+  CHECK_NEAR(ki1h::phaseCrossing(0.6f, 0.2f, false, 0.5f), -0.5f, 1e-6f);
+  // Forward across the wrap: 0.9 -> 1.1 crosses 0 halfway through.
+  CHECK_NEAR(ki1h::phaseCrossing(0.1f, 0.2f, true, 0.f), -0.5f, 1e-6f);
+  // Nothing in between.
+  CHECK(ki1h::phaseCrossing(0.3f, 0.1f, false, 0.5f) > 0.f);
+  // A stopped phase crosses nothing.
+  CHECK(ki1h::phaseCrossing(0.5f, 0.f, false, 0.5f) > 0.f);
+
+  // Backward, within the cycle: 0.6 -> 0.4 crosses 0.5 halfway through.
+  CHECK_NEAR(ki1h::phaseCrossing(0.4f, -0.2f, false, 0.5f), -0.5f, 1e-6f);
+  // Backward across the wrap: 0.05 -> -0.15 crosses 0 a quarter of the way.
+  CHECK_NEAR(ki1h::phaseCrossing(0.85f, -0.2f, true, 0.f), -0.75f, 1e-5f);
+  // ... and carries on to cross a threshold just below the wrap.
+  CHECK_NEAR(ki1h::phaseCrossing(0.85f, -0.2f, true, 0.9f), -0.25f, 1e-5f);
+  CHECK(ki1h::phaseCrossing(0.85f, -0.2f, true, 0.5f) > 0.f);
+
+  // Arriving at a threshold going forward and leaving it going backward are
+  // both crossings, so a phase that touches an edge and turns back gets the
+  // jump and its undo rather than a lone uncorrected step.
+  CHECK_NEAR(ki1h::phaseCrossing(0.5f, 0.1f, false, 0.5f), 0.f, 0.f);
+  CHECK_NEAR(ki1h::phaseCrossing(0.4f, -0.1f, false, 0.5f), -1.f, 1e-5f);
+
+  // The same triangle as testMinBlamp, run backward. Each corner's slope
+  // change is the forward one times the direction, and with that sign rule
+  // the corrections must cut the aliasing just as hard.
+  const int n = 2400, cycles = 247;
+  const float delta = -(float)cycles / n;
+  std::vector<float> naive(n), corrected(n);
+  ki1h::Phasor ph;
+  ki1h::MinBlampGenerator<16, 16> blamp;
+  for (int i = -64; i < n; i++) {
+    const bool wrapped = ph.step(delta);
+    const float pLow = ki1h::phaseCrossing(ph.phase, delta, wrapped, 0.f);
+    if (pLow <= 0.f)
+      blamp.insertDiscontinuity(pLow, -8.f * delta);
+    const float pHigh = ki1h::phaseCrossing(ph.phase, delta, wrapped, 0.5f);
+    if (pHigh <= 0.f)
+      blamp.insertDiscontinuity(pHigh, 8.f * delta);
+    const float tri = ki1h::triangle(ph.phase);
+    const float out = tri + blamp.process();
+    if (i >= 0) {
+      naive[i] = tri;
+      corrected[i] = out;
+    }
+  }
+  const float naiveDb = offHarmonicDb(naive, cycles);
+  const float correctedDb = offHarmonicDb(corrected, cycles);
+  CHECK(correctedDb < naiveDb - 8.f);
+}
+
+// ============================================================================
+// Half-band decimation
+// ============================================================================
+/** Output amplitude of `dec` after settling, fed a unit sine at `freq` cycles
+per input sample. Measured as RMS * sqrt(2): at these ratios a handful of
+samples per cycle rarely lands on the peak. */
+template <typename D>
+static float decimatedAmplitude(D &dec, int factor, float freq) {
+  dec.reset();
+  double sum = 0.0;
+  float in[8];
+  int t = 0;
+  for (int m = 0; m < 2000; m++) {
+    for (int k = 0; k < factor; k++, t++)
+      in[k] = (float)std::sin(2.0 * 3.14159265358979323846 * freq * t);
+    const float y = dec.process(in, factor);
+    if (m >= 200)
+      sum += y * y;
+  }
+  return (float)std::sqrt(2.0 * sum / 1800);
+}
+
+static void testHalfBand() {
+  // Unity gain at DC, through every factor.
+  ki1h::HalfBandCascade<> dc;
+  for (int factor = 1; factor <= 8; factor *= 2) {
+    dc.reset();
+    const float ones[8] = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f};
+    float y = 0.f;
+    for (int m = 0; m < 100; m++)
+      y = dc.process(ones, factor);
+    CHECK_NEAR(y, 1.f, 1e-4f);
+  }
+
+  // Factor 1 is a plain pass-through, with no latency.
+  ki1h::HalfBandCascade<> pass;
+  const float x[1] = {0.37f};
+  CHECK_NEAR(pass.process(x, 1), 0.37f, 0.f);
+
+  // An impulse comes out K - 1/2 output samples late: the centre tap lands on
+  // sample K - 1 of a pair fed with the impulse in its older slot.
+  ki1h::HalfBandDecimator<16> imp;
+  const float first[2] = {1.f, 0.f};
+  const float zeros[2] = {0.f, 0.f};
+  float response[32];
+  response[0] = imp.process(first);
+  for (int m = 1; m < 32; m++)
+    response[m] = imp.process(zeros);
+  CHECK_NEAR(response[15], 0.5f, 1e-6f);
+  for (int m = 0; m < 32; m++)
+    if (m != 15)
+      CHECK_NEAR(response[m], 0.f, 0.f);
+
+  ki1h::HalfBandCascade<> cascade;
+  for (int factor = 2; factor <= 8; factor *= 2) {
+    // Flat across the audio band at 48 kHz out.
+    const float audio = 18000.f / (48000.f * factor);
+    CHECK_NEAR(decimatedAmplitude(cascade, factor, audio), 1.f, 0.01f);
+    // What would fold onto the audio band is gone: the lower edge of each band
+    // that lands on 0..20 kHz, 28 kHz, 76 kHz and so on.
+    for (int n = 1; n <= factor / 2; n++) {
+      const float image = (48000.f * n - 20000.f) / (48000.f * factor);
+      CHECK(decimatedAmplitude(cascade, factor, image) < 1e-3f);
+    }
+  }
+
+  // A float_4 cascade is four float cascades side by side.
+  for (int factor = 2; factor <= 8; factor *= 2) {
+    ki1h::HalfBandCascade<rack::simd::float_4> wide;
+    ki1h::HalfBandCascade<> narrow[4];
+    for (int m = 0; m < 300; m++) {
+      rack::simd::float_4 in4[8];
+      float in[4][8];
+      for (int k = 0; k < factor; k++)
+        for (int lane = 0; lane < 4; lane++)
+          in4[k].s[lane] = in[lane][k] = std::sin(0.01f * (lane + 1) * (m * factor + k) + lane);
+      const rack::simd::float_4 y = wide.process(in4, factor);
+      for (int lane = 0; lane < 4; lane++)
+        CHECK_NEAR(y[lane], narrow[lane].process(in[lane], factor), 1e-6f);
+    }
+  }
+}
+
+// ============================================================================
+// ClockPLL
+// ============================================================================
+/** Drives `pll` with a clock of `period` samples whose edges are displaced by
+up to +/- `jitter` samples, for `beats` edges. Returns the largest error, in
+samples, between the PLL's phase wraps and the true (unjittered) beat times
+over the last quarter of the run. */
+static float pllWrapError(ki1h::ClockPLL &pll, float period, float jitter, int beats) {
+  const float dt = 1.f / 48000.f;
+  unsigned seed = 12345;
+  double nextEdge = period;
+  float worst = 0.f;
+  int beat = 1;
+  for (int t = 1; beat <= beats; t++) {
+    bool edge = false;
+    float age = 0.f;
+    if (t >= nextEdge) {
+      edge = true;
+      age = (float)(t - nextEdge);
+      seed = seed * 1664525u + 1013904223u;
+      const float r = (seed >> 8) / 16777216.f * 2.f - 1.f;
+      beat++;
+      nextEdge = (double)beat * period + r * jitter;
+    }
+    const bool wrapped = pll.process(edge, age, dt);
+    if (wrapped && beat > beats * 3 / 4) {
+      // Time of the wrap within this sample, against the nearest true beat.
+      // In double: t runs into the millions, where a float's resolution is a
+      // sizeable fraction of a sample.
+      const double at = t - (double)pll.phase / ((double)pll.rate * dt);
+      const double nearest = std::round(at / period) * period;
+      worst = std::max(worst, (float)std::fabs(at - nearest));
+    }
+  }
+  return worst;
+}
+
+static void testClockPLL() {
+  // Locks on the second edge, to the period measured between the first two,
+  // placed to a fraction of a sample.
+  ki1h::ClockPLL pll;
+  const float dt = 1.f / 48000.f;
+  CHECK(!pll.isLocked());
+  pll.process(true, 0.25f, dt);
+  CHECK(!pll.isLocked());
+  for (int i = 0; i < 99; i++)
+    pll.process(false, 0.f, dt);
+  pll.process(true, 0.75f, dt);
+  CHECK(pll.isLocked());
+  CHECK_NEAR(1.f / (pll.freq * dt), 99.5f, 1e-2f);
+  CHECK_NEAR(pll.phase, 0.75f / 99.5f, 1e-5f);
+
+  // A clean clock at a fractional period: every wrap lands on its beat, to
+  // within what a float phase accumulated over a whole period can resolve.
+  ki1h::ClockPLL clean;
+  CHECK(pllWrapError(clean, 1000.37f, 0.f, 200) < 0.25f);
+
+  // Three samples of jitter either side. The loop averages it out: the
+  // tracked beats sit far closer to the true ones than any single edge does.
+  ki1h::ClockPLL slow;
+  slow.setBandwidth(0.01f);
+  CHECK(pllWrapError(slow, 2400.f, 3.f, 800) < 1.f);
+  ki1h::ClockPLL medium;
+  CHECK(pllWrapError(medium, 2400.f, 3.f, 400) < 1.5f);
+
+  // A tempo change outside half-to-double the estimate is re-acquired on the
+  // next interval, not slewed toward.
+  ki1h::ClockPLL jump;
+  for (int t = 1; t <= 5000; t++)
+    jump.process(t % 1000 == 0, 0.f, dt);
+  CHECK_NEAR(1.f / (jump.freq * dt), 1000.f, 1.f);
+  for (int t = 1; t <= 1000; t++)
+    jump.process(t % 300 == 0, 0.f, dt);
+  CHECK_NEAR(1.f / (jump.freq * dt), 300.f, 0.5f);
+
+  jump.reset();
+  CHECK(!jump.isLocked());
+}
+
+// ============================================================================
+// StateWriter / StateReader
+// ============================================================================
+static void testState() {
+  ki1h::StateWriter w(3);
+  w.put(0.25f);
+  w.put(7);
+  w.put(true);
+  w.put(rack::simd::float_4(1.f, 2.f, 3.f, 4.f));
+  const float arr[2] = {-5.f, 6.5f};
+  w.put(arr, 2);
+  w.put(NAN);
+  w.put(INFINITY);
+  CHECK(w.values.size() == 12);
+  CHECK(w.values[0] == 3.f);
+
+  // Reads back in write order.
+  ki1h::StateReader r(w.values, 3);
+  CHECK(r.ok());
+  float f = 0.f;
+  int n = 0;
+  bool b = false;
+  rack::simd::float_4 v = 0.f;
+  float back[2] = {};
+  CHECK(r.get(f) && f == 0.25f);
+  CHECK(r.get(n) && n == 7);
+  CHECK(r.get(b) && b);
+  CHECK(r.get(v) && v[0] == 1.f && v[3] == 4.f);
+  CHECK(r.get(back, 2) && back[0] == -5.f && back[1] == 6.5f);
+  // Non-finite values were stored as 0.
+  CHECK(r.get(f) && f == 0.f);
+  CHECK(r.get(f) && f == 0.f);
+
+  // Exhausted: targets are left alone.
+  f = 42.f;
+  CHECK(!r.get(f) && f == 42.f);
+  v = 9.f;
+  CHECK(!r.get(v) && v[0] == 9.f);
+
+  // Another layout version reads nothing at all.
+  ki1h::StateReader old(w.values, 2);
+  CHECK(!old.ok());
+  f = 42.f;
+  CHECK(!old.get(f) && f == 42.f);
+
+  // A block that would run past the end is not partly read.
+  ki1h::StateWriter shortW(1);
+  shortW.put(1.f);
+  shortW.put(2.f);
+  ki1h::StateReader shortR(shortW.values, 1);
+  float three[3] = {9.f, 9.f, 9.f};
+  CHECK(!shortR.get(three, 3) && three[0] == 9.f);
+  CHECK(!shortR.get(v));
+}
+
+static void testClockPLLState() {
+  // A PLL restored mid-stream carries on exactly as the original does.
+  const float dt = 1.f / 48000.f;
+  const int period = 2400;
+  ki1h::ClockPLL a;
+  for (int i = 0; i < period * 20 + 700; i++)
+    a.process(i % period == 0, 0.f, dt);
+  CHECK(a.isLocked());
+
+  ki1h::StateWriter w(1);
+  a.saveState(w);
+  ki1h::ClockPLL b;
+  ki1h::StateReader r(w.values, 1);
+  b.loadState(r);
+  CHECK(b.isLocked());
+  for (int i = period * 20 + 700; i < period * 30; i++) {
+    const bool edge = i % period == 0;
+    CHECK(a.process(edge, 0.f, dt) == b.process(edge, 0.f, dt));
+    CHECK(a.phase == b.phase);
+    if (failures)
+      return;
+  }
+
+  // A missing state leaves a fresh PLL unlocked.
+  ki1h::ClockPLL c;
+  ki1h::StateReader none(std::vector<float>(), 1);
+  c.loadState(none);
+  CHECK(!c.isLocked());
+}
+
+// ============================================================================
+// WarmStart
+// ============================================================================
+// Counts its process() calls, and reports a voltage on its one output.
+struct CountingModule : Module {
+  ki1h::WarmStart warmStart;
+  int calls = 0;
+  int connectedCalls = 0;
+  CountingModule() {
+    config(0, 0, 1);
+  }
+  void process(const ProcessArgs &args) override {
+    if (warmStart.step(this, args))
+      return;
+    calls++;
+    if (outputs[0].isConnected())
+      connectedCalls++;
+    outputs[0].setVoltage(5.f);
+  }
+};
+
+static void testWarmStart() {
+  CHECK(ki1h::WarmStart::lengthMs(0) == 0);
+  CHECK(ki1h::WarmStart::lengthMs(-1) == 0);
+  CHECK(ki1h::WarmStart::lengthMs(99) == ki1h::WarmStart::lengthMs(ki1h::WarmStart::NUM_LENGTHS - 1));
+
+  // Off by default: the first process() call is live.
+  Module::ProcessArgs args;
+  CountingModule off;
+  off.warmStart.arm(&off, 48000.f);
+  off.process(args);
+  CHECK(off.calls == 1);
+
+  // 20 ms at 48 kHz is 960 frames, run CHUNK at a time with the output held
+  // at 0 V and marked connected while they run.
+  CountingModule on;
+  on.warmStart.length = 1;
+  on.warmStart.arm(&on, 48000.f);
+  const int steps = 960 / ki1h::WarmStart::CHUNK;
+  bool silent = true;
+  for (int i = 0; i < steps; i++) {
+    on.process(args);
+    silent = silent && on.outputs[0].getVoltage() == 0.f;
+  }
+  CHECK(silent);
+  CHECK(on.calls == 960);
+  CHECK(on.connectedCalls == 960);
+  CHECK(on.outputs[0].channels == 0);
+  on.process(args);
+  CHECK(on.calls == 961);
+  CHECK(on.outputs[0].getVoltage() == 5.f);
+
+  // Restored state is already warm.
+  CountingModule restored;
+  restored.warmStart.length = 1;
+  restored.warmStart.stateRestored = true;
+  restored.warmStart.arm(&restored, 48000.f);
+  restored.process(args);
+  CHECK(restored.calls == 1);
+}
+
+// ============================================================================
+// BlockFifo
+// ============================================================================
+// Driven the way a module drives it, with a kernel that doubles its input.
+static void testBlockFifo() {
+  typedef ki1h::BlockFifo<1, 1> Fifo;
+  Fifo fifo;
+  const float silent = 0.f;
+  CHECK(fifo.begin(&silent) == 0); // off by default
+
+  // A frame's output is its input's kernel result exactly one block later,
+  // and silence before that.
+  fifo.sizeIndex = 1;
+  const int n = Fifo::blockSize(1);
+  CHECK(n == 16);
+  bool exact = true;
+  for (int i = 0; i < 5 * n; i++) {
+    CHECK(fifo.begin(&silent) == n);
+    fifo.in[0][fifo.pos] = (float)(i + 1);
+    const float y = fifo.out[0][fifo.pos];
+    if (fifo.end())
+      for (int k = 0; k < n; k++)
+        fifo.out[0][k] = 2.f * fifo.in[0][k];
+    exact = exact && y == (i < n ? 0.f : 2.f * (i + 1 - n));
+  }
+  CHECK(exact);
+
+  // A size change restarts at the top of a block, holding the last output.
+  const float last = 2.f * (5 * n - n);
+  fifo.sizeIndex = 3;
+  CHECK(fifo.begin(&last) == 64);
+  CHECK(fifo.pos == 0);
+  CHECK_NEAR(fifo.out[0][0], last, 0.f);
+  CHECK_NEAR(fifo.out[0][63], last, 0.f);
+  CHECK(Fifo::blockSize(99) == Fifo::MAX_SIZE);
+}
+
 // ============================================================================
 // Channel
 // ============================================================================
@@ -266,8 +974,20 @@ int main() {
   testPhasor();
   testWaveforms();
   testPitchToFreq();
+  testStageTimeMap();
+  testDenormals();
+  testOnePole();
+  testSmoothedParam();
+  testMinBlamp();
+  testMinBlepBank();
+  testPhaseCrossing();
+  testHalfBand();
+  testClockPLL();
+  testState();
+  testClockPLLState();
+  testWarmStart();
+  testBlockFifo();
   testChannel();
 
-  std::printf("\n%d checks, %d failure%s\n", checks, failures, failures == 1 ? "" : "s");
-  return failures ? 1 : 0;
+  return report();
 }
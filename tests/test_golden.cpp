@@ -0,0 +1,611 @@
+/* Golden-output regression suite for the per-module DSP.
+
+Run with `make test RACK_DIR=/path/to/Rack-SDK`, which runs it after the unit
+tests. After a change that is meant to alter the sound, regenerate the
+references with `make golden` and commit the diff of tests/golden/ with it.
+
+Each render drives the DSP structs from src/vco.hpp, src/lfo.hpp,
+src/filter.hpp, src/envelope.hpp, src/kaos.hpp, src/mix.hpp, src/vca.hpp and
+src/voice.hpp the way their modules do, over a fixed stretch of fixed inputs, and compares
+every sample against a stored reference. The last one patches several of them
+together. Nothing draws on rack::random: the noise and unison streams take
+fixed seeds, so a render is the same on every run.
+
+The tolerance is there for libm and compiler differences, which move a sample
+by a few ulps, not for real changes. An optimization that keeps the maths the
+same passes. One that is only meant to be near the old output needs the
+references regenerated, after listening to the difference. The suite builds
+without the plugin's -funsafe-math-optimizations for the same reason: under it
+the MinBLEP tails move by about 1e-3, which would swamp the tolerance. */
+
+#include "envelope.hpp"
+#include "filter.hpp"
+#include "harness.hpp"
+#include "kaos.hpp"
+#include "lfo.hpp"
+#include "mix.hpp"
+#include "vca.hpp"
+#include "vco.hpp"
+#include "voice.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const float SAMPLE_RATE = 48000.f;
+static const float SAMPLE_TIME = 1.f / SAMPLE_RATE;
+static const int FRAMES = 1024;
+
+/** Interleaved output of one render: FRAMES rows of `channels` values. */
+struct Buffer {
+  int channels;
+  std::vector<float> data;
+
+  explicit Buffer(int channels) : channels(channels) {
+    data.reserve(FRAMES * channels);
+  }
+  void frame(float a) {
+    data.push_back(a);
+  }
+  void frame(float a, float b) {
+    data.push_back(a);
+    data.push_back(b);
+  }
+  void frame(float a, float b, float c) {
+    data.push_back(a);
+    data.push_back(b);
+    data.push_back(c);
+  }
+};
+
+/** A naive bipolar saw, the test signal the filters and mixers are fed. */
+static float testSaw(float &phase, float freq) {
+  phase += freq * SAMPLE_TIME;
+  phase -= std::floor(phase);
+  return 5.f * (2.f * phase - 1.f);
+}
+
+/** Exponential sweep from `from` to `to` across the render. */
+static float sweep(int i, float from, float to) {
+  return from * std::pow(to / from, (float)i / (FRAMES - 1));
+}
+
+/** The two VCO oscillators and the BLEP bank they share, wired the way
+KI1H_VCO wires them. Not copyable: the oscillators point at the bank. */
+struct VcoCore {
+  BlepBank bank;
+  RawOscillator osc1;
+  ShaperOscillator osc2;
+
+  VcoCore() {
+    osc1.bleps = &bank;
+    osc2.bleps = &bank;
+  }
+  VcoCore(const VcoCore &) = delete;
+};
+
+// ============================================================================
+// VCO
+// ============================================================================
+// Three oscillators, one per waveform, sweeping from C4 up three octaves so
+// the edges land at a different sub-sample position every cycle. The sub
+// rides along on the pulse.
+static Buffer renderVcoRaw() {
+  Buffer out(4);
+  VcoCore tri, saw, sq;
+  for (int i = 0; i < FRAMES; i++) {
+    const float pitch = 3.f * i / FRAMES;
+    tri.osc1.process(pitch, 0.5f, WAVE_TRI, SAMPLE_TIME, false);
+    saw.osc1.process(pitch, 0.5f, WAVE_SAW, SAMPLE_TIME, false);
+    sq.osc1.process(pitch, 0.3f, WAVE_SQ, SAMPLE_TIME, true);
+    tri.bank.process();
+    saw.bank.process();
+    sq.bank.process();
+    out.frame(tri.osc1.getOutput(), saw.osc1.getOutput());
+    out.frame(sq.osc1.getOutput(), sq.osc1.getSub());
+  }
+  return out;
+}
+
+// Osc 2 as the module drives it from osc 1: weak sync on the Sin-Saw, strong
+// sync on the pulse, and deep through-zero linear FM.
+static Buffer renderVcoShaper() {
+  Buffer out(3);
+  VcoCore soft, hard, fm;
+  for (int i = 0; i < FRAMES; i++) {
+    soft.osc1.process(-0.5f, 0.5f, WAVE_SAW, SAMPLE_TIME, false);
+    soft.osc2.process(0.3f, 0.f, true, 1.f, 0, 5.f * soft.osc1.getOutput(), 0.6f,
+                      SHAPER_SINSAW, SAMPLE_TIME, true);
+    soft.bank.process();
+
+    hard.osc1.process(0.f, 0.5f, WAVE_SQ, SAMPLE_TIME, false);
+    hard.osc2.process(0.75f, 0.f, true, 1.f, 2, 5.f * hard.osc1.getOutput(), 0.4f,
+                      SHAPER_PULSE, SAMPLE_TIME, true);
+    hard.bank.process();
+
+    fm.osc1.process(-1.f, 0.5f, WAVE_TRI, SAMPLE_TIME, false);
+    fm.osc2.process(0.5f, 5.f * fm.osc1.getSin() * 3.f, true, 1.f, 1, 0.f, 1.f, SHAPER_SINSAW,
+                    SAMPLE_TIME, true);
+    fm.bank.process();
+
+    out.frame(soft.osc2.getOutput(), hard.osc2.getOutput(), fm.osc2.getOutput());
+  }
+  return out;
+}
+
+static Buffer renderVcoUnison() {
+  Buffer out(2);
+  UnisonOscillator unison(0x5eed, 0xcafe);
+  unison.setVoices(5, 30.f);
+  for (int i = 0; i < FRAMES; i++) {
+    unison.process(1.f, 0.5f, i < FRAMES / 2 ? WAVE_SAW : WAVE_TRI, SAMPLE_TIME);
+    out.frame(unison.getLeft(), unison.getRight());
+  }
+  return out;
+}
+
+/** A detune change, as from dragging or automating the menu slider, moves
+the voices apart without touching their phases, and a larger voice count
+scatters only the voices it adds. */
+static void checkUnisonDetuneContinuity() {
+  UnisonOscillator unison(0x5eed, 0xcafe);
+  unison.setVoices(4, 20.f);
+  for (int i = 0; i < 100; i++)
+    unison.process(1.f, 0.5f, WAVE_SAW, SAMPLE_TIME);
+  const simd::float_4 before = unison.phase[0];
+
+  unison.setVoices(4, 60.f);
+  CHECK(unison.spreadCents == 60.f);
+  bool kept = true;
+  for (int v = 0; v < 4; v++)
+    kept = kept && unison.phase[0][v] == before[v];
+  CHECK(kept);
+
+  // One more sample advances every voice by about its own increment (C5 is
+  // under 0.011 of a cycle here), never by a jump.
+  unison.process(1.f, 0.5f, WAVE_SAW, SAMPLE_TIME);
+  bool continuous = true;
+  for (int v = 0; v < 4; v++) {
+    const float step = unison.phase[0][v] - before[v];
+    continuous = continuous && (std::fabs(step) < 0.02f || std::fabs(step - -1.f) < 0.02f);
+  }
+  CHECK(continuous);
+
+  const simd::float_4 kept4 = unison.phase[0];
+  unison.setVoices(6, 60.f);
+  bool untouched = true;
+  for (int v = 0; v < 4; v++)
+    untouched = untouched && unison.phase[0][v] == kept4[v];
+  CHECK(untouched);
+}
+
+// ============================================================================
+// LFO
+// ============================================================================
+static Buffer renderLfo() {
+  Buffer out(3);
+  LFO sine, saw, square;
+  for (int i = 0; i < FRAMES; i++) {
+    sine.process(-2.f, LFO_SINE, SAMPLE_TIME);
+    saw.process(-1.f, LFO_SAW, SAMPLE_TIME);
+    square.process(-0.5f, LFO_SQUARE, SAMPLE_TIME);
+    out.frame(sine.getOutput(), saw.getOutput(), square.getOutput());
+  }
+  return out;
+}
+
+// Free-running: the internal clock, turned up to audio rate by CV, samples
+// LFO 2's triangle, with the band-limited clock output on.
+static Buffer renderSampleAndHoldFree() {
+  Buffer out(2);
+  LFO lfo2;
+  SampleAndHold snh;
+  for (int i = 0; i < FRAMES; i++) {
+    lfo2.process(-1.f, LFO_SINE, SAMPLE_TIME);
+    snh.process(lfo2.phase.phase, 0.f, 0.5f, POW2_RATIOS[3], 0.f, true, 0.f, false,
+                SH_TRIANGLE, 0.001f, SAMPLE_TIME, true);
+    out.frame(snh.getOutput(), snh.getClock());
+  }
+  return out;
+}
+
+// An external 375 Hz square clocks SAMP IN's sine at x3/2, swung. The PLL locks
+// a quarter of the way in, so the silent output before lock and the swung
+// pulses after it are both covered.
+static Buffer renderSampleAndHoldClocked() {
+  Buffer out(2);
+  LFO lfo2;
+  SampleAndHold snh;
+  const ClockRatio &ratio = EXTENDED_RATIOS[10];
+  float clockPhase = 0.f, inPhase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    clockPhase += 375.f * SAMPLE_TIME;
+    clockPhase -= std::floor(clockPhase);
+    const float clockIn = clockPhase < 0.5f ? 5.f : 0.f;
+    inPhase += 110.f * SAMPLE_TIME;
+    inPhase -= std::floor(inPhase);
+    const float sampleIn = std::sin(2.f * ki1h::PI * inPhase);
+
+    lfo2.process(-1.f, LFO_SINE, SAMPLE_TIME);
+    snh.process(lfo2.phase.phase, clockIn, -1.f, ratio, 0.3f, true, sampleIn, true, SH_SAW,
+                0.002f, SAMPLE_TIME, true);
+    out.frame(snh.getOutput(), snh.getClock());
+  }
+  return out;
+}
+
+// ============================================================================
+// FILTER
+// ============================================================================
+// The LP with its cutoff sweeping up at moderate resonance, and a second one
+// pinged once at full resonance and left to self-oscillate.
+static Buffer renderFilterLP() {
+  Buffer out(2);
+  LPFilter swept, ringing;
+  swept.setSampleTime(SAMPLE_TIME);
+  ringing.setSampleTime(SAMPLE_TIME);
+  float phase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    const float in = testSaw(phase, 110.f);
+    swept.process(in, sweep(i, 100.f, 12000.f), 0.8f);
+    ringing.process(i == 0 ? 5.f : 0.f, 800.f, 1.666f);
+    out.frame(softClip(swept.getOutput()), softClip(ringing.getOutput()));
+  }
+  return out;
+}
+
+// The same two with every ladder stage saturating, the saw driven hotter so
+// that the stages bend.
+static Buffer renderFilterLPSaturating() {
+  Buffer out(2);
+  LPFilter swept, ringing;
+  swept.setSampleTime(SAMPLE_TIME);
+  ringing.setSampleTime(SAMPLE_TIME);
+  swept.saturate = true;
+  ringing.saturate = true;
+  float phase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    const float in = 2.f * testSaw(phase, 110.f);
+    swept.process(in, sweep(i, 100.f, 12000.f), 0.8f);
+    ringing.process(i == 0 ? 5.f : 0.f, 800.f, 1.666f);
+    out.frame(softClip(swept.getOutput()), softClip(ringing.getOutput()));
+  }
+  return out;
+}
+
+static Buffer renderFilterBP() {
+  Buffer out(2);
+  BPFilter wide, resonant;
+  wide.setSampleTime(SAMPLE_TIME);
+  resonant.setSampleTime(SAMPLE_TIME);
+  float phase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    const float in = testSaw(phase, 110.f);
+    wide.process(in, sweep(i, 200.f, 5000.f), 3.f, 0.01f);
+    resonant.process(in, 660.f, 0.5f, 1.666f);
+    out.frame(softClip(wide.getOutput()), softClip(resonant.getOutput()));
+  }
+  return out;
+}
+
+// An 8-band bank from 100 Hz to 8 kHz, whose top band sweeps down to 2 kHz
+// in the second half, bunching the bands up.
+static Buffer renderFilterBank() {
+  Buffer out(8);
+  BPFilterBank bank;
+  bank.setSampleTime(SAMPLE_TIME);
+  bank.setBands(8);
+  float phase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    const float high = i < FRAMES / 2 ? 8000.f : sweep(2 * (i - FRAMES / 2), 8000.f, 2000.f);
+    bank.process(testSaw(phase, 110.f), 100.f, high, 0.5f, 0.3f);
+    for (int band = 0; band < 8; band++)
+      out.data.push_back(softClip(bank.getOutput(band)));
+  }
+  return out;
+}
+
+static Buffer renderFilterHP() {
+  Buffer out(1);
+  HPFilter hp;
+  hp.setSampleTime(SAMPLE_TIME);
+  float phase = 0.f;
+  for (int i = 0; i < FRAMES; i++) {
+    hp.process(testSaw(phase, 110.f), sweep(i, 30.f, 8000.f));
+    out.frame(softClip(hp.getOutput()));
+  }
+  return out;
+}
+
+// ============================================================================
+// ENVELOPE
+// ============================================================================
+// Renders at a 1 kHz control rate so a full second of stages fits. The AD is
+// retriggered mid-release; the ASD sustains through a held gate, releases,
+// and is retriggered before it reaches zero.
+static Buffer renderEnvelopes() {
+  const float sampleTime = 1e-3f;
+  Buffer out(6);
+  ADEnvelope ad;
+  ASDEnvelope asd;
+  asd.sustain = 0.6f;
+  ad.attackStep = sampleTime / 0.02f;
+  ad.releaseStep = sampleTime / 0.15f;
+  asd.attackStep = sampleTime / 0.05f;
+  asd.releaseStep = sampleTime / 0.3f;
+  for (int i = 0; i < FRAMES; i++) {
+    if (i == 10 || i == 100)
+      ad.retrigger();
+    if (i == 20 || i == 700)
+      asd.retrigger();
+    ad.process(sampleTime);
+    asd.process(sampleTime, true, i < 400);
+    out.frame(ad.env, ad.eoa, ad.eor);
+    out.frame(asd.env, asd.eoa, asd.eor);
+  }
+  return out;
+}
+
+// ============================================================================
+// KAOS
+// ============================================================================
+// The colour sweeps brown to white. Chaos 1 is clocked throughout; chaos 2
+// follows it for the first half and gets its own clock for the second. The
+// second half runs through processBlock() in uneven blocks, which must match
+// what process() would have to within float tolerance.
+static Buffer renderKaos() {
+  Buffer out(3);
+  KAOS kaos(0x6b616f73);
+  float color[FRAMES], pk[FRAMES], bk[FRAMES];
+  for (int i = 0; i < FRAMES; i++) {
+    color[i] = -1.f + 2.f * i / (FRAMES - 1);
+    pk[i] = (i / 16) % 2 ? 10.f : 0.f;
+    bk[i] = (i / 40) % 2 ? 10.f : 0.f;
+  }
+  for (int i = 0; i < FRAMES / 2; i++) {
+    kaos.process(color[i], bk[i], false, pk[i], true);
+    out.frame(kaos.getNoise(), kaos.getpKaos(), kaos.getbKaos());
+  }
+  float noise[FRAMES], pKaos[FRAMES], bKaos[FRAMES];
+  for (int i = FRAMES / 2, n = 1; i < FRAMES; i += n, n = n % 37 + 5) {
+    n = std::min(n, FRAMES - i);
+    kaos.processBlock(color + i, bk + i, true, pk + i, true, noise + i, pKaos + i, bKaos + i, n);
+  }
+  for (int i = FRAMES / 2; i < FRAMES; i++)
+    out.frame(noise[i], pKaos[i], bKaos[i]);
+  return out;
+}
+
+// ============================================================================
+// MIX & VCA
+// ============================================================================
+// Five saws at rising levels, loud enough that the sums reach the soft limit.
+static Buffer renderMix() {
+  Buffer out(3);
+  Mix mix;
+  float phases[5] = {};
+  const float freqs[5] = {110.f, 165.f, 220.f, 330.f, 440.f};
+  for (int i = 0; i < FRAMES; i++) {
+    std::array<float, 5> in;
+    for (int c = 0; c < 5; c++)
+      in[c] = testSaw(phases[c], freqs[c]) * (0.2f + 0.2f * c);
+    mix.process(in);
+    out.frame(mix.getAllOut(), mix.getLeftOut(), mix.getRightOut());
+  }
+  return out;
+}
+
+static Buffer renderVca() {
+  Buffer out(2);
+  VCA vca;
+  float phases[5] = {};
+  const float freqs[5] = {110.f, 165.f, 220.f, 330.f, 440.f};
+  for (int i = 0; i < FRAMES; i++) {
+    std::array<float, 5> in, pans;
+    for (int c = 0; c < 5; c++) {
+      in[c] = testSaw(phases[c], freqs[c]) * 0.5f;
+      // Spread from hard left to hard right, and past both, over the render.
+      pans[c] = (c - 2) * 0.6f * (2.f * i / FRAMES);
+    }
+    vca.process(in, pans);
+    out.frame(vca.getLeftOut(), vca.getRightOut());
+  }
+  return out;
+}
+
+// ============================================================================
+// PATCH
+// ============================================================================
+// A small voice: osc 1's saw through the LP, whose cutoff and the VCA's level
+// both follow an ASD envelope, panned by the LFO. The note changes halfway.
+static Buffer renderPatch() {
+  Buffer out(2);
+  VcoCore vco;
+  LPFilter lp;
+  lp.setSampleTime(SAMPLE_TIME);
+  ASDEnvelope env;
+  LFO lfo;
+  VCA vca;
+  env.sustain = 0.7f;
+  env.attackStep = SAMPLE_TIME / 0.003f;
+  env.releaseStep = SAMPLE_TIME / 0.01f;
+  for (int i = 0; i < FRAMES; i++) {
+    if (i == 0 || i == FRAMES / 2)
+      env.retrigger();
+    const bool held = (i % (FRAMES / 2)) < FRAMES / 4;
+    env.process(SAMPLE_TIME, true, held);
+    vco.osc1.process(i < FRAMES / 2 ? -1.f : -0.75f, 0.5f, WAVE_SAW, SAMPLE_TIME, false);
+    vco.bank.process();
+    lp.process(5.f * vco.osc1.getOutput(), 200.f + 6000.f * env.env, 0.6f);
+    lfo.process(2.f, LFO_SINE, SAMPLE_TIME);
+
+    std::array<float, 5> in = {{softClip(lp.getOutput()) * env.env, 0.f, 0.f, 0.f, 0.f}};
+    std::array<float, 5> pans = {{lfo.getOutput(), 0.f, 0.f, 0.f, 0.f}};
+    vca.process(in, pans);
+    out.frame(vca.getLeftOut(), vca.getRightOut());
+  }
+  return out;
+}
+
+// ============================================================================
+// VOICE
+// ============================================================================
+// Two KI1H-VOICE voices with the same controls. The first plays a note from
+// frame 16 and releases it; the second comes in a quarter of the way through,
+// a fifth up and with cutoff FM. Osc 2 is hard-synced and half the mix.
+static Buffer renderVoice() {
+  Buffer out(3);
+  Voice a, b;
+  a.setSampleTime(SAMPLE_TIME);
+  b.setSampleTime(SAMPLE_TIME);
+  VoiceControls c;
+  c.pitch = -1.f;
+  c.interval = 0.6f;
+  c.wave = WAVE_SAW;
+  c.wave2 = SHAPER_PULSE;
+  c.shape = 0.4f;
+  c.syncType = 2;
+  c.blend = 0.5f;
+  c.cutoff = 400.f;
+  c.resonance = 0.8f;
+  c.envCutoff = 5000.f;
+  c.attackStep = SAMPLE_TIME / 0.003f;
+  c.releaseStep = SAMPLE_TIME / 0.005f;
+  c.sustain = 0.6f;
+  c.level = 0.8f;
+  for (int i = 0; i < FRAMES; i++) {
+    const float gateA = i >= 16 && i < FRAMES / 2 ? 10.f : 0.f;
+    const float gateB = i >= FRAMES / 4 && i < 3 * FRAMES / 4 ? 10.f : 0.f;
+    const float outA = a.process(c, 0.f, gateA, 0.f, SAMPLE_TIME);
+    const float outB = b.process(c, 7.f / 12.f, gateB, -2000.f * i / FRAMES, SAMPLE_TIME);
+    out.frame(outA, outB, a.env.env);
+  }
+  return out;
+}
+
+// ============================================================================
+// GOLDEN FILES
+// ============================================================================
+// Plain text, one frame per line, so a regenerated reference reads as a diff.
+static const char *GOLDEN_DIR = "tests/golden/";
+
+static std::string goldenPath(const char *name) {
+  return std::string(GOLDEN_DIR) + name + ".txt";
+}
+
+static bool writeGolden(const char *name, const Buffer &b) {
+  FILE *f = std::fopen(goldenPath(name).c_str(), "w");
+  if (!f)
+    return false;
+  std::fprintf(f, "# %s: %d frames x %d channels at %g Hz\n", name, FRAMES, b.channels,
+               SAMPLE_RATE);
+  for (size_t i = 0; i < b.data.size(); i += b.channels) {
+    for (int c = 0; c < b.channels; c++)
+      std::fprintf(f, c ? " %.8g" : "%.8g", b.data[i + c]);
+    std::fputc('\n', f);
+  }
+  std::fclose(f);
+  return true;
+}
+
+/** Reads a reference back, skipping the comment header. Empty on failure. */
+static std::vector<float> readGolden(const char *name) {
+  std::vector<float> data;
+  FILE *f = std::fopen(goldenPath(name).c_str(), "r");
+  if (!f)
+    return data;
+  char line[512];
+  while (std::fgets(line, sizeof(line), f)) {
+    if (line[0] == '#')
+      continue;
+    char *p = line;
+    char *end;
+    for (float v = std::strtof(p, &end); end != p; v = std::strtof(p, &end)) {
+      data.push_back(v);
+      p = end;
+    }
+  }
+  std::fclose(f);
+  return data;
+}
+
+struct Render {
+  const char *name;
+  Buffer (*render)();
+};
+
+static const Render RENDERS[] = {
+    {"vco_raw", renderVcoRaw},
+    {"vco_shaper", renderVcoShaper},
+    {"vco_unison", renderVcoUnison},
+    {"lfo", renderLfo},
+    {"snh_free", renderSampleAndHoldFree},
+    {"snh_clocked", renderSampleAndHoldClocked},
+    {"filter_lp", renderFilterLP},
+    {"filter_lp_saturating", renderFilterLPSaturating},
+    {"filter_bp", renderFilterBP},
+    {"filter_bank", renderFilterBank},
+    {"filter_hp", renderFilterHP},
+    {"envelope", renderEnvelopes},
+    {"kaos", renderKaos},
+    {"mix", renderMix},
+    {"vca", renderVca},
+    {"patch", renderPatch},
+    {"voice", renderVoice},
+};
+
+/** Per-sample tolerance, relative to the larger of 1 and the reference. */
+static const float TOLERANCE = 1e-4f;
+
+/** Compares one render against its reference. Reports only the worst sample,
+so one regression does not bury the rest of the log. */
+static void checkRender(const Render &r) {
+  const Buffer got = r.render();
+  const std::vector<float> want = readGolden(r.name);
+  checks++;
+  if (want.size() != got.data.size()) {
+    failures++;
+    std::printf("FAIL %s: %s has %d values, the render %d (regenerate with `make golden`)\n",
+                r.name, goldenPath(r.name).c_str(), (int)want.size(), (int)got.data.size());
+    return;
+  }
+  size_t worst = 0;
+  float worstErr = 0.f;
+  for (size_t i = 0; i < want.size(); i++) {
+    const float err = std::fabs(got.data[i] - want[i]) / std::max(1.f, std::fabs(want[i]));
+    // A NaN in the render must fail, so compare the negation.
+    if (!(err <= worstErr)) {
+      worstErr = err;
+      worst = i;
+      if (std::isnan(err))
+        break;
+    }
+  }
+  if (!(worstErr <= TOLERANCE)) {
+    failures++;
+    std::printf("FAIL %s: frame %d channel %d got %.9g, want %.9g (relative error %g)\n", r.name,
+                (int)(worst / got.channels), (int)(worst % got.channels), got.data[worst],
+                want[worst], worstErr);
+  }
+}
+
+int main(int argc, char **argv) {
+  const bool update = argc > 1 && std::strcmp(argv[1], "--update") == 0;
+  for (const Render &r : RENDERS) {
+    if (update) {
+      if (!writeGolden(r.name, r.render())) {
+        std::printf("cannot write %s\n", goldenPath(r.name).c_str());
+        return 1;
+      }
+      std::printf("wrote %s\n", goldenPath(r.name).c_str());
+    } else {
+      checkRender(r);
+    }
+  }
+  if (!update)
+    checkUnisonDetuneContinuity();
+  return update ? 0 : report();
+}